@@ -0,0 +1,138 @@
+#include "compress.h"
+#include <string.h>
+
+#ifdef SYLAR_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef SYLAR_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef SYLAR_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace sylar
+{
+
+#ifdef SYLAR_HAVE_ZSTD
+class ZstdCompressor : public LogCompressor
+{
+public:
+    ZstdCompressor(int level)
+        :m_level(level ? level : 3)
+        ,m_ctx(ZSTD_createCCtx()) {
+    }
+    ~ZstdCompressor() {
+        ZSTD_freeCCtx(m_ctx);
+    }
+    const char* getName() const override { return "zstd";}
+    bool compressFrame(const char* data, size_t len, std::string& out) override {
+        if (!m_ctx) {
+            return false;
+        }
+        size_t old = out.size();
+        out.resize(old + ZSTD_compressBound(len));
+        size_t rt = ZSTD_compressCCtx(m_ctx, &out[old], out.size() - old, data, len, m_level);
+        if (ZSTD_isError(rt)) {
+            out.resize(old);
+            return false;
+        }
+        out.resize(old + rt);
+        return true;
+    }
+private:
+    int m_level;
+    ZSTD_CCtx* m_ctx;
+};
+#endif
+
+#ifdef SYLAR_HAVE_LZ4
+class Lz4Compressor : public LogCompressor
+{
+public:
+    Lz4Compressor(int level) {
+        memset(&m_prefs, 0, sizeof(m_prefs));
+        m_prefs.compressionLevel = level;
+        m_prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+    }
+    const char* getName() const override { return "lz4";}
+    bool compressFrame(const char* data, size_t len, std::string& out) override {
+        size_t old = out.size();
+        out.resize(old + LZ4F_compressFrameBound(len, &m_prefs));
+        size_t rt = LZ4F_compressFrame(&out[old], out.size() - old, data, len, &m_prefs);
+        if (LZ4F_isError(rt)) {
+            out.resize(old);
+            return false;
+        }
+        out.resize(old + rt);
+        return true;
+    }
+private:
+    LZ4F_preferences_t m_prefs;
+};
+#endif
+
+#ifdef SYLAR_HAVE_ZLIB
+// 每帧是一个 gzip member，gzip -d 会把多个 member 依次解出来
+class GzipCompressor : public LogCompressor
+{
+public:
+    GzipCompressor(int level) {
+        memset(&m_stream, 0, sizeof(m_stream));
+        // windowBits 加 16 输出 gzip 头
+        m_ok = deflateInit2(&m_stream, level ? level : 6, Z_DEFLATED,
+                            15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~GzipCompressor() {
+        if (m_ok) {
+            deflateEnd(&m_stream);
+        }
+    }
+    const char* getName() const override { return "gzip";}
+    bool compressFrame(const char* data, size_t len, std::string& out) override {
+        if (!m_ok) {
+            return false;
+        }
+        size_t old = out.size();
+        // gzip 头尾 18 字节
+        out.resize(old + deflateBound(&m_stream, len) + 18);
+        m_stream.next_in = (Bytef*)data;
+        m_stream.avail_in = len;
+        m_stream.next_out = (Bytef*)&out[old];
+        m_stream.avail_out = out.size() - old;
+        int rt = deflate(&m_stream, Z_FINISH);
+        size_t produced = out.size() - old - m_stream.avail_out;
+        deflateReset(&m_stream);
+        if (rt != Z_STREAM_END) {
+            out.resize(old);
+            return false;
+        }
+        out.resize(old + produced);
+        return true;
+    }
+private:
+    bool m_ok;
+    z_stream m_stream;
+};
+#endif
+
+LogCompressor::ptr LogCompressor::Create(const std::string& name, int level) {
+#ifdef SYLAR_HAVE_ZSTD
+    if (name == "zstd") {
+        return LogCompressor::ptr(new ZstdCompressor(level));
+    }
+#endif
+#ifdef SYLAR_HAVE_LZ4
+    if (name == "lz4") {
+        return LogCompressor::ptr(new Lz4Compressor(level));
+    }
+#endif
+#ifdef SYLAR_HAVE_ZLIB
+    if (name == "gzip") {
+        return LogCompressor::ptr(new GzipCompressor(level));
+    }
+#endif
+    return nullptr;
+}
+
+} // namespace sylar
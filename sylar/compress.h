@@ -0,0 +1,30 @@
+#ifndef __SYLAR_COMPRESS_H__
+#define __SYLAR_COMPRESS_H__
+
+#include <memory>
+#include <string>
+
+namespace sylar
+{
+
+// 日志压缩器，每次把一批数据压成一个完整、可以单独解压的帧
+// 多个帧直接拼在一起仍然是合法的 zstd/lz4/gzip 文件，写了一半的文件也能解出前面完整的帧
+// 具体算法由 cmake 检测到的库决定：SYLAR_HAVE_ZSTD、SYLAR_HAVE_LZ4、SYLAR_HAVE_ZLIB
+class LogCompressor
+{
+public:
+    typedef std::shared_ptr<LogCompressor> ptr;
+    virtual ~LogCompressor() {}
+
+    virtual const char* getName() const = 0;
+    // 把 data 压成一个帧追加到 out 后面，失败返回false
+    virtual bool compressFrame(const char* data, size_t len, std::string& out) = 0;
+
+    // name 为 zstd、lz4、gzip，level 为 0 时用各算法的默认级别
+    // 不支持的算法或者编译时没有对应的库返回 nullptr
+    static ptr Create(const std::string& name, int level = 0);
+};
+
+} // namespace sylar
+
+#endif // !__SYLAR_COMPRESS_H__
@@ -1,9 +1,454 @@
 #include "config.h"
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace sylar
 {
 
-Config::ConfigVarMap Config::s_datas;
+const char* ConfigSource::ToString(ConfigSource::Type type) {
+    switch (type) {
+#define XX(name) \
+    case ConfigSource::name: \
+        return #name;
 
+    XX(DEFAULT);
+    XX(YAML);
+    XX(ENV);
+    XX(ARGV);
+#undef XX
+    default:
+        return "UNKNOW";
+    }
+}
+
+ConfigVarBase::ptr Config::LookupBase(const std::string& name) {
+    std::string buf;
+    const std::string& key = LowerKey(name, buf);
+    RWMutexType::ReadLock lock(GetMutex());
+    auto it = GetDatas().find(key);
+    return it == GetDatas().end() ? nullptr : it->second;
+}
+
+// 类型冲突记录
+struct ConfigTypeMismatch {
+    std::string name;
+    std::string type;           // 已注册的类型
+    std::string request_type;   // Lookup 时要求的类型
+};
+
+static std::vector<ConfigTypeMismatch>& GetMismatches() {
+    static std::vector<ConfigTypeMismatch> s_mismatches;
+    return s_mismatches;
+}
+
+void Config::OnTypeMismatch(ConfigVarBase::ptr var, const char* request_type) {
+    SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Lookup name=" << var->getName()
+        << " exists but type not " << request_type
+        << " real_type=" << var->getTypeName()
+        << " " << var->toString();
+
+    // 同一个冲突只记一次
+    RWMutexType::WriteLock lock(GetMutex());
+    for (auto& i : GetMismatches()) {
+        if (i.name == var->getName() && i.request_type == request_type) {
+            return;
+        }
+    }
+    GetMismatches().push_back({var->getName(), var->getTypeName(), request_type});
+}
+
+bool Config::Validate() {
+    RWMutexType::ReadLock lock(GetMutex());
+    auto& mismatches = GetMismatches();
+    for (auto& i : mismatches) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config validate: name=" << i.name
+            << " registered as " << i.type
+            << " but looked up as " << i.request_type;
+    }
+    return mismatches.empty();
+}
+
+// 合法字符表，只在第一次用时构造一次
+struct ConfigNameTable {
+    bool valid[256];
+    ConfigNameTable() {
+        memset(valid, 0, sizeof(valid));
+        for (int c = 'a'; c <= 'z'; ++c) {
+            valid[c] = true;
+        }
+        for (int c = 'A'; c <= 'Z'; ++c) {
+            valid[c] = true;
+        }
+        for (int c = '0'; c <= '9'; ++c) {
+            valid[c] = true;
+        }
+        valid[(unsigned char)'.'] = true;
+        valid[(unsigned char)'_'] = true;
+    }
+};
+
+bool Config::IsValidName(const std::string& name) {
+    static const ConfigNameTable s_table;
+    for (auto c : name) {
+        if (!s_table.valid[(unsigned char)c]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 把 YAML 树展开成 "a.b.c" -> node 的列表
+// 如 logs: - name: root 会展开成 "logs" 一项，system: port: 会展开成 "system" 和 "system.port"
+static void ListAllMember(const std::string& prefix,
+                          const YAML::Node& node,
+                          std::list<std::pair<std::string, const YAML::Node> >& output) {
+    if (!Config::IsValidName(prefix)) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config invalid name: " << prefix << " : " << node;
+        return;
+    }
+    output.push_back(std::make_pair(prefix, node));
+    if (node.IsMap()) {
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            ListAllMember(prefix.empty() ? it->first.Scalar()
+                    : prefix + "." + it->first.Scalar(), it->second, output);
+        }
+    }
+}
+
+void Config::LoadFromYaml(const YAML::Node& root) {
+    std::list<std::pair<std::string, const YAML::Node> > all_nodes;
+    ListAllMember("", root, all_nodes);
+
+    for (auto& i : all_nodes) {
+        std::string key = i.first;
+        if (key.empty()) {
+            continue;
+        }
+
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        ConfigVarBase::ptr var = LookupBase(key);
+
+        // 只有约定过（Lookup 过）的配置项才会被更新
+        if (var) {
+            if (i.second.IsScalar()) {
+                SetFromSource(var, i.second.Scalar(), ConfigSource::YAML);
+            } else {
+                std::stringstream ss;
+                ss << i.second;
+                SetFromSource(var, ss.str(), ConfigSource::YAML);
+            }
+        }
+    }
+}
+
+void Config::LoadFromConfDir(const std::string& path) {
+    std::vector<std::string> files;
+    FSUtil::ListAllFile(files, path, ".yml");
+
+    for (auto& i : files) {
+        try {
+            YAML::Node root = YAML::LoadFile(i);
+            LoadFromYaml(root);
+            SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "LoadConfFile file=" << i << " ok";
+        } catch (...) {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "LoadConfFile file=" << i << " failed";
+        }
+    }
+}
+
+// 二进制快照格式（本机字节序，只给同一台机器/同一构建用）：
+// SnapshotHeader | SnapshotFile * file_count | SnapshotEntry * entry_count | 字符串区
+// 所有 off 都是相对字符串区开头的偏移
+static const char s_snapshot_magic[4] = {'S', 'Y', 'C', 'F'};
+static const uint32_t s_snapshot_version = 1;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t file_count;
+    uint32_t entry_count;
+    uint64_t total_size;    // 整个文件大小，用于发现截断的快照
+};
+
+// 源文件信息，用于判断快照是否过期
+struct SnapshotFile {
+    uint32_t path_off;      // 相对配置目录的路径
+    uint32_t path_len;
+    uint64_t size;
+    int64_t mtime_ns;
+};
+
+// 值的类型：标量直接交给 fromString，不经过 YAML
+enum SnapshotKind {
+    SNAPSHOT_SCALAR = 1,
+    SNAPSHOT_YAML = 2,      // map/sequence，保存为 YAML 文本，加载时还要解析，没有加速
+};
+
+struct SnapshotEntry {
+    uint32_t key_off;
+    uint32_t key_len;
+    uint32_t val_off;
+    uint32_t val_len;
+    uint32_t kind;
+    uint32_t reserved;
+};
+
+// 列出配置目录下的源文件及其大小、修改时间，路径为相对路径
+static bool ListSnapshotSources(const std::string& conf_dir,
+        std::vector<std::pair<std::string, SnapshotFile> >& out) {
+    std::vector<std::string> files;
+    FSUtil::ListAllFile(files, conf_dir, ".yml");
+    for (auto& i : files) {
+        struct stat st;
+        if (stat(i.c_str(), &st)) {
+            return false;
+        }
+        SnapshotFile f;
+        memset(&f, 0, sizeof(f));
+        f.size = st.st_size;
+        f.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        out.push_back(std::make_pair(i.substr(conf_dir.size()), f));
+    }
+    return true;
+}
+
+bool Config::BuildSnapshot(const std::string& conf_dir, const std::string& snapshot_file) {
+    std::vector<std::pair<std::string, SnapshotFile> > sources;
+    if (!ListSnapshotSources(conf_dir, sources)) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "BuildSnapshot stat conf_dir=" << conf_dir << " failed";
+        return false;
+    }
+
+    // key -> (kind, value)，后面的文件覆盖前面的，和 LoadFromConfDir 的结果一致
+    std::map<std::string, std::pair<uint32_t, std::string> > entries;
+    for (auto& i : sources) {
+        std::string file = conf_dir + i.first;
+        std::list<std::pair<std::string, const YAML::Node> > all_nodes;
+        try {
+            ListAllMember("", YAML::LoadFile(file), all_nodes);
+        } catch (std::exception& e) {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "BuildSnapshot load file=" << file
+                << " failed: " << e.what();
+            return false;
+        }
+        for (auto& n : all_nodes) {
+            std::string key = n.first;
+            if (key.empty()) {
+                continue;
+            }
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            if (n.second.IsScalar()) {
+                entries[key] = std::make_pair((uint32_t)SNAPSHOT_SCALAR, n.second.Scalar());
+            } else {
+                std::stringstream ss;
+                ss << n.second;
+                entries[key] = std::make_pair((uint32_t)SNAPSHOT_YAML, ss.str());
+            }
+        }
+    }
+
+    std::string strs;
+    std::vector<SnapshotFile> files;
+    for (auto& i : sources) {
+        SnapshotFile f = i.second;
+        f.path_off = strs.size();
+        f.path_len = i.first.size();
+        strs.append(i.first);
+        files.push_back(f);
+    }
+    std::vector<SnapshotEntry> ents;
+    for (auto& i : entries) {
+        SnapshotEntry e;
+        memset(&e, 0, sizeof(e));
+        e.key_off = strs.size();
+        e.key_len = i.first.size();
+        strs.append(i.first);
+        e.val_off = strs.size();
+        e.val_len = i.second.second.size();
+        strs.append(i.second.second);
+        e.kind = i.second.first;
+        ents.push_back(e);
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, s_snapshot_magic, sizeof(header.magic));
+    header.version = s_snapshot_version;
+    header.file_count = files.size();
+    header.entry_count = ents.size();
+    header.total_size = sizeof(header) + files.size() * sizeof(SnapshotFile)
+                        + ents.size() * sizeof(SnapshotEntry) + strs.size();
+
+    // 先写临时文件再 rename，读的一方不会看到写了一半的快照
+    std::string tmp = snapshot_file + ".tmp";
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "BuildSnapshot open file=" << tmp << " failed";
+        return false;
+    }
+    ofs.write((const char*)&header, sizeof(header));
+    if (!files.empty()) {
+        ofs.write((const char*)&files[0], files.size() * sizeof(SnapshotFile));
+    }
+    if (!ents.empty()) {
+        ofs.write((const char*)&ents[0], ents.size() * sizeof(SnapshotEntry));
+    }
+    ofs.write(strs.c_str(), strs.size());
+    ofs.close();
+    if (!ofs || rename(tmp.c_str(), snapshot_file.c_str())) {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "BuildSnapshot write file=" << snapshot_file << " failed";
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// 检查快照并填充配置项，快照不可用返回 false
+static bool ApplySnapshot(const char* base, size_t len, const std::string& conf_dir) {
+    if (len < sizeof(SnapshotHeader)) {
+        return false;
+    }
+    const SnapshotHeader* header = (const SnapshotHeader*)base;
+    if (memcmp(header->magic, s_snapshot_magic, sizeof(header->magic))
+            || header->version != s_snapshot_version
+            || header->total_size != len) {
+        return false;
+    }
+    size_t tables = sizeof(SnapshotHeader)
+                    + (size_t)header->file_count * sizeof(SnapshotFile)
+                    + (size_t)header->entry_count * sizeof(SnapshotEntry);
+    if (tables > len) {
+        return false;
+    }
+    const SnapshotFile* files = (const SnapshotFile*)(base + sizeof(SnapshotHeader));
+    const SnapshotEntry* ents = (const SnapshotEntry*)(files + header->file_count);
+    const char* strs = base + tables;
+    size_t strs_len = len - tables;
+
+    // 源文件集合、大小、修改时间都一致才算新鲜
+    std::vector<std::pair<std::string, SnapshotFile> > sources;
+    if (!ListSnapshotSources(conf_dir, sources)
+            || sources.size() != header->file_count) {
+        return false;
+    }
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const SnapshotFile& f = files[i];
+        if ((uint64_t)f.path_off + f.path_len > strs_len
+                || sources[i].first.size() != f.path_len
+                || memcmp(sources[i].first.c_str(), strs + f.path_off, f.path_len)
+                || sources[i].second.size != f.size
+                || sources[i].second.mtime_ns != f.mtime_ns) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->entry_count; ++i) {
+        const SnapshotEntry& e = ents[i];
+        if ((uint64_t)e.key_off + e.key_len > strs_len
+                || (uint64_t)e.val_off + e.val_len > strs_len) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->entry_count; ++i) {
+        const SnapshotEntry& e = ents[i];
+        ConfigVarBase::ptr var = Config::LookupBase(std::string(strs + e.key_off, e.key_len));
+        if (var) {
+            Config::SetFromSource(var, std::string(strs + e.val_off, e.val_len),
+                                  ConfigSource::YAML);
+        }
+    }
+    return true;
+}
+
+bool Config::LoadSnapshot(const std::string& snapshot_file, const std::string& conf_dir) {
+    bool ok = false;
+    int fd = open(snapshot_file.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (!fstat(fd, &st) && st.st_size > 0) {
+            void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (base != MAP_FAILED) {
+                ok = ApplySnapshot((const char*)base, st.st_size, conf_dir);
+                munmap(base, st.st_size);
+            }
+        }
+        close(fd);
+    }
+
+    if (!ok) {
+        SYLAR_LOG_WARN(SYLAR_LOG_ROOT()) << "LoadSnapshot file=" << snapshot_file
+            << " missing or stale, fallback to yaml conf_dir=" << conf_dir;
+        LoadFromConfDir(conf_dir);
+    }
+    return ok;
+}
+
+bool Config::SetFromSource(ConfigVarBase::ptr var, const std::string& val,
+                           ConfigSource::Type source) {
+    if (source < var->getSource()) {
+        return false;
+    }
+    if (!var->fromString(val)) {
+        return false;
+    }
+    var->setSource(source);
+    return true;
+}
+
+ConfigSource::Type Config::GetSource(const std::string& name) {
+    ConfigVarBase::ptr var = LookupBase(name);
+    return var ? var->getSource() : ConfigSource::DEFAULT;
+}
+
+void Config::LoadFromEnv(const std::string& prefix) {
+    // 环境变量的 key 不好反推配置名（'_' 可能本来就在名字里），所以从已注册的配置项正向拼
+    // 先拷一份，设置值时会调监听者，不在注册表的锁里做
+    ConfigVarMap datas;
+    {
+        RWMutexType::ReadLock lock(GetMutex());
+        datas = GetDatas();
+    }
+    for (auto& i : datas) {
+        std::string env = prefix + i.first;
+        for (auto& c : env) {
+            c = (c == '.') ? '_' : toupper(c);
+        }
+        const char* v = getenv(env.c_str());
+        if (v) {
+            SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "Config env " << env << "=" << v;
+            SetFromSource(i.second, v, ConfigSource::ENV);
+        }
+    }
+}
+
+void Config::LoadFromArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--", 2)) {
+            continue;
+        }
+        const char* eq = strchr(arg + 2, '=');
+        if (!eq) {
+            continue;
+        }
+        std::string key(arg + 2, eq - arg - 2);
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        ConfigVarBase::ptr var = LookupBase(key);
+        if (var) {
+            SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "Config argv " << key << "=" << (eq + 1);
+            SetFromSource(var, eq + 1, ConfigSource::ARGV);
+        }
+    }
+}
+
+void Config::LoadAll(const std::string& conf_dir, int argc, char** argv) {
+    LoadFromConfDir(conf_dir);
+    LoadFromEnv();
+    LoadFromArgs(argc, argv);
+}
 
 } // namespace sylar
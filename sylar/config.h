@@ -4,46 +4,347 @@
 #include <memory>                   // 智能指针
 #include <sstream>                  // 系列化
 #include <string>
-#include <boost/lexical_cast.hpp>   // 内存转换  
+#include <vector>
+#include <list>
+#include <set>
+#include <map>
+#include <unordered_set>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <boost/lexical_cast.hpp>   // 内存转换
+#include <yaml-cpp/yaml.h>
 #include "log.h"
+#include "macro.h"
+#include "mutex.h"
 
 
 namespace sylar
 {
 
+// 类型标签：每个类型一个静态变量，取它的地址作为标签
+// 比较指针就能判断类型是否一致，不需要 dynamic_pointer_cast
+template<class T>
+const void* TypeTag() {
+    static const char s_tag = 0;
+    return &s_tag;
+}
+
+// 配置值的来源层，数值越大优先级越高
+// 高层设置过的值不会被低层覆盖，如环境变量设置后重新加载 YAML 不会改掉它
+class ConfigSource
+{
+public:
+    enum Type {
+        DEFAULT = 0,    // Lookup 时的默认值
+        YAML = 1,       // 配置文件（含二进制快照）
+        ENV = 2,        // 环境变量，如 SYLAR_SYSTEM_PORT
+        ARGV = 3        // 命令行，如 --system.port=8080
+    };
+
+    static const char* ToString(ConfigSource::Type type);
+};
+
 // 参数基类
-class ConfigVarBase 
+class ConfigVarBase
 {
 public:
     typedef std::shared_ptr<ConfigVarBase> ptr;
-    ConfigVarBase(const std::string& name, const std::string& description = "") 
+    ConfigVarBase(const std::string& name, const void* type_tag,
+                  const char* type_name, const std::string& description = "")
         :m_name(name)
-        ,m_description(description) {
-
+        ,m_description(description)
+        ,m_typeTag(type_tag)
+        ,m_typeName(type_name) {
+        // 配置名不区分大小写，统一转为小写
+        std::transform(m_name.begin(), m_name.end(), m_name.begin(), ::tolower);
     }
     virtual ~ConfigVarBase() {}
 
     const std::string& getName() const { return m_name;}
     const std::string& getDescription() const { return m_description;}
+    const void* getTypeTag() const { return m_typeTag;}
+    const char* getTypeName() const { return m_typeName;}    // 值类型的可读名称
+    ConfigSource::Type getSource() const { return m_source;}
+    void setSource(ConfigSource::Type v) { m_source = v;}
 
     virtual std::string toString() = 0; // 转换为明文，调试或输出到文件
     virtual bool fromString(const std::string& val) = 0;    // 解析
 protected:
     std::string m_name;
     std::string m_description;
+    const void* m_typeTag;      // 具体 ConfigVar 类型的标签
+    const char* m_typeName;     // 值类型名，类型冲突时输出
+    std::atomic<ConfigSource::Type> m_source{ConfigSource::DEFAULT};   // 当前值来自哪一层
+};
+
+// 类型转换模板类，F 源类型，T 目标类型，基础类型直接用 lexical_cast
+template<class F, class T>
+class LexicalCast
+{
+public:
+    T operator()(const F& v) {
+        return boost::lexical_cast<T>(v);
+    }
+};
+
+// 偏特化：YAML string 转 std::vector<T>
+template<class T>
+class LexicalCast<std::string, std::vector<T> >
+{
+public:
+    std::vector<T> operator()(const std::string& v) {
+        YAML::Node node = YAML::Load(v);
+        typename std::vector<T> vec;
+        std::stringstream ss;
+        for (size_t i = 0; i < node.size(); ++i) {
+            ss.str("");
+            ss << node[i];
+            vec.push_back(LexicalCast<std::string, T>()(ss.str()));
+        }
+        return vec;
+    }
+};
+
+// 偏特化：std::vector<T> 转 YAML string
+template<class T>
+class LexicalCast<std::vector<T>, std::string>
+{
+public:
+    std::string operator()(const std::vector<T>& v) {
+        YAML::Node node(YAML::NodeType::Sequence);
+        for (auto& i : v) {
+            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+// 偏特化：YAML string 转 std::list<T>
+template<class T>
+class LexicalCast<std::string, std::list<T> >
+{
+public:
+    std::list<T> operator()(const std::string& v) {
+        YAML::Node node = YAML::Load(v);
+        typename std::list<T> vec;
+        std::stringstream ss;
+        for (size_t i = 0; i < node.size(); ++i) {
+            ss.str("");
+            ss << node[i];
+            vec.push_back(LexicalCast<std::string, T>()(ss.str()));
+        }
+        return vec;
+    }
+};
+
+// 偏特化：std::list<T> 转 YAML string
+template<class T>
+class LexicalCast<std::list<T>, std::string>
+{
+public:
+    std::string operator()(const std::list<T>& v) {
+        YAML::Node node(YAML::NodeType::Sequence);
+        for (auto& i : v) {
+            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+// 偏特化：YAML string 转 std::set<T>
+template<class T>
+class LexicalCast<std::string, std::set<T> >
+{
+public:
+    std::set<T> operator()(const std::string& v) {
+        YAML::Node node = YAML::Load(v);
+        typename std::set<T> vec;
+        std::stringstream ss;
+        for (size_t i = 0; i < node.size(); ++i) {
+            ss.str("");
+            ss << node[i];
+            vec.insert(LexicalCast<std::string, T>()(ss.str()));
+        }
+        return vec;
+    }
+};
+
+// 偏特化：std::set<T> 转 YAML string
+template<class T>
+class LexicalCast<std::set<T>, std::string>
+{
+public:
+    std::string operator()(const std::set<T>& v) {
+        YAML::Node node(YAML::NodeType::Sequence);
+        for (auto& i : v) {
+            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+// 偏特化：YAML string 转 std::unordered_set<T>
+template<class T>
+class LexicalCast<std::string, std::unordered_set<T> >
+{
+public:
+    std::unordered_set<T> operator()(const std::string& v) {
+        YAML::Node node = YAML::Load(v);
+        typename std::unordered_set<T> vec;
+        std::stringstream ss;
+        for (size_t i = 0; i < node.size(); ++i) {
+            ss.str("");
+            ss << node[i];
+            vec.insert(LexicalCast<std::string, T>()(ss.str()));
+        }
+        return vec;
+    }
+};
+
+// 偏特化：std::unordered_set<T> 转 YAML string
+template<class T>
+class LexicalCast<std::unordered_set<T>, std::string>
+{
+public:
+    std::string operator()(const std::unordered_set<T>& v) {
+        YAML::Node node(YAML::NodeType::Sequence);
+        for (auto& i : v) {
+            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+// 偏特化：YAML string 转 std::map<std::string, T>
+template<class T>
+class LexicalCast<std::string, std::map<std::string, T> >
+{
+public:
+    std::map<std::string, T> operator()(const std::string& v) {
+        YAML::Node node = YAML::Load(v);
+        typename std::map<std::string, T> vec;
+        std::stringstream ss;
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            ss.str("");
+            ss << it->second;
+            vec.insert(std::make_pair(it->first.Scalar(),
+                        LexicalCast<std::string, T>()(ss.str())));
+        }
+        return vec;
+    }
+};
+
+// 偏特化：std::map<std::string, T> 转 YAML string
+template<class T>
+class LexicalCast<std::map<std::string, T>, std::string>
+{
+public:
+    std::string operator()(const std::map<std::string, T>& v) {
+        YAML::Node node(YAML::NodeType::Map);
+        for (auto& i : v) {
+            node[i.first] = YAML::Load(LexicalCast<T, std::string>()(i.second));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+// 偏特化：YAML string 转 std::unordered_map<std::string, T>
+template<class T>
+class LexicalCast<std::string, std::unordered_map<std::string, T> >
+{
+public:
+    std::unordered_map<std::string, T> operator()(const std::string& v) {
+        YAML::Node node = YAML::Load(v);
+        typename std::unordered_map<std::string, T> vec;
+        std::stringstream ss;
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            ss.str("");
+            ss << it->second;
+            vec.insert(std::make_pair(it->first.Scalar(),
+                        LexicalCast<std::string, T>()(ss.str())));
+        }
+        return vec;
+    }
+};
+
+// 偏特化：std::unordered_map<std::string, T> 转 YAML string
+template<class T>
+class LexicalCast<std::unordered_map<std::string, T>, std::string>
+{
+public:
+    std::string operator()(const std::unordered_map<std::string, T>& v) {
+        YAML::Node node(YAML::NodeType::Map);
+        for (auto& i : v) {
+            node[i.first] = YAML::Load(LexicalCast<T, std::string>()(i.second));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+// 配置值的存储，读不加锁，写由 ConfigVar::setValue 串行
+// 不超过 8 字节的可平凡复制类型（int、float、bool 等）直接放 std::atomic
+// 其它类型（string、容器）每次写换一个新的 shared_ptr<const T>，读者 atomic_load 拿快照
+template<class T, bool IsAtomic = std::is_trivially_copyable<T>::value && sizeof(T) <= sizeof(uint64_t)>
+class ConfigValue
+{
+public:
+    explicit ConfigValue(const T& v)
+        :m_val(new T(v)) {
+    }
+    T load() const { return *std::atomic_load(&m_val);}
+    void store(const T& v) {
+        std::shared_ptr<const T> p(new T(v));
+        std::atomic_store(&m_val, p);
+    }
+private:
+    std::shared_ptr<const T> m_val;
 };
 
-// 具体实现类，基础类型得类
 template<class T>
+class ConfigValue<T, true>
+{
+public:
+    explicit ConfigValue(const T& v)
+        :m_val(v) {
+    }
+    T load() const { return m_val.load(std::memory_order_acquire);}
+    void store(const T& v) { m_val.store(v, std::memory_order_release);}
+private:
+    std::atomic<T> m_val;
+};
+
+// 具体实现类
+// FromStr: T operator()(const std::string&)
+// ToStr: std::string operator()(const T&)
+template<class T, class FromStr = LexicalCast<std::string, T>
+                , class ToStr = LexicalCast<T, std::string> >
 class ConfigVar : public ConfigVarBase
 {
 public:
     typedef std::shared_ptr<ConfigVar> ptr;
-    
+    typedef DefaultRWMutex RWMutexType;
+    // 配置变更的回调，参数为旧值和新值
+    typedef std::function<void (const T& old_value, const T& new_value)> on_change_cb;
+
     ConfigVar(const std::string& name
             ,const T& default_value
             ,const std::string& description = "")
-        :ConfigVarBase(name, description)
+        :ConfigVarBase(name, TypeTag<ConfigVar>(), TypeToName<T>(), description)
         ,m_val(default_value) {
 
     }
@@ -51,79 +352,251 @@ public:
     // 把东西转为string，即转为明文，以便调试或输出到文件
     std::string toString() override {
         try {
-            return boost::lexical_cast<std::string>(m_val);
+            return ToStr()(getValue());
         } catch (std::exception& e) {
-            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::toString exception"
-                << e.what() << " convert: " << typeid(m_val).name() << " to string";
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::toString exception "
+                << e.what() << " convert: " << TypeToName<T>() << " to string";
         }
         return "";
     }
 
     bool fromString(const std::string& val) override {
         try {
-            m_val = boost::lexical_cast<T>(val);
+            setValue(FromStr()(val));
+            return true;
         } catch (std::exception& e) {
-            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::toString exception"
-                << e.what() << " convert: string to" << typeid(m_val).name();
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::fromString exception "
+                << e.what() << " convert: string to " << TypeToName<T>()
+                << " - " << val;
         }
         return false;
     }
 
-    const T getValue() const { return m_val;}
-    void setValue(const T& v) { m_val = v;}
+    // 不加锁，热路径上可以直接调
+    const T getValue() const { return m_val.load();}
+
+    // 值有变化才通知监听者，写者之间由 m_setMutex 串行，比较和替换之间不会插进别的写
+    // 多个线程同时 setValue 时按替换的顺序依次通知，监听者看到的新旧值和最终值对得上
+    // 监听者里 getValue 拿到的是新值，不能 setValue 同一个配置项
+    void setValue(const T& v) {
+        Mutex::Lock slock(m_setMutex);
+        T old_value = m_val.load();
+        if (v == old_value) {
+            return;
+        }
+        m_val.store(v);
+        std::map<uint64_t, on_change_cb> cbs;
+        {
+            RWMutexType::ReadLock lock(m_mutex);
+            cbs = m_cbs;
+        }
+        for (auto& i : cbs) {
+            i.second(old_value, v);
+        }
+    }
+
+    // 添加变更监听，返回监听的 key，用于删除
+    uint64_t addListener(on_change_cb cb) {
+        static std::atomic<uint64_t> s_fun_id{0};
+        uint64_t id = ++s_fun_id;
+        RWMutexType::WriteLock lock(m_mutex);
+        m_cbs[id] = cb;
+        return id;
+    }
+
+    void delListener(uint64_t key) {
+        RWMutexType::WriteLock lock(m_mutex);
+        m_cbs.erase(key);
+    }
+
+    on_change_cb getListener(uint64_t key) {
+        RWMutexType::ReadLock lock(m_mutex);
+        auto it = m_cbs.find(key);
+        return it == m_cbs.end() ? nullptr : it->second;
+    }
+
+    void clearListener() {
+        RWMutexType::WriteLock lock(m_mutex);
+        m_cbs.clear();
+    }
 private:
-    T m_val;
+    RWMutexType m_mutex;    // 保护 m_cbs
+    Mutex m_setMutex;       // 让 setValue 的替换和通知串行
+    ConfigValue<T> m_val;
+    std::map<uint64_t, on_change_cb> m_cbs;     // 变更回调集合
 };
 
 // 管理的类
 class Config
 {
 public:
-    typedef std::map<std::string, ConfigVarBase::ptr> ConfigVarMap;
+    typedef std::unordered_map<std::string, ConfigVarBase::ptr> ConfigVarMap;
+    typedef DefaultRWMutex RWMutexType;
 
     // 定义类：功能：定义的时候就可以给他赋值
     template<class T>
     static typename ConfigVar<T>::ptr Lookup(const std::string& name,
-            const T& default_value, const std::string& description = "") 
+            const T& default_value, const std::string& description = "")
     {
-        auto tmp = Lookup<T>(name);
-        // 定义初始化的时候看能不能找到name，找到了直接就返回
-        if (tmp) {
-            SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "Looup name=" << name << " exists";
-            return tmp;
-        }  
-
         // 没有名字，或名字不在规定范围内
-        if (name.find_first_not_of("abcdefghijlmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ._0123456789") 
-                != std::string::npos) {
+        if (!IsValidName(name)) {
             SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Lookup name invalid " << name;
             throw std::invalid_argument(name);
         }
 
-        typename ConfigVar<T>::ptr v(new ConfigVar<T>(name, default_value, description));
-        s_datas[name] = v;
-        return v;
+        // 定义初始化的时候看能不能找到name，找到了直接就返回
+        // 找到了但类型不一致，记录冲突并返回 nullptr，不能覆盖已有的配置项
+        // 查找和插入在同一把写锁里，两个线程同时定义同一个名字只会创建一次
+        // 名字不区分大小写，按小写查，和插入时的 key 一致
+        std::string buf;
+        const std::string& key = LowerKey(name, buf);
+        ConfigVarBase::ptr exist;
+        {
+            RWMutexType::WriteLock lock(GetMutex());
+            auto it = GetDatas().find(key);
+            if (it == GetDatas().end()) {
+                typename ConfigVar<T>::ptr v(new ConfigVar<T>(name, default_value, description));
+                GetDatas()[v->getName()] = v;
+                return v;
+            }
+            exist = it->second;
+        }
+        auto tmp = Cast<T>(exist);
+        if (tmp) {
+            SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "Looup name=" << name << " exists";
+        }
+        return tmp;
     }
 
     // 查找类
     template<class T>
-    static typename ConfigVar<T>::ptr Lookup(const std::string& name) 
+    static typename ConfigVar<T>::ptr Lookup(const std::string& name)
     {
-        auto it = s_datas.find(name);
-        if (it == s_datas.end()) {
+        ConfigVarBase::ptr var = LookupBase(name);
+        if (!var) {
             return nullptr; // 没找到
         }
-        // 找到了还需要先转为智能指针
-        return std::dynamic_pointer_cast<ConfigVar<T>>(it->second); 
-    
+        return Cast<T>(var);
     }
+
+    // 用 YAML 节点更新已注册的配置项，未注册的 key 忽略
+    static void LoadFromYaml(const YAML::Node& root);
+
+    // 用环境变量覆盖已注册的配置项：system.port 对应 <prefix>SYSTEM_PORT
+    static void LoadFromEnv(const std::string& prefix = "SYLAR_");
+
+    // 用命令行覆盖已注册的配置项，格式 --system.port=8080，不认识的参数忽略
+    static void LoadFromArgs(int argc, char** argv);
+
+    // 启动时调用一次，按 YAML < 环境变量 < 命令行 的优先级加载
+    static void LoadAll(const std::string& conf_dir, int argc, char** argv);
+
+    // 配置项当前值来自哪一层，配置项不存在返回 DEFAULT
+    static ConfigSource::Type GetSource(const std::string& name);
+
+    // 按来源设置配置项：来源优先级低于当前值的来源时不修改，返回 false
+    static bool SetFromSource(ConfigVarBase::ptr var, const std::string& val,
+                              ConfigSource::Type source);
+
+    // 加载目录下所有 .yml 文件，按文件名顺序，后加载的覆盖先加载的
+    static void LoadFromConfDir(const std::string& path);
+
+    // 把配置目录编译成二进制快照：key 表 + 带类型的值，记录每个源文件的大小和修改时间
+    // 只有标量值省掉了 YAML 解析；map、sequence（比如 logs）按 YAML 文本保存，
+    // 加载时仍由 fromString 解析 YAML，这类配置项用快照没有加速，见 test_config_snapshot
+    // 成功返回 true
+    static bool BuildSnapshot(const std::string& conf_dir, const std::string& snapshot_file);
+
+    // mmap 快照并直接填充配置项，不解析 YAML
+    // 快照不存在、损坏、版本不对或比配置目录旧时，退回 LoadFromConfDir，返回 false
+    static bool LoadSnapshot(const std::string& snapshot_file, const std::string& conf_dir);
+
+    // 不关心类型的查找，名字不区分大小写
+    static ConfigVarBase::ptr LookupBase(const std::string& name);
+
+    // 配置名只能由字母、数字、'.'、'_' 组成
+    static bool IsValidName(const std::string& name);
+
+    // 启动时调用：把所有类型冲突的 Lookup 输出出来，有冲突返回 false
+    static bool Validate();
 private:
-    static ConfigVarMap s_datas;
+    // 类型标签一致才转换，不一致记录冲突，返回 nullptr
+    template<class T>
+    static typename ConfigVar<T>::ptr Cast(ConfigVarBase::ptr var) {
+        if (var->getTypeTag() != TypeTag<ConfigVar<T> >()) {
+            OnTypeMismatch(var, TypeToName<T>());
+            return nullptr;
+        }
+        return std::static_pointer_cast<ConfigVar<T> >(var);
+    }
+
+    // 查找用的小写 key：名字本来就是小写（常见情况）时直接返回 name，不拷贝；
+    // 否则转成小写放进 buf 返回
+    static const std::string& LowerKey(const std::string& name, std::string& buf) {
+        for (auto c : name) {
+            if (c >= 'A' && c <= 'Z') {
+                buf = name;
+                std::transform(buf.begin(), buf.end(), buf.begin(), ::tolower);
+                return buf;
+            }
+        }
+        return name;
+    }
+
+    // 同名不同类型的 Lookup，记录下来并输出两边的类型
+    static void OnTypeMismatch(ConfigVarBase::ptr var, const char* request_type);
+
+    // 静态成员放在函数里，避免和其他编译单元的全局变量初始化顺序不确定
+    static ConfigVarMap& GetDatas() {
+        static ConfigVarMap s_datas;
+        return s_datas;
+    }
+
+    // 保护 s_datas 和类型冲突记录
+    static RWMutexType& GetMutex() {
+        static RWMutexType s_mutex;
+        return s_mutex;
+    }
 };
 
 
-    
+
+// 配置项句柄：第一次访问时查找并缓存，之后直接用缓存的指针
+// 配置项注册后不会删除，注册表一直持有它，缓存裸指针就够了，取值不用动引用计数
+// 多个线程同时第一次访问时各自查找，写进去的是同一个指针；没找到时下次再查
+// 用法：static ConfigHandle<int> s_port("system.port"); s_port->getValue();
+template<class T>
+class ConfigHandle
+{
+public:
+    ConfigHandle(const std::string& name)
+        :m_name(name)
+        ,m_var(nullptr) {
+    }
+
+    ConfigVar<T>* get() {
+        ConfigVar<T>* var = m_var.load(std::memory_order_acquire);
+        if (SYLAR_UNLIKELY(!var)) {
+            var = Config::Lookup<T>(m_name).get();
+            m_var.store(var, std::memory_order_release);
+        }
+        return var;
+    }
+
+    // 没注册或类型不对时断言失败，而不是在后面解引用空指针
+    ConfigVar<T>* operator->() {
+        ConfigVar<T>* var = get();
+        SYLAR_ASSERT2(var, "ConfigHandle name=" << m_name << " not found or type not " << TypeToName<T>());
+        return var;
+    }
+    explicit operator bool() { return !!get();}
+    const std::string& getName() const { return m_name;}
+private:
+    std::string m_name;
+    std::atomic<ConfigVar<T>*> m_var;
+};
+
 } // namespace sylar
 
 
-#endif // !__SYLAR_CONFIG_H__
\ No newline at end of file
+#endif // !__SYLAR_CONFIG_H__
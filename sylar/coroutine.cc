@@ -0,0 +1,304 @@
+#include "coroutine.h"
+#include "log.h"
+#include "thread.h"
+#include "util.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <queue>
+#include <vector>
+
+#ifdef SYLAR_SINGLE_THREAD
+#error "CoReactor runs a background thread, sylar_coro can not be built with SYLAR_SINGLE_THREAD"
+#endif
+
+namespace sylar
+{
+
+static Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+void CoResume(Scheduler* sc, std::coroutine_handle<> h) {
+    if (sc) {
+        sc->schedule([h]() {
+            h.resume();
+        });
+    } else {
+        h.resume();
+    }
+}
+
+// 定时器和 fd 就绪事件，一个后台线程 epoll_wait，到期/就绪后把协程放回它的调度器
+// 还没有 IOManager 和定时器模块，先用这个给无栈协程用
+class CoReactor : Noncopyable
+{
+public:
+    static CoReactor* GetInstance() {
+        static CoReactor* s_reactor = new CoReactor;
+        return s_reactor;
+    }
+
+    void addTimer(uint64_t ms, Scheduler* sc, std::coroutine_handle<> h) {
+        addTimer(ms, sc, h, -1, 0, 0);
+    }
+
+    // 等 fd 上的 event（EPOLLIN/EPOLLOUT），同一个 fd 同一个方向只能有一个等待者
+    // 就绪后 *ready = true，超时 *ready = false，然后恢复协程；注册失败返回 false
+    bool addEvent(int fd, uint32_t event, uint64_t timeout_ms, Scheduler* sc,
+                  std::coroutine_handle<> h, bool* ready) {
+        MutexType::Lock lock(m_mutex);
+        if (fd < 0) {
+            return false;
+        }
+        if ((size_t)fd >= m_fds.size()) {
+            m_fds.resize(fd * 3 / 2 + 1);
+        }
+        FdContext& ctx = m_fds[fd];
+        FdWaiter& w = event == EPOLLIN ? ctx.read : ctx.write;
+        if (w.handle) {
+            SYLAR_LOG_ERROR(g_logger) << "CoReactor fd=" << fd << " event=" << event
+                << " already has a waiter";
+            return false;
+        }
+        uint32_t events = ctx.events | event;
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.fd = fd;
+        int rt = epoll_ctl(m_epfd, ctx.events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+        if (rt) {
+            SYLAR_LOG_ERROR(g_logger) << "CoReactor epoll_ctl fd=" << fd
+                << " errno=" << errno << " errstr=" << strerror(errno);
+            return false;
+        }
+        ctx.events = events;
+        w.handle = h;
+        w.scheduler = sc;
+        w.ready = ready;
+        w.seq = ++m_seq;
+        if (timeout_ms) {
+            // 解锁后 w 可能已经被后台线程唤醒清掉，seq 要先取出来
+            uint64_t seq = w.seq;
+            lock.unlock();
+            addTimer(timeout_ms, sc, h, fd, event, seq);
+        }
+        return true;
+    }
+private:
+    typedef Mutex MutexType;
+
+    struct FdWaiter {
+        std::coroutine_handle<> handle;
+        Scheduler* scheduler = nullptr;
+        bool* ready = nullptr;
+        uint64_t seq = 0;
+    };
+
+    struct FdContext {
+        uint32_t events = 0;
+        FdWaiter read;
+        FdWaiter write;
+    };
+
+    struct Timer {
+        uint64_t deadline;
+        uint64_t seq;
+        Scheduler* scheduler;
+        std::coroutine_handle<> handle;
+        // fd 等待的超时，fd 先就绪时 seq 对不上，忽略
+        int fd;
+        uint32_t event;
+        uint64_t fd_seq;
+
+        bool operator>(const Timer& rhs) const {
+            return deadline != rhs.deadline ? deadline > rhs.deadline : seq > rhs.seq;
+        }
+    };
+
+    CoReactor() {
+        m_epfd = epoll_create1(EPOLL_CLOEXEC);
+        m_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = m_eventfd;
+        epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_eventfd, &ev);
+        m_thread.reset(new Thread(std::bind(&CoReactor::run, this), "co_reactor"));
+    }
+
+    void addTimer(uint64_t ms, Scheduler* sc, std::coroutine_handle<> h,
+                  int fd, uint32_t event, uint64_t fd_seq) {
+        bool at_front = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            Timer t{GetCurrentMS() + ms, ++m_seq, sc, h, fd, event, fd_seq};
+            at_front = m_timers.empty() || t.deadline < m_timers.top().deadline;
+            m_timers.push(t);
+        }
+        if (at_front) {
+            // 比当前等待的超时更早，叫醒后台线程重新算
+            uint64_t one = 1;
+            ssize_t rt = write(m_eventfd, &one, sizeof(one));
+            (void)rt;
+        }
+    }
+
+    // 取出到期的定时器，返回下一次 epoll_wait 的超时，需要持有 m_mutex
+    int expireTimers(std::vector<FdWaiter>& wake) {
+        uint64_t now = GetCurrentMS();
+        while (!m_timers.empty() && m_timers.top().deadline <= now) {
+            Timer t = m_timers.top();
+            m_timers.pop();
+            if (t.fd_seq) {
+                // fd 等待超时：等待者还在才算数
+                FdWaiter* w = findWaiter(t.fd, t.event);
+                if (!w || w->seq != t.fd_seq) {
+                    continue;
+                }
+                *w->ready = false;
+                wake.push_back(*w);
+                removeWaiter(t.fd, t.event);
+            } else {
+                FdWaiter w;
+                w.handle = t.handle;
+                w.scheduler = t.scheduler;
+                wake.push_back(w);
+            }
+        }
+        if (m_timers.empty()) {
+            return -1;
+        }
+        uint64_t wait = m_timers.top().deadline - now;
+        return wait > 60000 ? 60000 : (int)wait;
+    }
+
+    FdWaiter* findWaiter(int fd, uint32_t event) {
+        if (fd < 0 || (size_t)fd >= m_fds.size()) {
+            return nullptr;
+        }
+        FdWaiter& w = event == EPOLLIN ? m_fds[fd].read : m_fds[fd].write;
+        return w.handle ? &w : nullptr;
+    }
+
+    // 去掉一个方向的等待，剩下的方向重新注册，没有了就从 epoll 里删掉
+    void removeWaiter(int fd, uint32_t event) {
+        FdContext& ctx = m_fds[fd];
+        (event == EPOLLIN ? ctx.read : ctx.write) = FdWaiter();
+        ctx.events &= ~event;
+        if (ctx.events) {
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = ctx.events;
+            ev.data.fd = fd;
+            epoll_ctl(m_epfd, EPOLL_CTL_MOD, fd, &ev);
+        } else {
+            epoll_ctl(m_epfd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+    }
+
+    void run() {
+        const int max_events = 256;
+        struct epoll_event events[max_events];
+        std::vector<FdWaiter> wake;
+        int timeout = -1;
+        while (true) {
+            int n = epoll_wait(m_epfd, events, max_events, timeout);
+            if (n < 0 && errno != EINTR) {
+                SYLAR_LOG_ERROR(g_logger) << "CoReactor epoll_wait errno=" << errno
+                    << " errstr=" << strerror(errno);
+            }
+            {
+                MutexType::Lock lock(m_mutex);
+                for (int i = 0; i < n; ++i) {
+                    int fd = events[i].data.fd;
+                    if (fd == m_eventfd) {
+                        uint64_t v;
+                        while (read(m_eventfd, &v, sizeof(v)) > 0);
+                        continue;
+                    }
+                    uint32_t revents = events[i].events;
+                    // 出错或者挂断时两个方向都唤醒，由协程自己去读写发现错误
+                    if (revents & (EPOLLERR | EPOLLHUP)) {
+                        revents |= EPOLLIN | EPOLLOUT;
+                    }
+                    for (uint32_t ev : {(uint32_t)EPOLLIN, (uint32_t)EPOLLOUT}) {
+                        FdWaiter* w = (revents & ev) ? findWaiter(fd, ev) : nullptr;
+                        if (w) {
+                            *w->ready = true;
+                            wake.push_back(*w);
+                            removeWaiter(fd, ev);
+                        }
+                    }
+                }
+                timeout = expireTimers(wake);
+            }
+            // 放回调度器在锁外做
+            for (auto& i : wake) {
+                CoResume(i.scheduler, i.handle);
+            }
+            wake.clear();
+        }
+    }
+private:
+    MutexType m_mutex;
+    int m_epfd = -1;
+    int m_eventfd = -1;
+    uint64_t m_seq = 0;
+    std::vector<FdContext> m_fds;   // 下标是 fd
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer> > m_timers;
+    Thread::ptr m_thread;
+};
+
+void Sleep::await_suspend(std::coroutine_handle<> h) {
+    CoReactor::GetInstance()->addTimer(m_ms, Scheduler::GetThis(), h);
+}
+
+bool WaitReadable::await_suspend(std::coroutine_handle<> h) {
+    // 注册失败不挂起，co_await 返回 false
+    return CoReactor::GetInstance()->addEvent(m_fd, EPOLLIN, m_timeout,
+                Scheduler::GetThis(), h, &m_ready);
+}
+
+bool WaitWritable::await_suspend(std::coroutine_handle<> h) {
+    return CoReactor::GetInstance()->addEvent(m_fd, EPOLLOUT, m_timeout,
+                Scheduler::GetThis(), h, &m_ready);
+}
+
+void detail::DetachedTask::promise_type::unhandled_exception() {
+    try {
+        throw;
+    } catch (std::exception& ex) {
+        SYLAR_LOG_ERROR(g_logger) << "CoSpawn task exception: " << ex.what();
+    } catch (...) {
+        SYLAR_LOG_ERROR(g_logger) << "CoSpawn task unknown exception";
+    }
+}
+
+static detail::DetachedTask RunDetached(Task<void> task) {
+    co_await task;
+}
+
+void CoSpawn(Scheduler* sc, Task<void> task) {
+    detail::DetachedTask d = RunDetached(std::move(task));
+    CoResume(sc, d.m_handle);
+}
+
+void SyncWait(Scheduler* sc, Task<void> task) {
+    Semaphore sem;
+    std::exception_ptr ex;
+    CoSpawn(sc, [](Task<void> t, std::exception_ptr& e, Semaphore& s) -> Task<void> {
+        try {
+            co_await t;
+        } catch (...) {
+            e = std::current_exception();
+        }
+        s.notify();
+    }(std::move(task), ex, sem));
+    sem.wait();
+    if (ex) {
+        std::rethrow_exception(ex);
+    }
+}
+
+} // namespace sylar
@@ -0,0 +1,263 @@
+#ifndef __SYLAR_COROUTINE_H__
+#define __SYLAR_COROUTINE_H__
+
+// C++20 无栈协程，和有栈协程（Fiber）跑在同一个 Scheduler 上
+// 一个挂起的协程只占协程帧（几百字节），不占一整个栈，适合大量空闲连接
+// 只有打开 cmake -DSYLAR_COROUTINE=ON 时编译，库 sylar_coro 和用到它的代码用 -std=c++20，
+// 其余部分还是 C++11
+#if __cplusplus < 202002L
+#error "sylar/coroutine.h requires C++20, link sylar_coro (cmake -DSYLAR_COROUTINE=ON)"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <atomic>
+#include <utility>
+#include <stdint.h>
+#include "scheduler.h"
+#include "mutex.h"
+
+namespace sylar
+{
+
+template<class T>
+class Task;
+
+namespace detail
+{
+
+// 子协程在 await_suspend 里直接 resume，同步跑完时父协程不挂起，接着往下执行；
+// 中途挂起的话，谁后到谁负责继续：子协程结束时父协程已经挂起，就由子协程恢复父协程
+// 不依赖对称转移的尾调用（-O0 下不做尾调用，连续 co_await 会把栈压爆）
+struct FinalAwaiter {
+    bool await_ready() noexcept { return false;}
+
+    template<class Promise>
+    void await_suspend(std::coroutine_handle<Promise> h) noexcept {
+        auto& p = h.promise();
+        if (p.m_done.exchange(true, std::memory_order_acq_rel)) {
+            p.m_continuation.resume();
+        }
+    }
+
+    void await_resume() noexcept {}
+};
+
+struct PromiseBase {
+    std::suspend_always initial_suspend() noexcept { return {};}
+    FinalAwaiter final_suspend() noexcept { return {};}
+    void unhandled_exception() { m_exception = std::current_exception();}
+
+    // 父协程挂起完成和子协程结束，先到的一方置 true
+    std::atomic<bool> m_done {false};
+    std::coroutine_handle<> m_continuation;
+    std::exception_ptr m_exception;
+};
+
+} // namespace detail
+
+// 协程任务，创建后不执行，co_await 它或者交给 CoSpawn/SyncWait 时才开始
+// 只能 co_await 一次，析构时销毁协程帧
+template<class T = void>
+class Task
+{
+public:
+    struct promise_type : public detail::PromiseBase {
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        template<class U>
+        void return_value(U&& v) { m_value = std::forward<U>(v);}
+
+        T m_value{};
+    };
+
+    Task(Task&& rhs) noexcept
+        :m_handle(std::exchange(rhs.m_handle, nullptr)) {
+    }
+
+    ~Task() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool await_ready() const noexcept { return !m_handle || m_handle.done();}
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        m_handle.promise().m_continuation = h;
+        m_handle.resume();
+        // 子协程已经结束就不挂起
+        return !m_handle.promise().m_done.exchange(true, std::memory_order_acq_rel);
+    }
+
+    T await_resume() {
+        if (m_handle.promise().m_exception) {
+            std::rethrow_exception(m_handle.promise().m_exception);
+        }
+        return std::move(m_handle.promise().m_value);
+    }
+private:
+    explicit Task(std::coroutine_handle<promise_type> h)
+        :m_handle(h) {
+    }
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+template<>
+class Task<void>
+{
+public:
+    struct promise_type : public detail::PromiseBase {
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        void return_void() {}
+    };
+
+    Task(Task&& rhs) noexcept
+        :m_handle(std::exchange(rhs.m_handle, nullptr)) {
+    }
+
+    ~Task() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool await_ready() const noexcept { return !m_handle || m_handle.done();}
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        m_handle.promise().m_continuation = h;
+        m_handle.resume();
+        // 子协程已经结束就不挂起
+        return !m_handle.promise().m_done.exchange(true, std::memory_order_acq_rel);
+    }
+
+    void await_resume() {
+        if (m_handle.promise().m_exception) {
+            std::rethrow_exception(m_handle.promise().m_exception);
+        }
+    }
+private:
+    explicit Task(std::coroutine_handle<promise_type> h)
+        :m_handle(h) {
+    }
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// 在调度器上恢复协程 h，sc 为空时直接在当前线程恢复
+void CoResume(Scheduler* sc, std::coroutine_handle<> h);
+
+// 让出，放回当前调度器的队尾
+struct Yield {
+    bool await_ready() noexcept { return false;}
+    void await_suspend(std::coroutine_handle<> h) { CoResume(Scheduler::GetThis(), h);}
+    void await_resume() noexcept {}
+};
+
+// 切到调度器 sc 上继续执行
+struct SwitchTo {
+    explicit SwitchTo(Scheduler* sc) : m_scheduler(sc) {}
+    bool await_ready() noexcept { return m_scheduler == Scheduler::GetThis();}
+    void await_suspend(std::coroutine_handle<> h) { CoResume(m_scheduler, h);}
+    void await_resume() noexcept {}
+
+    Scheduler* m_scheduler;
+};
+
+// 睡眠 ms 毫秒，到期后回到挂起时的调度器
+struct Sleep {
+    explicit Sleep(uint64_t ms) : m_ms(ms) {}
+    bool await_ready() noexcept { return false;}
+    void await_suspend(std::coroutine_handle<> h);
+    void await_resume() noexcept {}
+
+    uint64_t m_ms;
+};
+
+// 等 fd 可读/可写，timeout_ms 为 0 时一直等
+// co_await 的结果：就绪返回 true，超时返回 false
+struct WaitReadable {
+    explicit WaitReadable(int fd, uint64_t timeout_ms = 0) : m_fd(fd), m_timeout(timeout_ms) {}
+    bool await_ready() noexcept { return false;}
+    bool await_suspend(std::coroutine_handle<> h);
+    bool await_resume() noexcept { return m_ready;}
+
+    int m_fd;
+    uint64_t m_timeout;
+    bool m_ready = false;
+};
+
+struct WaitWritable {
+    explicit WaitWritable(int fd, uint64_t timeout_ms = 0) : m_fd(fd), m_timeout(timeout_ms) {}
+    bool await_ready() noexcept { return false;}
+    bool await_suspend(std::coroutine_handle<> h);
+    bool await_resume() noexcept { return m_ready;}
+
+    int m_fd;
+    uint64_t m_timeout;
+    bool m_ready = false;
+};
+
+namespace detail
+{
+
+// CoSpawn 用的分离协程，结束时自己销毁
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() {
+            return DetachedTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {};}
+        std::suspend_never final_suspend() noexcept { return {};}
+        void return_void() {}
+        void unhandled_exception();
+    };
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+} // namespace detail
+
+// 在调度器 sc 上启动 task，不等它结束，task 抛出的异常写日志
+void CoSpawn(Scheduler* sc, Task<void> task);
+
+// 在调度器 sc 上执行 task，阻塞当前线程直到结束，返回结果或者重新抛出异常
+// 不能在 sc 的线程里调用
+template<class T>
+T SyncWait(Scheduler* sc, Task<T> task) {
+    Semaphore sem;
+    std::exception_ptr ex;
+    struct Result {
+        T value{};
+    } result;
+    CoSpawn(sc, [](Task<T> t, Result& r, std::exception_ptr& e, Semaphore& s) -> Task<void> {
+        try {
+            r.value = co_await t;
+        } catch (...) {
+            e = std::current_exception();
+        }
+        s.notify();
+    }(std::move(task), result, ex, sem));
+    sem.wait();
+    if (ex) {
+        std::rethrow_exception(ex);
+    }
+    return std::move(result.value);
+}
+
+void SyncWait(Scheduler* sc, Task<void> task);
+
+} // namespace sylar
+
+#endif // !__SYLAR_COROUTINE_H__
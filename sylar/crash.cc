@@ -0,0 +1,185 @@
+#include "crash.h"
+#include "log.h"
+#include "util.h"
+#include "fiber.h"
+#include <signal.h>
+#include <string.h>
+#include <execinfo.h>
+#include <sys/mman.h>
+#include <atomic>
+
+namespace sylar
+{
+
+static const int s_fatal_signals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+
+// 防止处理过程中再次崩溃时递归进来
+static volatile sig_atomic_t s_crashing = 0;
+
+static void WriteStr(const char* str) {
+    size_t len = strlen(str);
+    while (len > 0) {
+        ssize_t rt = write(STDERR_FILENO, str, len);
+        if (rt <= 0) {
+            return;
+        }
+        str += rt;
+        len -= rt;
+    }
+}
+
+// 无符号整数转十进制写到 stderr，不用 printf，异步信号安全
+static void WriteUint(uint64_t v) {
+    char buf[24];
+    int i = sizeof(buf);
+    buf[--i] = '\0';
+    do {
+        buf[--i] = '0' + v % 10;
+        v /= 10;
+    } while (v && i > 0);
+    WriteStr(buf + i);
+}
+
+// 信号名表，strsignal 不是异步信号安全的
+static const struct {
+    int sig;
+    const char* name;
+} s_signal_names[] = {
+    {SIGSEGV, "SIGSEGV (Segmentation fault)"},
+    {SIGABRT, "SIGABRT (Aborted)"},
+    {SIGBUS, "SIGBUS (Bus error)"},
+    {SIGFPE, "SIGFPE (Floating point exception)"},
+    {SIGILL, "SIGILL (Illegal instruction)"},
+};
+
+static const char* SignalName(int sig) {
+    for (auto& i : s_signal_names) {
+        if (i.sig == sig) {
+            return i.name;
+        }
+    }
+    return "unknown signal";
+}
+
+static std::atomic<bool> s_installed {false};
+
+// 尽力写日志和刷盘的时限（秒），崩在日志器或 appender 里持有锁时靠它脱身
+static const unsigned int s_log_timeout = 3;
+static volatile sig_atomic_t s_crash_sig = 0;
+
+// 尽力写日志超时：放弃剩下的部分，按原信号退出并生成 core
+// 可能正好投递到卡在锁上的崩溃线程，原信号在它的处理函数里是屏蔽的，要先解除
+static void CrashTimeoutHandler(int) {
+    WriteStr("*** crash handler timed out while logging, skip ***\n");
+    int sig = s_crash_sig;
+    signal(sig, SIG_DFL);
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, sig);
+    sigprocmask(SIG_UNBLOCK, &set, nullptr);
+    raise(sig);
+}
+
+// 备用信号栈大小，处理函数里要 backtrace 和写日志，给大一点
+static const size_t s_alt_stack_size = 64 * 1024;
+
+// 线程退出时释放备用信号栈
+struct AltStackHolder {
+    void* stack = nullptr;
+
+    ~AltStackHolder() {
+        if (stack) {
+            stack_t ss;
+            memset(&ss, 0, sizeof(ss));
+            ss.ss_flags = SS_DISABLE;
+            sigaltstack(&ss, nullptr);
+            munmap(stack, s_alt_stack_size);
+        }
+    }
+};
+
+static thread_local AltStackHolder t_alt_stack;
+
+static void CrashHandler(int sig, siginfo_t* info, void* ctx) {
+    if (s_crashing) {
+        signal(sig, SIG_DFL);
+        raise(sig);
+        return;
+    }
+    s_crashing = 1;
+    s_crash_sig = sig;
+
+    // 1. 只用异步信号安全的函数输出原始调用栈，保证至少这部分能输出来
+    WriteStr("*** sylar crash: ");
+    WriteStr(SignalName(sig));
+    WriteStr(" ***\n");
+    bool overflow = (sig == SIGSEGV || sig == SIGBUS) && info
+        && Fiber::IsStackOverflow(info->si_addr);
+    if (overflow) {
+        WriteStr("*** fiber stack overflow: fiber_id=");
+        WriteUint(Fiber::GetFiberId());
+        WriteStr(", raise fiber.stack_size ***\n");
+    }
+    void* array[64];
+    int size = backtrace(array, 64);
+    backtrace_symbols_fd(array, size, STDERR_FILENO);
+
+    // 2. 内存环形缓冲里最近的日志
+    WriteStr("*** recent logs ***\n");
+    MemoryRingLogAppender::DumpAll(STDERR_FILENO);
+
+    // 3. 尽力而为：demangle 后的调用栈写进日志，再把所有 appender 刷盘
+    // 这里要拿日志器和 appender 的锁、分配内存，崩在 Logger::log、appender 或 malloc 里时会卡住，
+    // 前面的输出已经保证了，定个闹钟，超时直接按原信号退出
+    signal(SIGALRM, CrashTimeoutHandler);
+    alarm(s_log_timeout);
+    SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << (overflow ? "fiber stack overflow, " : "")
+        << "crash signal=" << sig
+        << " (" << SignalName(sig) << ") addr=" << (info ? info->si_addr : nullptr)
+        << std::endl << BacktraceToString(64, 2, "    ");
+    LoggerMgr::GetInstance()->flush();
+    alarm(0);
+
+    // 恢复默认处理，重新触发，进程照常退出并生成 core
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void InstallCrashHandler() {
+    // backtrace 第一次调用会加载 libgcc，先在正常上下文里调一次
+    void* array[1];
+    backtrace(array, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = CrashHandler;
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    for (auto sig : s_fatal_signals) {
+        sigaction(sig, &sa, nullptr);
+    }
+    s_installed = true;
+    InstallAltSignalStack();
+}
+
+void InstallAltSignalStack() {
+    if (!s_installed || t_alt_stack.stack) {
+        return;
+    }
+    void* p = mmap(nullptr, s_alt_stack_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return;
+    }
+    stack_t ss;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_sp = p;
+    ss.ss_size = s_alt_stack_size;
+    if (sigaltstack(&ss, nullptr)) {
+        munmap(p, s_alt_stack_size);
+        return;
+    }
+    t_alt_stack.stack = p;
+}
+
+} // namespace sylar
@@ -0,0 +1,21 @@
+#ifndef __SYLAR_CRASH_H__
+#define __SYLAR_CRASH_H__
+
+namespace sylar
+{
+
+// 安装致命信号（SIGSEGV/SIGABRT/SIGBUS/SIGFPE/SIGILL）处理函数
+// 崩溃时：输出调用栈到 stderr，dump 内存环形缓冲，把调用栈写到 root 日志，
+// 刷新所有 appender，然后恢复默认处理并重新触发信号（照常生成 core）
+// 写日志和刷盘是尽力而为的，崩在日志器或 appender 里拿不到锁时几秒后超时放弃，照样退出
+// 栈溢出（包括协程栈碰到保护页）时额外输出 "fiber stack overflow"
+void InstallCrashHandler();
+
+// 给当前线程装备用信号栈，栈溢出时处理函数才有栈可用
+// InstallCrashHandler 会给调用线程装，sylar::Thread 创建的线程启动时自动装，
+// 没有安装崩溃处理时什么都不做
+void InstallAltSignalStack();
+
+} // namespace sylar
+
+#endif // !__SYLAR_CRASH_H__
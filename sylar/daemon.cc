@@ -0,0 +1,750 @@
+#include "daemon.h"
+#include "config.h"
+#include "log.h"
+#include "mutex.h"
+#include "thread.h"
+#include "util.h"
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fstream>
+#include <sstream>
+#include <map>
+
+namespace sylar
+{
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<uint32_t>::ptr g_daemon_restart_interval =
+    Config::Lookup<uint32_t>("daemon.restart_interval", 5, "daemon restart interval, seconds");
+
+static ConfigVar<std::string>::ptr g_daemon_pid_file =
+    Config::Lookup<std::string>("daemon.pid_file", "", "daemon pid file, empty for none");
+
+static ConfigVar<uint32_t>::ptr g_daemon_exit_timeout =
+    Config::Lookup<uint32_t>("daemon.exit_timeout", 30,
+        "seconds an old process after reload or a stopping process gets before SIGTERM/SIGKILL");
+
+static ConfigVar<std::string>::ptr g_daemon_handoff_dir =
+    Config::Lookup<std::string>("daemon.handoff_dir", "/tmp",
+        "parent dir of the private (0700) dir holding unix sockets for listen fd handoff");
+
+std::string ProcessInfo::toString() const {
+    std::stringstream ss;
+    ss << "[ProcessInfo parent_id=" << parent_id
+       << " main_id=" << main_id
+       << " parent_start_time=" << parent_start_time
+       << " main_start_time=" << main_start_time
+       << " restart_count=" << restart_count
+       << " reload_count=" << reload_count << "]";
+    return ss.str();
+}
+
+// 监听 fd 登记表，交接时整张表发给新进程
+static Mutex s_listen_mutex;
+static std::map<std::string, int> s_listen_fds;     // 自己在用的
+static std::map<std::string, int> s_inherited_fds;  // 上一个进程交过来、还没人取的
+static std::function<void()> s_handoff_cb;
+
+// 平滑重启时 fork 出的新进程从这个进程接手监听 fd
+static pid_t s_handoff_from = 0;
+static Thread::ptr s_control_thread;
+
+static const size_t s_max_handoff_fds = 250;
+
+// 交接套接字放在只有本用户能进的目录里：<handoff_dir>/sylar_handoff_<uid>/<pid>.sock
+static std::string HandoffDir() {
+    return g_daemon_handoff_dir->getValue() + "/sylar_handoff_" + std::to_string(getuid());
+}
+
+static std::string HandoffPath(pid_t pid) {
+    return HandoffDir() + "/" + std::to_string(pid) + ".sock";
+}
+
+// 目录不存在时创建成 0700；已存在时必须是自己的、不是符号链接、组和其他人没有权限
+static bool CheckHandoffDir(bool create) {
+    std::string dir = HandoffDir();
+    if (create && mkdir(dir.c_str(), 0700) && errno != EEXIST) {
+        SYLAR_LOG_ERROR(g_logger) << "mkdir " << dir << " errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (lstat(dir.c_str(), &st)) {
+        SYLAR_LOG_ERROR(g_logger) << "lstat " << dir << " errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077)) {
+        SYLAR_LOG_ERROR(g_logger) << "handoff dir " << dir << " unsafe: uid=" << st.st_uid
+            << " mode=" << std::oct << (st.st_mode & 07777) << std::dec;
+        return false;
+    }
+    return true;
+}
+
+// 从 /proc/<pid>/stat 取父进程 pid，失败返回 -1
+// 格式 "pid (comm) state ppid ..."，comm 里可能有空格和括号，从最后一个 ')' 往后解析
+static pid_t GetParentPid(pid_t pid) {
+    std::ifstream ifs("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat;
+    if (!std::getline(ifs, stat)) {
+        return -1;
+    }
+    size_t pos = stat.rfind(')');
+    if (pos == std::string::npos) {
+        return -1;
+    }
+    std::stringstream ss(stat.substr(pos + 1));
+    std::string state;
+    pid_t ppid = -1;
+    if (!(ss >> state >> ppid)) {
+        return -1;
+    }
+    return ppid;
+}
+
+// 对端必须是同一个用户，pid 为 peer_pid（大于 0 时）或者和自己是同一个看门狗拉起的
+static bool CheckPeer(int sock, pid_t peer_pid) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len)) {
+        SYLAR_LOG_ERROR(g_logger) << "SO_PEERCRED errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    bool ok = cred.uid == getuid();
+    if (ok && peer_pid > 0) {
+        ok = cred.pid == peer_pid;
+    } else if (ok) {
+        ok = GetParentPid(cred.pid) == getppid();
+    }
+    if (!ok) {
+        SYLAR_LOG_ERROR(g_logger) << "handoff peer rejected pid=" << cred.pid << " uid=" << cred.uid;
+    }
+    return ok;
+}
+
+static bool MakeUnixAddr(const std::string& path, struct sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        SYLAR_LOG_ERROR(g_logger) << "unix socket path too long: " << path;
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+bool SendFds(int sock, const std::vector<std::pair<std::string, int> >& fds) {
+    if (fds.size() > s_max_handoff_fds) {
+        SYLAR_LOG_ERROR(g_logger) << "SendFds too many fds: " << fds.size();
+        return false;
+    }
+    // 正文：个数一行，然后每个名字一行，顺序和附带的 fd 一致
+    std::string body = std::to_string(fds.size()) + "\n";
+    for (auto& i : fds) {
+        body += i.first + "\n";
+    }
+    std::vector<char> ctrl(CMSG_SPACE(sizeof(int) * (fds.empty() ? 1 : fds.size())), 0);
+
+    struct iovec iov;
+    iov.iov_base = (void*)body.c_str();
+    iov.iov_len = body.size();
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (!fds.empty()) {
+        msg.msg_control = &ctrl[0];
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        int* p = (int*)CMSG_DATA(cmsg);
+        for (size_t i = 0; i < fds.size(); ++i) {
+            p[i] = fds[i].second;
+        }
+    }
+    ssize_t rt = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    if (rt != (ssize_t)body.size()) {
+        SYLAR_LOG_ERROR(g_logger) << "SendFds sendmsg rt=" << rt << " errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool RecvFds(int sock, std::vector<std::pair<std::string, int> >& fds) {
+    fds.clear();
+    std::vector<char> buf(64 * 1024);
+    std::vector<char> ctrl(CMSG_SPACE(sizeof(int) * s_max_handoff_fds), 0);
+    struct iovec iov;
+    iov.iov_base = &buf[0];
+    iov.iov_len = buf.size();
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = &ctrl[0];
+    msg.msg_controllen = ctrl.size();
+
+    ssize_t rt = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (rt <= 0) {
+        SYLAR_LOG_ERROR(g_logger) << "RecvFds recvmsg rt=" << rt << " errno=" << errno
+            << " errstr=" << strerror(errno);
+        return false;
+    }
+    std::vector<int> recv_fds;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            int* p = (int*)CMSG_DATA(cmsg);
+            recv_fds.insert(recv_fds.end(), p, p + n);
+        }
+    }
+
+    std::stringstream ss(std::string(&buf[0], rt));
+    std::string line;
+    size_t count = 0;
+    bool ok = false;
+    if (std::getline(ss, line)) {
+        count = strtoul(line.c_str(), nullptr, 10);
+        ok = true;
+    }
+    if (!ok || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || count != recv_fds.size()) {
+        SYLAR_LOG_ERROR(g_logger) << "RecvFds bad message count=" << count
+            << " fds=" << recv_fds.size() << " flags=" << msg.msg_flags;
+        for (auto& i : recv_fds) {
+            close(i);
+        }
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        std::getline(ss, line);
+        fds.push_back(std::make_pair(line, recv_fds[i]));
+    }
+    return true;
+}
+
+int GetListenFd(const std::string& name, const std::string& ip, uint16_t port, int backlog) {
+    int fd = TakeInheritedFd(name);
+    if (fd >= 0) {
+        SYLAR_LOG_INFO(g_logger) << "listen fd name=" << name << " fd=" << fd << " inherited";
+        AddListenFd(name, fd);
+        return fd;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1) {
+        SYLAR_LOG_ERROR(g_logger) << "GetListenFd invalid ip=" << ip << " name=" << name;
+        return -1;
+    }
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "GetListenFd socket errno=" << errno
+            << " errstr=" << strerror(errno);
+        return -1;
+    }
+    // SO_REUSEPORT：交接失败时新进程也能和旧进程同时绑定同一个端口
+    int val = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val));
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || listen(fd, backlog)) {
+        SYLAR_LOG_ERROR(g_logger) << "GetListenFd bind/listen " << ip << ":" << port
+            << " errno=" << errno << " errstr=" << strerror(errno);
+        close(fd);
+        return -1;
+    }
+    SYLAR_LOG_INFO(g_logger) << "listen fd name=" << name << " fd=" << fd
+        << " " << ip << ":" << port;
+    AddListenFd(name, fd);
+    return fd;
+}
+
+void AddListenFd(const std::string& name, int fd) {
+    Mutex::Lock lock(s_listen_mutex);
+    s_listen_fds[name] = fd;
+}
+
+int TakeInheritedFd(const std::string& name) {
+    Mutex::Lock lock(s_listen_mutex);
+    auto it = s_inherited_fds.find(name);
+    if (it == s_inherited_fds.end()) {
+        return -1;
+    }
+    int fd = it->second;
+    s_inherited_fds.erase(it);
+    return fd;
+}
+
+void SetHandoffCallback(std::function<void()> cb) {
+    Mutex::Lock lock(s_listen_mutex);
+    s_handoff_cb = cb;
+}
+
+// 把监听 fd 交给连进来的新进程，成功返回 true
+static bool ServeHandoff(int listen_sock) {
+    int conn = accept4(listen_sock, nullptr, nullptr, SOCK_CLOEXEC);
+    if (conn < 0) {
+        return false;
+    }
+    // 只交给同一个看门狗拉起的新进程
+    if (!CheckPeer(conn, 0)) {
+        close(conn);
+        return false;
+    }
+    std::vector<std::pair<std::string, int> > fds;
+    {
+        Mutex::Lock lock(s_listen_mutex);
+        fds.assign(s_listen_fds.begin(), s_listen_fds.end());
+    }
+    bool ok = SendFds(conn, fds);
+    close(conn);
+    if (!ok) {
+        return false;
+    }
+    SYLAR_LOG_INFO(g_logger) << "handoff " << fds.size() << " listen fds to new process";
+    std::function<void()> cb;
+    {
+        Mutex::Lock lock(s_listen_mutex);
+        cb = s_handoff_cb;
+    }
+    if (cb) {
+        cb();
+    } else {
+        kill(getpid(), SIGTERM);
+    }
+    return true;
+}
+
+// 子进程的控制线程：等新进程来拿监听 fd，收到 SIGUSR1 时重新打开日志文件
+static void ControlLoop(int listen_sock, int sigfd, std::string path) {
+    struct pollfd pfds[2];
+    pfds[0].fd = listen_sock;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = sigfd;
+    pfds[1].events = POLLIN;
+    while (true) {
+        pfds[0].revents = pfds[1].revents = 0;
+        int rt = poll(pfds, 2, -1);
+        if (rt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            SYLAR_LOG_ERROR(g_logger) << "control poll errno=" << errno
+                << " errstr=" << strerror(errno);
+            break;
+        }
+        if (pfds[1].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            while (read(sigfd, &info, sizeof(info)) == sizeof(info));
+            SYLAR_LOG_INFO(g_logger) << "SIGUSR1, reopen log files";
+            LoggerMgr::GetInstance()->reopen();
+        }
+        if ((pfds[0].revents & POLLIN) && ServeHandoff(listen_sock)) {
+            // 只交接一次
+            break;
+        }
+    }
+    unlink(path.c_str());
+    close(listen_sock);
+}
+
+static void UnlinkHandoffPath() {
+    unlink(HandoffPath(getpid()).c_str());
+}
+
+static bool StartControlThread() {
+#ifdef SYLAR_SINGLE_THREAD
+    // 单线程构建的日志锁是空操作，控制线程重开日志、写日志会和业务线程竞争，不起控制线程
+    // 看门狗还会转发 SIGUSR1，忽略掉免得默认动作把进程杀了
+    signal(SIGUSR1, SIG_IGN);
+    SYLAR_LOG_WARN(g_logger) << "SYLAR_SINGLE_THREAD build: no control thread, "
+        "listen fd handoff and SIGUSR1 log reopen are disabled";
+    return false;
+#endif
+    // 在创建其它线程之前屏蔽，之后的线程都继承，SIGUSR1 只从 signalfd 收
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    int sigfd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    std::string path = HandoffPath(getpid());
+    struct sockaddr_un addr;
+    if (sigfd < 0 || !CheckHandoffDir(true) || !MakeUnixAddr(path, addr)) {
+        SYLAR_LOG_ERROR(g_logger) << "StartControlThread fail path=" << path
+            << " errno=" << errno;
+        return false;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(path.c_str());
+    if (sock < 0 || bind(sock, (struct sockaddr*)&addr, sizeof(addr)) || listen(sock, 4)) {
+        SYLAR_LOG_ERROR(g_logger) << "handoff socket " << path << " errno=" << errno
+            << " errstr=" << strerror(errno);
+        if (sock >= 0) {
+            close(sock);
+        }
+        close(sigfd);
+        return false;
+    }
+    atexit(UnlinkHandoffPath);
+    s_control_thread.reset(new Thread(std::bind(&ControlLoop, sock, sigfd, path), "daemon_ctl"));
+    return true;
+}
+
+// 新进程从旧进程拿监听 fd，旧进程的控制线程可能还没起来，重试几次
+static void ReceiveHandoff(pid_t from) {
+#ifdef SYLAR_SINGLE_THREAD
+    // 旧进程没有控制线程，没人交接
+    return;
+#endif
+    std::string path = HandoffPath(from);
+    struct sockaddr_un addr;
+    if (!CheckHandoffDir(false) || !MakeUnixAddr(path, addr)) {
+        return;
+    }
+    for (int i = 0; i < 30; ++i) {
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            break;
+        }
+        if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            if (!CheckPeer(sock, from)) {
+                close(sock);
+                return;
+            }
+            std::vector<std::pair<std::string, int> > fds;
+            bool ok = RecvFds(sock, fds);
+            close(sock);
+            if (ok) {
+                Mutex::Lock lock(s_listen_mutex);
+                for (auto& j : fds) {
+                    s_inherited_fds[j.first] = j.second;
+                }
+                SYLAR_LOG_INFO(g_logger) << "received " << fds.size()
+                    << " listen fds from pid=" << from;
+            }
+            return;
+        }
+        close(sock);
+        usleep(100 * 1000);
+    }
+    SYLAR_LOG_ERROR(g_logger) << "handoff from pid=" << from << " fail, path=" << path
+        << " errno=" << errno << " errstr=" << strerror(errno);
+}
+
+// 看门狗只需要 daemon.*，不加载其它配置，免得在 fork 之前创建日志线程之类的东西
+static void LoadDaemonConfig(const std::string& conf_dir, int argc, char** argv) {
+    if (!conf_dir.empty()) {
+        std::vector<std::string> files;
+        FSUtil::ListAllFile(files, conf_dir, ".yml");
+        for (auto& i : files) {
+            try {
+                YAML::Node root = YAML::LoadFile(i);
+                if (root["daemon"]) {
+                    YAML::Node node;
+                    node["daemon"] = root["daemon"];
+                    Config::LoadFromYaml(node);
+                }
+            } catch (...) {
+                SYLAR_LOG_ERROR(g_logger) << "LoadDaemonConfig file=" << i << " failed";
+            }
+        }
+    }
+    Config::LoadFromEnv();
+    Config::LoadFromArgs(argc, argv);
+}
+
+// pid 文件里的进程还活着返回 false
+static bool CheckPidFile(const std::string& file) {
+    if (file.empty()) {
+        return true;
+    }
+    std::ifstream ifs(file);
+    pid_t pid = 0;
+    if (ifs >> pid && pid > 0 && (kill(pid, 0) == 0 || errno == EPERM)) {
+        SYLAR_LOG_ERROR(g_logger) << "pid file " << file << " exists, pid=" << pid << " is running";
+        return false;
+    }
+    return true;
+}
+
+static bool WritePidFile(const std::string& file) {
+    if (file.empty()) {
+        return true;
+    }
+    std::ofstream ofs(file, std::ios::trunc);
+    if (!(ofs << getpid() << std::endl)) {
+        SYLAR_LOG_ERROR(g_logger) << "write pid file " << file << " fail";
+        return false;
+    }
+    return true;
+}
+
+static void RemovePidFile(const std::string& file) {
+    if (file.empty()) {
+        return;
+    }
+    // 只删自己写的
+    std::ifstream ifs(file);
+    pid_t pid = 0;
+    if (ifs >> pid && pid == getpid()) {
+        unlink(file.c_str());
+    }
+}
+
+static int real_start(int argc, char** argv, std::function<int(int argc, char** argv)> main_cb,
+                      const std::string& conf_dir, bool watched) {
+    ProcessInfo* pi = ProcessInfoMgr::GetInstance();
+    pi->main_id = getpid();
+    pi->main_start_time = time(0);
+    // 新进程先加载好配置再接手监听 fd，接手之前旧进程一直在 accept
+    if (!conf_dir.empty()) {
+        Config::LoadAll(conf_dir, argc, argv);
+    }
+    // 从父进程继承来的日志文件和父进程共用，重新打开
+    LoggerMgr::GetInstance()->reopen();
+    if (s_handoff_from) {
+        ReceiveHandoff(s_handoff_from);
+    }
+    if (watched) {
+        StartControlThread();
+    }
+    return main_cb(argc, argv);
+}
+
+// 返回 0 表示在子进程里
+static pid_t ForkChild(pid_t handoff_from, const sigset_t& old_mask) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        s_handoff_from = handoff_from;
+        sigprocmask(SIG_SETMASK, &old_mask, nullptr);
+    } else if (pid < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "fork fail errno=" << errno << " errstr=" << strerror(errno);
+    } else {
+        SYLAR_LOG_INFO(g_logger) << "process start pid=" << pid
+            << (handoff_from ? " handoff_from=" + std::to_string(handoff_from) : "");
+    }
+    return pid;
+}
+
+static int real_daemon(int argc, char** argv, std::function<int(int argc, char** argv)> main_cb,
+                       const std::string& conf_dir) {
+    std::string pid_file = g_daemon_pid_file->getValue();
+    // 保留工作目录，标准输入输出重定向到 /dev/null
+    if (daemon(1, 0)) {
+        SYLAR_LOG_ERROR(g_logger) << "daemon fail errno=" << errno << " errstr=" << strerror(errno);
+        return -1;
+    }
+    ProcessInfo* pi = ProcessInfoMgr::GetInstance();
+    pi->parent_id = getpid();
+    pi->parent_start_time = time(0);
+    if (!WritePidFile(pid_file)) {
+        return -1;
+    }
+
+    // 信号都屏蔽掉，用 sigtimedwait 同步处理，不会漏掉两次检查之间来的信号
+    sigset_t set;
+    sigset_t old_mask;
+    sigemptyset(&set);
+    sigaddset(&set, SIGHUP);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &set, &old_mask);
+
+    // 所有还活着的子进程：平滑重启后旧进程还在处理剩下的连接，停止时要一起等
+    // 到了 deadline 还没退出就发 sig，SIGTERM 之后再等一轮发 SIGKILL
+    struct ChildState {
+        uint64_t deadline = 0;
+        int sig = 0;    // 0 表示没有期限
+    };
+    std::map<pid_t, ChildState> children;
+    // 给子进程发 sig，exit_timeout 之后还没退出就 SIGKILL
+    auto kill_child = [&children](pid_t pid, int sig) {
+        kill(pid, sig);
+        ChildState& cs = children[pid];
+        cs.deadline = GetCurrentMS() + g_daemon_exit_timeout->getValue() * 1000;
+        cs.sig = SIGKILL;
+    };
+
+    pid_t current = ForkChild(0, old_mask);
+    if (current == 0) {
+        return real_start(argc, argv, main_cb, conf_dir, true);
+    }
+    uint64_t restart_at = current < 0 ? GetCurrentMS() : 0;
+    if (current < 0) {
+        current = 0;
+    } else {
+        children[current] = ChildState();
+    }
+    bool stopping = false;
+    bool finished = false;
+    while (true) {
+        int status = 0;
+        pid_t pid = 0;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            // 被信号杀掉的子进程来不及删自己的交接套接字
+            unlink(HandoffPath(pid).c_str());
+            children.erase(pid);
+            if (pid != current) {
+                SYLAR_LOG_INFO(g_logger) << "old process pid=" << pid << " exit status=" << status;
+                continue;
+            }
+            current = 0;
+            if (stopping) {
+                continue;
+            }
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                SYLAR_LOG_INFO(g_logger) << "process pid=" << pid << " finished";
+                finished = true;
+                continue;
+            }
+            SYLAR_LOG_ERROR(g_logger) << "process crash pid=" << pid << " status=" << status
+                << ", restart in " << g_daemon_restart_interval->getValue() << "s";
+            restart_at = GetCurrentMS() + g_daemon_restart_interval->getValue() * 1000;
+        }
+        if (children.empty() && (stopping || finished)) {
+            break;
+        }
+
+        // 超时没退出的子进程
+        uint64_t now = GetCurrentMS();
+        uint64_t wake_at = 0;
+        for (auto& i : children) {
+            if (!i.second.sig) {
+                continue;
+            }
+            if (now >= i.second.deadline) {
+                SYLAR_LOG_WARN(g_logger) << "process pid=" << i.first << " not exit in "
+                    << g_daemon_exit_timeout->getValue() << "s, send signal " << i.second.sig;
+                if (i.second.sig == SIGTERM) {
+                    kill_child(i.first, SIGTERM);
+                } else {
+                    kill(i.first, SIGKILL);
+                    i.second.sig = 0;
+                    continue;
+                }
+            }
+            if (!wake_at || i.second.deadline < wake_at) {
+                wake_at = i.second.deadline;
+            }
+        }
+
+        if (!current && !stopping && !finished && restart_at) {
+            if (now >= restart_at) {
+                pid = ForkChild(0, old_mask);
+                if (pid == 0) {
+                    return real_start(argc, argv, main_cb, conf_dir, true);
+                }
+                if (pid > 0) {
+                    current = pid;
+                    children[pid] = ChildState();
+                    restart_at = 0;
+                    ++pi->restart_count;
+                } else {
+                    restart_at = GetCurrentMS() + g_daemon_restart_interval->getValue() * 1000;
+                }
+                continue;
+            }
+            if (!wake_at || restart_at < wake_at) {
+                wake_at = restart_at;
+            }
+        }
+
+        siginfo_t info;
+        int sig = 0;
+        if (wake_at) {
+            // 上面检查之后时间可能已经过了 wake_at，不能减成负数
+            now = GetCurrentMS();
+            uint64_t wait = now >= wake_at ? 0 : wake_at - now;
+            struct timespec ts;
+            ts.tv_sec = wait / 1000;
+            ts.tv_nsec = wait % 1000 * 1000000;
+            sig = sigtimedwait(&set, &info, &ts);
+        } else {
+            sig = sigwaitinfo(&set, &info);
+        }
+        switch (sig) {
+            case SIGHUP:
+                if (current && !stopping) {
+                    pid = ForkChild(current, old_mask);
+                    if (pid == 0) {
+                        return real_start(argc, argv, main_cb, conf_dir, true);
+                    }
+                    if (pid > 0) {
+                        // 旧进程交接完自己退出，超时还在就 SIGTERM
+                        ChildState& cs = children[current];
+                        cs.deadline = GetCurrentMS() + g_daemon_exit_timeout->getValue() * 1000;
+                        cs.sig = SIGTERM;
+                        current = pid;
+                        children[pid] = ChildState();
+                        ++pi->reload_count;
+                    }
+                }
+                break;
+            case SIGUSR1:
+                // 新旧进程写的是同一批日志文件，都要重新打开
+                for (auto& i : children) {
+                    kill(i.first, SIGUSR1);
+                }
+                break;
+            case SIGTERM:
+            case SIGINT:
+                SYLAR_LOG_INFO(g_logger) << "daemon stop, signal=" << sig;
+                if (!stopping) {
+                    stopping = true;
+                    for (auto& i : children) {
+                        kill_child(i.first, SIGTERM);
+                    }
+                }
+                break;
+            default:
+                // SIGCHLD、超时，回到上面收尸、处理超时或重启
+                break;
+        }
+    }
+    RemovePidFile(pid_file);
+    return 0;
+}
+
+int start_daemon(int argc, char** argv, std::function<int(int argc, char** argv)> main_cb,
+                 bool is_daemon, const std::string& conf_dir) {
+    LoadDaemonConfig(conf_dir, argc, argv);
+    std::string pid_file = g_daemon_pid_file->getValue();
+    if (!CheckPidFile(pid_file)) {
+        return -1;
+    }
+    if (is_daemon) {
+        return real_daemon(argc, argv, main_cb, conf_dir);
+    }
+    ProcessInfo* pi = ProcessInfoMgr::GetInstance();
+    pi->parent_id = getpid();
+    pi->parent_start_time = time(0);
+    if (!WritePidFile(pid_file)) {
+        return -1;
+    }
+    int rt = real_start(argc, argv, main_cb, conf_dir, false);
+    RemovePidFile(pid_file);
+    return rt;
+}
+
+} // namespace sylar
@@ -0,0 +1,66 @@
+#ifndef __SYLAR_DAEMON_H__
+#define __SYLAR_DAEMON_H__
+
+#include <unistd.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include <utility>
+#include "singleton.h"
+
+namespace sylar
+{
+
+// 进程信息，守护模式下有两个进程：父进程看门狗，子进程干活
+struct ProcessInfo {
+    pid_t parent_id = 0;            // 父进程（看门狗）id
+    pid_t main_id = 0;              // 子进程（干活的）id
+    uint64_t parent_start_time = 0; // 父进程启动时间，秒
+    uint64_t main_start_time = 0;   // 子进程启动时间，秒
+    uint32_t restart_count = 0;     // 子进程崩溃后被重启的次数
+    uint32_t reload_count = 0;      // 平滑重启的次数
+
+    std::string toString() const;
+};
+
+typedef sylar::Singleton<ProcessInfo> ProcessInfoMgr;
+
+// 启动程序，main_cb 是真正的 main，返回值作为进程退出码
+// is_daemon 为 false 时在当前进程里直接运行；
+// 为 true 时转到后台，父进程只做看门狗：fork 子进程运行 main_cb，子进程异常退出时
+// 隔 daemon.restart_interval 秒重新拉起，正常退出（返回 0）时父进程也退出
+// 看门狗收到的信号：
+//   SIGHUP  平滑重启：拉起新的子进程，新进程加载完配置后从旧进程拿走监听套接字，旧进程退出
+//           旧进程 daemon.exit_timeout 秒后还没退出就 SIGTERM，再过一轮 SIGKILL
+//   SIGUSR1 转给所有子进程，子进程重新打开日志文件（logrotate 用）
+//   SIGTERM/SIGINT 转给所有子进程（包括还没退出的旧进程），等它们都退出后删除 pid 文件退出，
+//           daemon.exit_timeout 秒后还没退出的 SIGKILL
+// conf_dir 不为空时，子进程启动时 Config::LoadAll(conf_dir, argc, argv)，看门狗只加载其中的 daemon.*
+// daemon.pid_file 不为空时写 pid 文件（守护模式下是看门狗的 pid），文件里的进程还活着时启动失败
+// 注意：fork 只会带走调用线程，start_daemon 之前不要创建线程
+int start_daemon(int argc, char** argv, std::function<int(int argc, char** argv)> main_cb,
+                 bool is_daemon, const std::string& conf_dir = "");
+
+// 平滑重启时交给新进程的监听套接字
+// 按名字取：上一个进程交过来的就直接用，没有就新建（SO_REUSEADDR、SO_REUSEPORT）并 listen
+// 返回的 fd 会登记下来，下次重启时交给新进程；失败返回 -1
+int GetListenFd(const std::string& name, const std::string& ip, uint16_t port, int backlog = 1024);
+
+// 登记自己创建的监听 fd，重启时交给新进程
+void AddListenFd(const std::string& name, int fd);
+
+// 取走上一个进程交过来的 fd，没有返回 -1
+int TakeInheritedFd(const std::string& name);
+
+// 监听套接字交给新进程之后调用，应当停止 accept、处理完已有的请求后退出
+// 不设置时默认给自己发 SIGTERM
+void SetHandoffCallback(std::function<void()> cb);
+
+// 通过 Unix 套接字发送/接收 fd（SCM_RIGHTS），名字一起带过去，一次最多 250 个
+bool SendFds(int sock, const std::vector<std::pair<std::string, int> >& fds);
+bool RecvFds(int sock, std::vector<std::pair<std::string, int> >& fds);
+
+} // namespace sylar
+
+#endif // !__SYLAR_DAEMON_H__
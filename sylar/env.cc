@@ -0,0 +1,166 @@
+#include "env.h"
+#include "log.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+namespace sylar
+{
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+bool Env::init(int argc, char** argv) {
+    char path[PATH_MAX] = {0};
+    ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (n > 0) {
+        m_exe.assign(path, n);
+    } else {
+        SYLAR_LOG_ERROR(g_logger) << "readlink /proc/self/exe errno=" << errno
+            << " errstr=" << strerror(errno);
+        m_exe = argc > 0 ? argv[0] : "";
+    }
+    m_exeDir = m_exe.substr(0, m_exe.find_last_of('/') + 1);
+    if (getcwd(path, sizeof(path))) {
+        m_cwd = path;
+        if (m_cwd.empty() || m_cwd.back() != '/') {
+            m_cwd += "/";
+        }
+    }
+    m_program = argc > 0 ? argv[0] : m_exe;
+
+    // -key value / -key=value / -key
+    const char* now_key = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (arg[0] == '-' && arg[1] == '-') {
+            // --a.b=v 是配置项覆盖
+            if (now_key) {
+                add(now_key, "");
+                now_key = nullptr;
+            }
+            continue;
+        }
+        if (arg[0] == '-' && arg[1]) {
+            if (now_key) {
+                add(now_key, "");
+            }
+            const char* eq = strchr(arg + 1, '=');
+            if (eq) {
+                add(std::string(arg + 1, eq - arg - 1), eq + 1);
+                now_key = nullptr;
+            } else {
+                now_key = arg + 1;
+            }
+        } else if (now_key) {
+            add(now_key, arg);
+            now_key = nullptr;
+        } else {
+            SYLAR_LOG_ERROR(g_logger) << "invalid arg idx=" << i << " val=" << arg;
+            return false;
+        }
+    }
+    if (now_key) {
+        add(now_key, "");
+    }
+    return true;
+}
+
+void Env::add(const std::string& key, const std::string& val) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_args[key] = val;
+}
+
+bool Env::has(const std::string& key) {
+    RWMutexType::ReadLock lock(m_mutex);
+    return m_args.find(key) != m_args.end();
+}
+
+void Env::del(const std::string& key) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_args.erase(key);
+}
+
+std::string Env::get(const std::string& key, const std::string& default_value) {
+    RWMutexType::ReadLock lock(m_mutex);
+    auto it = m_args.find(key);
+    return it != m_args.end() ? it->second : default_value;
+}
+
+void Env::addHelp(const std::string& key, const std::string& desc) {
+    removeHelp(key);
+    RWMutexType::WriteLock lock(m_mutex);
+    m_helps.push_back(std::make_pair(key, desc));
+}
+
+void Env::removeHelp(const std::string& key) {
+    RWMutexType::WriteLock lock(m_mutex);
+    for (auto it = m_helps.begin(); it != m_helps.end();) {
+        if (it->first == key) {
+            it = m_helps.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::string Env::getHelp() {
+    RWMutexType::ReadLock lock(m_mutex);
+    size_t width = 0;
+    for (auto& i : m_helps) {
+        width = std::max(width, i.first.size());
+    }
+    std::stringstream ss;
+    ss << "Usage: " << m_program << " [options]" << std::endl;
+    for (auto& i : m_helps) {
+        ss << "    -" << std::left << std::setw(width) << i.first
+           << " : " << i.second << std::endl;
+    }
+    ss << "    --<config.name>=<value> : override config item" << std::endl;
+    return ss.str();
+}
+
+void Env::printHelp() {
+    std::cout << getHelp();
+}
+
+bool Env::setEnv(const std::string& key, const std::string& val) {
+    return !setenv(key.c_str(), val.c_str(), 1);
+}
+
+std::string Env::getEnv(const std::string& key, const std::string& default_value) {
+    const char* v = getenv(key.c_str());
+    return v ? v : default_value;
+}
+
+std::string Env::getAbsolutePath(const std::string& path) const {
+    if (path.empty()) {
+        return "/";
+    }
+    if (path[0] == '/') {
+        return path;
+    }
+    return m_exeDir + path;
+}
+
+std::string Env::getAbsoluteWorkPath(const std::string& path) const {
+    if (path.empty()) {
+        return "/";
+    }
+    if (path[0] == '/') {
+        return path;
+    }
+    return m_cwd + path;
+}
+
+std::string Env::getConfigPath() {
+    // 只写了 -c 没有值时也用默认的
+    std::string dir = get("c");
+    return getAbsolutePath(dir.empty() ? "conf" : dir);
+}
+
+} // namespace sylar
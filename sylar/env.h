@@ -0,0 +1,95 @@
+#ifndef __SYLAR_ENV_H__
+#define __SYLAR_ENV_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/lexical_cast.hpp>
+#include "singleton.h"
+#include "mutex.h"
+
+namespace sylar
+{
+
+// 进程环境：命令行参数、环境变量、可执行文件路径、工作目录
+// 命令行格式：-key value 或 -key=value，后面不跟值的 -key 是开关（值为空串）
+// --a.b=v 留给 Config::LoadFromArgs 覆盖配置项，这里跳过
+class Env
+{
+public:
+    typedef RWMutex RWMutexType;
+
+    // 解析命令行，出现不认识的位置参数时返回 false
+    bool init(int argc, char** argv);
+
+    void add(const std::string& key, const std::string& val);
+    bool has(const std::string& key);
+    void del(const std::string& key);
+    std::string get(const std::string& key, const std::string& default_value = "");
+
+    // 按类型取参数，没有或者转换失败返回默认值
+    template<class T>
+    T getAs(const std::string& key, const T& default_value = T()) {
+        RWMutexType::ReadLock lock(m_mutex);
+        auto it = m_args.find(key);
+        if (it == m_args.end()) {
+            return default_value;
+        }
+        try {
+            return boost::lexical_cast<T>(it->second);
+        } catch (...) {
+            return default_value;
+        }
+    }
+
+    // 注册选项的说明，printHelp 按注册顺序输出
+    void addHelp(const std::string& key, const std::string& desc);
+    void removeHelp(const std::string& key);
+    std::string getHelp();
+    void printHelp();
+
+    const std::string& getProgram() const { return m_program;}
+    // 可执行文件的绝对路径（/proc/self/exe）
+    const std::string& getExe() const { return m_exe;}
+    // 可执行文件所在目录，以 '/' 结尾
+    const std::string& getExeDir() const { return m_exeDir;}
+    // 启动时的工作目录，以 '/' 结尾
+    const std::string& getCwd() const { return m_cwd;}
+
+    bool setEnv(const std::string& key, const std::string& val);
+    std::string getEnv(const std::string& key, const std::string& default_value = "");
+
+    // 相对路径按可执行文件所在目录展开，和从哪个目录启动无关
+    std::string getAbsolutePath(const std::string& path) const;
+    // 相对路径按启动时的工作目录展开
+    std::string getAbsoluteWorkPath(const std::string& path) const;
+    // 配置目录：-c 指定，默认可执行文件旁边的 conf
+    std::string getConfigPath();
+private:
+    RWMutexType m_mutex;
+    std::map<std::string, std::string> m_args;
+    std::vector<std::pair<std::string, std::string> > m_helps;
+
+    std::string m_program;
+    std::string m_exe;
+    std::string m_exeDir;
+    std::string m_cwd;
+};
+
+// 开关：出现了且值不是 0/false 就是 true，-d、-d 1、-d=true 都算
+template<>
+inline bool Env::getAs<bool>(const std::string& key, const bool& default_value) {
+    RWMutexType::ReadLock lock(m_mutex);
+    auto it = m_args.find(key);
+    if (it == m_args.end()) {
+        return default_value;
+    }
+    return it->second != "0" && it->second != "false";
+}
+
+typedef sylar::Singleton<Env> EnvMgr;
+
+} // namespace sylar
+
+#endif // !__SYLAR_ENV_H__
@@ -0,0 +1,240 @@
+#include "fiber.h"
+#include "scheduler.h"
+#include "macro.h"
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+namespace sylar
+{
+
+static Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<uint64_t> s_fiber_id {0};
+static std::atomic<uint64_t> s_fiber_count {0};
+
+static thread_local Fiber* t_fiber = nullptr;           // 当前协程
+static thread_local Fiber::ptr t_threadFiber = nullptr; // 线程主协程
+
+Fiber::Fiber() {
+    m_state = EXEC;
+    SetThis(this);
+
+    if (getcontext(&m_ctx)) {
+        SYLAR_PANIC("getcontext");
+    }
+    ++s_fiber_count;
+}
+
+Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller)
+    :m_id(++s_fiber_id)
+    ,m_cb(cb) {
+    ++s_fiber_count;
+    m_stacksize = stacksize ? stacksize : StackAllocator::GetDefaultStackSize();
+
+    m_allocator = StackAllocator::GetDefault();
+    m_stack = m_allocator->alloc(m_stacksize);
+    if (!m_stack) {
+        --s_fiber_count;
+        throw std::bad_alloc();
+    }
+    if (getcontext(&m_ctx)) {
+        SYLAR_PANIC("getcontext");
+    }
+    m_ctx.uc_link = nullptr;
+    m_ctx.uc_stack.ss_sp = m_stack;
+    m_ctx.uc_stack.ss_size = m_stacksize;
+
+    if (!use_caller) {
+        makecontext(&m_ctx, &Fiber::MainFunc, 0);
+    } else {
+        makecontext(&m_ctx, &Fiber::CallerMainFunc, 0);
+    }
+}
+
+Fiber::~Fiber() {
+    --s_fiber_count;
+    if (m_stack) {
+        SYLAR_ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
+        m_allocator->dealloc(m_stack, m_stacksize);
+    } else {
+        // 主协程
+        SYLAR_ASSERT(!m_cb);
+        SYLAR_ASSERT(m_state == EXEC);
+        if (t_fiber == this) {
+            SetThis(nullptr);
+        }
+    }
+}
+
+void Fiber::reset(std::function<void()> cb) {
+    SYLAR_ASSERT(m_stack);
+    SYLAR_ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
+    m_cb = cb;
+    if (getcontext(&m_ctx)) {
+        SYLAR_PANIC("getcontext");
+    }
+    m_ctx.uc_link = nullptr;
+    m_ctx.uc_stack.ss_sp = m_stack;
+    m_ctx.uc_stack.ss_size = m_stacksize;
+
+    makecontext(&m_ctx, &Fiber::MainFunc, 0);
+    m_state = INIT;
+    m_logContext.reset();
+}
+
+// 切换前保存切出协程的日志上下文，换上切入协程的
+static void SwitchLogContext(LogContext::ptr& from_ctx, const LogContext::ptr& to_ctx) {
+    from_ctx = LogContext::GetCurrent();
+    LogContext::SetCurrent(to_ctx);
+}
+
+void Fiber::call() {
+    SetThis(this);
+    m_state = EXEC;
+    SwitchLogContext(t_threadFiber->m_logContext, m_logContext);
+    if (swapcontext(&t_threadFiber->m_ctx, &m_ctx)) {
+        SYLAR_PANIC("swapcontext fiber_id=" << m_id);
+    }
+}
+
+void Fiber::back() {
+    SetThis(t_threadFiber.get());
+    SwitchLogContext(m_logContext, t_threadFiber->m_logContext);
+    if (swapcontext(&m_ctx, &t_threadFiber->m_ctx)) {
+        SYLAR_PANIC("swapcontext fiber_id=" << m_id);
+    }
+}
+
+// 调度协程，线程上没有调度器时就是线程主协程
+static Fiber* GetMainFiber() {
+    Fiber* main = Scheduler::GetMainFiber();
+    return main ? main : t_threadFiber.get();
+}
+
+void Fiber::swapIn() {
+    SetThis(this);
+    SYLAR_ASSERT(m_state != EXEC);
+    m_state = EXEC;
+    Fiber* main = GetMainFiber();
+    SwitchLogContext(main->m_logContext, m_logContext);
+    if (swapcontext(&main->m_ctx, &m_ctx)) {
+        SYLAR_PANIC("swapcontext fiber_id=" << m_id);
+    }
+}
+
+void Fiber::swapOut() {
+    Fiber* main = GetMainFiber();
+    SetThis(main);
+    SwitchLogContext(m_logContext, main->m_logContext);
+    if (swapcontext(&m_ctx, &main->m_ctx)) {
+        SYLAR_PANIC("swapcontext fiber_id=" << m_id);
+    }
+}
+
+void Fiber::SetThis(Fiber* f) {
+    t_fiber = f;
+}
+
+Fiber::ptr Fiber::GetThis() {
+    if (t_fiber) {
+        return t_fiber->shared_from_this();
+    }
+    Fiber::ptr main_fiber(new Fiber);
+    SYLAR_ASSERT(t_fiber == main_fiber.get());
+    t_threadFiber = main_fiber;
+    return t_fiber->shared_from_this();
+}
+
+void Fiber::YieldToReady() {
+    Fiber::ptr cur = GetThis();
+    SYLAR_ASSERT(cur->m_state == EXEC);
+    cur->m_state = READY;
+    cur->swapOut();
+}
+
+void Fiber::YieldToHold() {
+    Fiber::ptr cur = GetThis();
+    SYLAR_ASSERT(cur->m_state == EXEC);
+    cur->m_state = HOLD;
+    cur->swapOut();
+}
+
+uint64_t Fiber::TotalFibers() {
+    return s_fiber_count;
+}
+
+uint64_t Fiber::GetFiberId() {
+    if (t_fiber) {
+        return t_fiber->getId();
+    }
+    return 0;
+}
+
+bool Fiber::IsStackOverflow(void* addr) {
+    Fiber* cur = t_fiber;
+    if (!cur || !cur->m_stack || !cur->m_allocator) {
+        return false;
+    }
+    size_t guard = cur->m_allocator->getGuardSize();
+    return (char*)addr >= (char*)cur->m_stack - guard && (char*)addr < (char*)cur->m_stack;
+}
+
+void Fiber::MainFunc() {
+    Fiber::ptr cur = GetThis();
+    SYLAR_ASSERT(cur);
+    try {
+        cur->m_cb();
+        cur->m_cb = nullptr;
+        cur->m_state = TERM;
+    } catch (std::exception& ex) {
+        cur->m_state = EXCEPT;
+        SYLAR_LOG_ERROR(g_logger) << "Fiber Except: " << ex.what()
+            << " fiber_id=" << cur->getId()
+            << std::endl
+            << sylar::BacktraceToString();
+    } catch (...) {
+        cur->m_state = EXCEPT;
+        SYLAR_LOG_ERROR(g_logger) << "Fiber Except"
+            << " fiber_id=" << cur->getId()
+            << std::endl
+            << sylar::BacktraceToString();
+    }
+
+    // 切出去之后这个函数不会再返回，先把引用释放掉，否则协程对象永远不会析构
+    auto raw_ptr = cur.get();
+    cur.reset();
+    raw_ptr->swapOut();
+
+    SYLAR_ASSERT2(false, "never reach fiber_id=" << raw_ptr->getId());
+}
+
+void Fiber::CallerMainFunc() {
+    Fiber::ptr cur = GetThis();
+    SYLAR_ASSERT(cur);
+    try {
+        cur->m_cb();
+        cur->m_cb = nullptr;
+        cur->m_state = TERM;
+    } catch (std::exception& ex) {
+        cur->m_state = EXCEPT;
+        SYLAR_LOG_ERROR(g_logger) << "Fiber Except: " << ex.what()
+            << " fiber_id=" << cur->getId()
+            << std::endl
+            << sylar::BacktraceToString();
+    } catch (...) {
+        cur->m_state = EXCEPT;
+        SYLAR_LOG_ERROR(g_logger) << "Fiber Except"
+            << " fiber_id=" << cur->getId()
+            << std::endl
+            << sylar::BacktraceToString();
+    }
+
+    auto raw_ptr = cur.get();
+    cur.reset();
+    raw_ptr->back();
+
+    SYLAR_ASSERT2(false, "never reach fiber_id=" << raw_ptr->getId());
+}
+
+} // namespace sylar
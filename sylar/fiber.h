@@ -0,0 +1,88 @@
+#ifndef __SYLAR_FIBER_H__
+#define __SYLAR_FIBER_H__
+
+#include <ucontext.h>
+#include <stdint.h>
+#include <memory>
+#include <functional>
+#include "log.h"
+#include "stack_allocator.h"
+
+namespace sylar
+{
+
+class Scheduler;
+
+// 协程，基于 ucontext，每个协程有自己的栈
+// 每个线程第一次调用 GetThis() 时创建一个主协程（没有独立的栈，就是线程本身），
+// 协程 swapIn 时从调度协程切进来，swapOut 时切回调度协程
+// 日志上下文（LogContext）跟着协程走，切换时保存/恢复
+class Fiber : public std::enable_shared_from_this<Fiber>
+{
+friend class Scheduler;
+public:
+    typedef std::shared_ptr<Fiber> ptr;
+
+    enum State {
+        INIT,       // 初始化
+        HOLD,       // 挂起，等别人唤醒
+        EXEC,       // 执行中
+        TERM,       // 结束
+        READY,      // 可执行，放回调度队列
+        EXCEPT      // 异常结束
+    };
+private:
+    // 线程的主协程
+    Fiber();
+public:
+    // stacksize 为 0 时用配置 fiber.stack_size，栈由配置 fiber.stack_allocator 指定的分配器分配
+    // use_caller 为 true 时结束后切回线程主协程，调度器在 caller 线程上的根协程用
+    Fiber(std::function<void()> cb, size_t stacksize = 0, bool use_caller = false);
+    ~Fiber();
+
+    // 协程结束后复用栈，换一个函数重新执行
+    void reset(std::function<void()> cb);
+    // 从调度协程切到当前协程
+    void swapIn();
+    // 切回调度协程
+    void swapOut();
+    // 从线程主协程切到当前协程，调度器的根协程用
+    void call();
+    // 切回线程主协程
+    void back();
+
+    uint64_t getId() const { return m_id;}
+    State getState() const { return m_state;}
+public:
+    // 设置当前协程
+    static void SetThis(Fiber* f);
+    // 当前协程，线程还没有协程时创建主协程
+    static Fiber::ptr GetThis();
+    // 切回调度协程，并把自己放回调度队列
+    static void YieldToReady();
+    // 切回调度协程，挂起，等别人 schedule 才会再执行
+    static void YieldToHold();
+    // 协程总数
+    static uint64_t TotalFibers();
+    // 当前协程 id，不在协程里返回 0
+    static uint64_t GetFiberId();
+    // addr 是否落在当前协程栈底的保护页里，也就是栈溢出
+    // 崩溃处理里调用，只读线程局部变量，异步信号安全
+    static bool IsStackOverflow(void* addr);
+
+    static void MainFunc();
+    static void CallerMainFunc();
+private:
+    uint64_t m_id = 0;
+    uint32_t m_stacksize = 0;
+    State m_state = INIT;
+    ucontext_t m_ctx;
+    void* m_stack = nullptr;
+    StackAllocator* m_allocator = nullptr;  // 分配栈的分配器，释放时用同一个
+    std::function<void()> m_cb;
+    LogContext::ptr m_logContext;   // 切出去时保存的日志上下文
+};
+
+} // namespace sylar
+
+#endif // !__SYLAR_FIBER_H__
@@ -0,0 +1,131 @@
+#include "fiber_sync.h"
+
+namespace sylar
+{
+
+// 是否在调度器调度的协程里，调度协程自己和普通线程都不算
+static bool InScheduledFiber() {
+    return Scheduler::GetThis() && Scheduler::GetMainFiber()
+        && Fiber::GetFiberId() != 0
+        && Fiber::GetThis().get() != Scheduler::GetMainFiber();
+}
+
+static void UnlockGuard(void* arg) {
+    ((Spinlock*)arg)->unlock();
+}
+
+void FiberWaitQueue::wait(Spinlock& guard) {
+    if (InScheduledFiber()) {
+        m_waiters.push_back(Waiter());
+        m_waiters.back().scheduler = Scheduler::GetThis();
+        m_waiters.back().fiber = Fiber::GetThis();
+        // 切回调度协程之后才释放 guard，唤醒方拿到的一定是已经切出去的协程
+        Scheduler::YieldToHold(&UnlockGuard, &guard);
+    } else {
+        Semaphore sem;
+        m_waiters.push_back(Waiter());
+        m_waiters.back().sem = &sem;
+        guard.unlock();
+        sem.wait();
+    }
+}
+
+bool FiberWaitQueue::notify(Waker& waker) {
+    if (m_waiters.empty()) {
+        return false;
+    }
+    waker.m_waiters.push_back(std::move(m_waiters.front()));
+    m_waiters.pop_front();
+    return true;
+}
+
+FiberWaitQueue::Waker::~Waker() {
+    for (auto& i : m_waiters) {
+        if (i.sem) {
+            i.sem->notify();
+        } else {
+            i.scheduler->schedule(std::move(i.fiber));
+        }
+    }
+}
+
+void FiberMutex::lock() {
+    m_guard.lock();
+    if (!m_locked) {
+        m_locked = true;
+        m_guard.unlock();
+        return;
+    }
+    // unlock 时直接把锁交给队头，醒来时已经持有锁
+    m_waiters.wait(m_guard);
+}
+
+bool FiberMutex::tryLock() {
+    Spinlock::Lock lock(m_guard);
+    if (m_locked) {
+        return false;
+    }
+    m_locked = true;
+    return true;
+}
+
+void FiberMutex::unlock() {
+    FiberWaitQueue::Waker waker;
+    Spinlock::Lock lock(m_guard);
+    if (!m_waiters.notify(waker)) {
+        m_locked = false;
+    }
+}
+
+FiberSemaphore::FiberSemaphore(size_t count)
+    :m_count(count) {
+}
+
+void FiberSemaphore::wait() {
+    m_guard.lock();
+    if (m_count > 0) {
+        --m_count;
+        m_guard.unlock();
+        return;
+    }
+    m_waiters.wait(m_guard);
+}
+
+bool FiberSemaphore::tryWait() {
+    Spinlock::Lock lock(m_guard);
+    if (m_count > 0) {
+        --m_count;
+        return true;
+    }
+    return false;
+}
+
+void FiberSemaphore::notify() {
+    FiberWaitQueue::Waker waker;
+    Spinlock::Lock lock(m_guard);
+    if (!m_waiters.notify(waker)) {
+        ++m_count;
+    }
+}
+
+void FiberCondition::wait(FiberMutex::Lock& lock) {
+    m_guard.lock();
+    // 先排进等待队列再放开互斥量，notify 不会漏掉
+    lock.unlock();
+    m_waiters.wait(m_guard);
+    lock.lock();
+}
+
+void FiberCondition::notify() {
+    FiberWaitQueue::Waker waker;
+    Spinlock::Lock lock(m_guard);
+    m_waiters.notify(waker);
+}
+
+void FiberCondition::notifyAll() {
+    FiberWaitQueue::Waker waker;
+    Spinlock::Lock lock(m_guard);
+    while (m_waiters.notify(waker));
+}
+
+} // namespace sylar
@@ -0,0 +1,193 @@
+#ifndef __SYLAR_FIBER_SYNC_H__
+#define __SYLAR_FIBER_SYNC_H__
+
+#include <stdint.h>
+#include <memory>
+#include <list>
+#include <deque>
+#include <vector>
+#include "mutex.h"
+#include "fiber.h"
+#include "scheduler.h"
+
+namespace sylar
+{
+
+// 协程同步原语
+// 在调度器的协程里等待时只挂起当前协程，线程去执行别的协程，唤醒时把协程重新放回它的调度器；
+// 不在协程里（普通线程）调用时退化为阻塞线程，所以协程和普通线程之间也可以用
+// 唤醒按等待的先后顺序，锁和信号量直接交给被唤醒的一方，不会被后来者抢走
+
+// 等待队列，下面几个原语内部用
+class FiberWaitQueue : Noncopyable
+{
+public:
+    // 调用前持有 guard，把当前协程（不在协程里时是当前线程）挂到队尾并挂起
+    // 返回时已经被唤醒，guard 已经释放
+    void wait(Spinlock& guard);
+    // 唤醒队头，没有等待者返回 false，需要持有 guard
+    // 真正的唤醒（放回调度器）放在 guard 释放之后，由 Waker 析构时做
+    class Waker;
+    bool notify(Waker& waker);
+    bool empty() const { return m_waiters.empty();}
+    size_t size() const { return m_waiters.size();}
+private:
+    struct Waiter {
+        Scheduler* scheduler = nullptr;
+        Fiber::ptr fiber;
+        Semaphore* sem = nullptr;   // 普通线程等待时用
+    };
+    std::list<Waiter> m_waiters;
+public:
+    // 收集要唤醒的等待者，析构时统一唤醒，声明在 guard 的锁之前，保证先解锁再唤醒
+    class Waker : Noncopyable
+    {
+    friend class FiberWaitQueue;
+    public:
+        ~Waker();
+    private:
+        std::vector<Waiter> m_waiters;
+    };
+};
+
+// 协程互斥量
+class FiberMutex : Noncopyable
+{
+public:
+    typedef ScopedLockImpl<FiberMutex> Lock;
+
+    void lock();
+    bool tryLock();
+    void unlock();
+private:
+    Spinlock m_guard;
+    bool m_locked = false;
+    FiberWaitQueue m_waiters;
+};
+
+// 协程信号量
+class FiberSemaphore : Noncopyable
+{
+public:
+    FiberSemaphore(size_t count = 0);
+
+    void wait();
+    bool tryWait();
+    void notify();
+
+    size_t getCount() const { return m_count;}
+private:
+    Spinlock m_guard;
+    size_t m_count;
+    FiberWaitQueue m_waiters;
+};
+
+// 协程条件变量，和 FiberMutex 一起用
+class FiberCondition : Noncopyable
+{
+public:
+    // 释放 lock 并挂起，被唤醒后重新加锁再返回，可能有虚假唤醒，调用方要循环检查条件
+    void wait(FiberMutex::Lock& lock);
+    void notify();
+    void notifyAll();
+private:
+    Spinlock m_guard;
+    FiberWaitQueue m_waiters;
+};
+
+// 有界通道，类似 Go 的 chan
+// 满了 push 挂起，空了 pop 挂起；close 之后 push 失败，pop 取完剩下的之后失败
+template<class T>
+class Channel : Noncopyable
+{
+public:
+    typedef std::shared_ptr<Channel> ptr;
+
+    // capacity 为 0 时按 1 处理
+    Channel(size_t capacity)
+        :m_capacity(capacity ? capacity : 1) {
+    }
+
+    // 通道关闭返回 false
+    bool push(const T& v) {
+        FiberMutex::Lock lock(m_mutex);
+        while (m_queue.size() >= m_capacity && !m_closed) {
+            m_notFull.wait(lock);
+        }
+        if (m_closed) {
+            return false;
+        }
+        m_queue.push_back(v);
+        m_notEmpty.notify();
+        return true;
+    }
+
+    // 通道关闭并且取空了返回 false
+    bool pop(T& v) {
+        FiberMutex::Lock lock(m_mutex);
+        while (m_queue.empty() && !m_closed) {
+            m_notEmpty.wait(lock);
+        }
+        if (m_queue.empty()) {
+            return false;
+        }
+        v = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_notFull.notify();
+        return true;
+    }
+
+    // 不等待，满了或者关闭了返回 false
+    bool tryPush(const T& v) {
+        FiberMutex::Lock lock(m_mutex);
+        if (m_closed || m_queue.size() >= m_capacity) {
+            return false;
+        }
+        m_queue.push_back(v);
+        m_notEmpty.notify();
+        return true;
+    }
+
+    // 不等待，空了返回 false
+    bool tryPop(T& v) {
+        FiberMutex::Lock lock(m_mutex);
+        if (m_queue.empty()) {
+            return false;
+        }
+        v = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_notFull.notify();
+        return true;
+    }
+
+    // 关闭通道，唤醒所有等待的协程
+    void close() {
+        FiberMutex::Lock lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notifyAll();
+        m_notFull.notifyAll();
+    }
+
+    size_t size() {
+        FiberMutex::Lock lock(m_mutex);
+        return m_queue.size();
+    }
+
+    size_t getCapacity() const { return m_capacity;}
+
+    bool isClosed() {
+        FiberMutex::Lock lock(m_mutex);
+        return m_closed;
+    }
+private:
+    FiberMutex m_mutex;
+    FiberCondition m_notFull;
+    FiberCondition m_notEmpty;
+    std::deque<T> m_queue;
+    size_t m_capacity;
+    bool m_closed = false;
+};
+
+} // namespace sylar
+
+#endif // !__SYLAR_FIBER_SYNC_H__
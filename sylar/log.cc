@@ -1,9 +1,26 @@
 #include "log.h"
+#include "log_uring.h"
+#include "config.h"
+#include "macro.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <algorithm>
 
 
 namespace sylar
 {
 
+// 默认输出格式：时间，线程号，协程号，日志级别，日志名称，文件名，行号，日志内容
+static const char* s_default_pattern = "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n";
+
 const char* LogLevel::ToString(LogLevel::Level level) {
     switch(level) { // 定义了一个宏来取level
 # define XX(name) \
@@ -23,11 +40,41 @@ const char* LogLevel::ToString(LogLevel::Level level) {
     return "UNKNOW";
 }
 
+LogLevel::Level LogLevel::FromString(const std::string& str) {
+#define XX(level, v) \
+    if (str == #v) { \
+        return LogLevel::level; \
+    }
+    XX(DEBUG, debug);
+    XX(INFO, info);
+    XX(WARN, warn);
+    XX(ERROR, error);
+    XX(FATAL, fatal);
+
+    XX(DEBUG, DEBUG);
+    XX(INFO, INFO);
+    XX(WARN, WARN);
+    XX(ERROR, ERROR);
+    XX(FATAL, FATAL);
+#undef XX
+    return LogLevel::UNKNOW;
+}
+
  LogEventWrap::LogEventWrap(LogEvent::ptr e)
     :m_event(e) {
  }
 
+ // FATAL日志是否带上调用栈，在文件后面和logs配置一起定义
+ static bool IsFatalBacktraceEnabled();
+
  LogEventWrap::~LogEventWrap() {
+    if (m_event->getSuppressed()) {
+        m_event->getSS() << " (... " << m_event->getSuppressed() << " similar messages suppressed)";
+    }
+    if (m_event->getLevel() == LogLevel::FATAL && IsFatalBacktraceEnabled()) {
+        // 跳过 Backtrace、BacktraceToString 和析构函数自己
+        m_event->getSS() << std::endl << BacktraceToString(64, 3, "    ");
+    }
     m_event->getLogger()->log(m_event->getLevel(), m_event);
  }
 
@@ -54,6 +101,290 @@ std::stringstream& LogEventWrap::getSS() {
     return m_event->getSS();
 }
 
+void LogEvent::pushField(const LogField& f) {
+    if (m_fieldCount < s_inline_fields) {
+        m_fields[m_fieldCount] = f;
+    } else {
+        m_moreFields.push_back(f);
+    }
+    ++m_fieldCount;
+}
+
+void LogEvent::addField(const char* key, bool v) {
+    LogField f;
+    f.key = key;
+    f.type = LogField::BOOL;
+    f.b = v;
+    pushField(f);
+}
+
+void LogEvent::addField(const char* key, const char* v) {
+    addField(key, v, strlen(v));
+}
+
+void LogEvent::addField(const char* key, const std::string& v) {
+    addField(key, v.c_str(), v.size());
+}
+
+void LogEvent::addField(const char* key, const char* v, size_t len) {
+    LogField f;
+    f.key = key;
+    f.type = LogField::STRING;
+    // 内部缓冲放得下就拷进去，否则放到堆上
+    if (m_bufUsed + len <= s_inline_buf) {
+        memcpy(m_buf + m_bufUsed, v, len);
+        f.str.ptr = m_buf + m_bufUsed;
+        m_bufUsed += len;
+    } else {
+        m_moreStrs.push_back(std::string(v, len));
+        f.str.ptr = m_moreStrs.back().c_str();
+    }
+    f.str.len = len;
+    pushField(f);
+}
+
+// 单调时钟，纳秒，限流用，不受系统时间调整影响
+static uint64_t GetMonotonicNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+LogSite::Pass LogSite::suppress() {
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return {false, 0};
+}
+
+LogSite::Pass LogSite::everyN(uint64_t n) {
+    uint64_t c = m_count.fetch_add(1, std::memory_order_relaxed);
+    if (n <= 1 || c % n == 0) {
+        return {true, m_suppressed.exchange(0, std::memory_order_relaxed)};
+    }
+    return suppress();
+}
+
+LogSite::Pass LogSite::firstN(uint64_t n) {
+    uint64_t c = m_count.fetch_add(1, std::memory_order_relaxed);
+    if (c < n) {
+        return {true, 0};
+    }
+    return suppress();
+}
+
+LogSite::Pass LogSite::everyMs(uint64_t ms) {
+    uint64_t now = GetMonotonicNS() / 1000000;
+    uint64_t last = m_lastMs.load(std::memory_order_relaxed);
+    // 多个线程同时到期，只有CAS成功的那个输出
+    if ((last == 0 || now - last >= ms)
+            && m_lastMs.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        return {true, m_suppressed.exchange(0, std::memory_order_relaxed)};
+    }
+    return suppress();
+}
+
+TokenBucket::TokenBucket(double rate, uint64_t burst)
+    :m_rate(rate > 0 ? rate : 1)
+    ,m_burst(burst ? burst : 1) {
+    m_interval = 1000000000.0 / m_rate;
+    m_tolerance = m_interval * (m_burst - 1);
+}
+
+bool TokenBucket::tryAcquire() {
+    uint64_t now = GetMonotonicNS();
+    uint64_t tat = m_tat.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t t = std::max(tat, now);
+        // 预支的令牌超过突发量，拒绝
+        if (t - now > m_tolerance) {
+            return false;
+        }
+        if (m_tat.compare_exchange_weak(tat, t + m_interval, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+// 配置 log.metrics.enable，变化时更新
+static std::atomic<bool> s_metrics_enabled {false};
+// 拿不到当前 CPU 时，每个线程固定用一个分片，第一次用的时候轮流分配
+static std::atomic<uint32_t> s_metrics_next_shard {0};
+static thread_local int t_metrics_shard = -1;
+// 本线程格式化的耗时和字节数，Logger::log 在调用每个 appender 前清零，调用后取走
+static thread_local uint64_t t_format_ns = 0;
+static thread_local uint64_t t_format_bytes = 0;
+
+static void AddFormatStat(uint64_t begin, size_t bytes) {
+    if (begin) {
+        t_format_ns += GetMonotonicNS() - begin;
+        t_format_bytes += bytes;
+    }
+}
+
+LogMetrics::LogMetrics()
+    :m_shards(nullptr) {
+}
+
+LogMetrics::~LogMetrics() {
+    delete[] m_shards.load(std::memory_order_relaxed);
+}
+
+uint32_t LogMetrics::ShardCount() {
+    static const uint32_t s_count = []() {
+        long n = sysconf(_SC_NPROCESSORS_CONF);
+        uint32_t c = 1;
+        while ((long)c < n) {
+            c <<= 1;
+        }
+        return c;
+    }();
+    return s_count;
+}
+
+LogMetrics::Shard& LogMetrics::getShard() {
+    Shard* shards = m_shards.load(std::memory_order_acquire);
+    if (SYLAR_UNLIKELY(!shards)) {
+        // 值初始化，计数都是 0；抢输的那个释放自己分配的
+        Shard* p = new Shard[ShardCount()]();
+        if (m_shards.compare_exchange_strong(shards, p, std::memory_order_acq_rel)) {
+            shards = p;
+        } else {
+            delete[] p;
+        }
+    }
+    int cpu = sched_getcpu();
+    if (SYLAR_UNLIKELY(cpu < 0)) {
+        if (t_metrics_shard < 0) {
+            t_metrics_shard = s_metrics_next_shard.fetch_add(1, std::memory_order_relaxed);
+        }
+        cpu = t_metrics_shard;
+    }
+    return shards[cpu & (ShardCount() - 1)];
+}
+
+void LogMetrics::addEvent(LogLevel::Level level, uint64_t bytes, uint64_t format_ns, uint64_t write_ns) {
+    // 线程可能在两次加之间被换到别的 CPU，计数还是原子的，只是偶尔有争用，relaxed 就够了
+    Shard& s = getShard();
+    s.events[level < kLevels ? level : 0].fetch_add(1, std::memory_order_relaxed);
+    s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    s.format_ns.fetch_add(format_ns, std::memory_order_relaxed);
+    s.write_ns.fetch_add(write_ns, std::memory_order_relaxed);
+    s.write_hist[BucketIndex(write_ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LogMetrics::addDrop(uint64_t n) {
+    getShard().drops.fetch_add(n, std::memory_order_relaxed);
+}
+
+LogMetrics::Snapshot LogMetrics::getSnapshot() const {
+    Snapshot r;
+    Shard* shards = m_shards.load(std::memory_order_acquire);
+    if (!shards) {
+        return r;
+    }
+    for (uint32_t n = 0; n < ShardCount(); ++n) {
+        const Shard& s = shards[n];
+        for (int i = 0; i < kLevels; ++i) {
+            r.events[i] += s.events[i].load(std::memory_order_relaxed);
+        }
+        r.bytes += s.bytes.load(std::memory_order_relaxed);
+        r.drops += s.drops.load(std::memory_order_relaxed);
+        r.format_ns += s.format_ns.load(std::memory_order_relaxed);
+        r.write_ns += s.write_ns.load(std::memory_order_relaxed);
+        for (int i = 0; i < kBuckets; ++i) {
+            r.write_hist[i] += s.write_hist[i].load(std::memory_order_relaxed);
+        }
+    }
+    return r;
+}
+
+void LogMetrics::reset() {
+    Shard* shards = m_shards.load(std::memory_order_acquire);
+    if (!shards) {
+        return;
+    }
+    for (uint32_t n = 0; n < ShardCount(); ++n) {
+        Shard& s = shards[n];
+        for (auto& i : s.events) {
+            i.store(0, std::memory_order_relaxed);
+        }
+        s.bytes.store(0, std::memory_order_relaxed);
+        s.drops.store(0, std::memory_order_relaxed);
+        s.format_ns.store(0, std::memory_order_relaxed);
+        s.write_ns.store(0, std::memory_order_relaxed);
+        for (auto& i : s.write_hist) {
+            i.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+// 0 ~ 3 各一个桶；之后 [2^e, 2^(e+1)) 分成 4 个桶
+int LogMetrics::BucketIndex(uint64_t ns) {
+    if (ns < (uint64_t)kSubBuckets) {
+        return ns;
+    }
+    int e = 63 - __builtin_clzll(ns);
+    int idx = (e - 1) * kSubBuckets + ((ns >> (e - 2)) & (kSubBuckets - 1));
+    return idx < kBuckets ? idx : kBuckets - 1;
+}
+
+uint64_t LogMetrics::BucketUpper(int idx) {
+    if (idx < kSubBuckets) {
+        return idx;
+    }
+    int e = idx / kSubBuckets + 1;
+    uint64_t step = 1ul << (e - 2);
+    return (kSubBuckets + idx % kSubBuckets) * step + step - 1;
+}
+
+bool LogMetrics::IsEnabled() {
+    return s_metrics_enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t LogMetrics::Snapshot::getEvents() const {
+    uint64_t n = 0;
+    for (auto& i : events) {
+        n += i;
+    }
+    return n;
+}
+
+uint64_t LogMetrics::Snapshot::getWritePercentile(double p) const {
+    uint64_t total = 0;
+    for (auto& i : write_hist) {
+        total += i;
+    }
+    if (!total) {
+        return 0;
+    }
+    uint64_t target = std::max((uint64_t)1, (uint64_t)(p * total + 0.5));
+    uint64_t sum = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        sum += write_hist[i];
+        if (sum >= target) {
+            return BucketUpper(i);
+        }
+    }
+    return BucketUpper(kBuckets - 1);
+}
+
+std::string LogMetrics::Snapshot::toString() const {
+    std::stringstream ss;
+    ss << "events=" << getEvents();
+    for (int i = LogLevel::DEBUG; i < kLevels; ++i) {
+        if (events[i]) {
+            ss << " " << LogLevel::ToString((LogLevel::Level)i) << "=" << events[i];
+        }
+    }
+    ss << " bytes=" << bytes
+       << " drops=" << drops
+       << " format_ns=" << format_ns
+       << " write_ns=" << write_ns
+       << " write_p50_ns=" << getWritePercentile(0.5)
+       << " write_p99_ns=" << getWritePercentile(0.99)
+       << " write_p999_ns=" << getWritePercentile(0.999);
+    return ss.str();
+}
+
 // 七八个实例
 // 输出信息
 class MessageFormatItem : public LogFormatter::FormatItem 
@@ -105,6 +436,16 @@ public:
     }
 };
 
+// 输出线程名称
+class ThreadNameFormatItem : public LogFormatter::FormatItem 
+{
+public:
+    ThreadNameFormatItem(const std::string& str = "") {}
+    void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
+        os << event->getThreadName();
+    }
+};
+
 // 输出协程号
 class FiberIdFormatItem : public LogFormatter::FormatItem 
 {
@@ -177,6 +518,83 @@ public:
     }
 };
 
+// 输出结构化字段，key=value 以空格分隔，含空格、引号、等号的字符串值加引号
+class KeyValueFormatItem : public LogFormatter::FormatItem 
+{
+public:
+    KeyValueFormatItem(const std::string& str = "") {}
+    void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
+        for (size_t i = 0; i < event->getFieldCount(); ++i) {
+            const LogField& f = event->getField(i);
+            if (i) {
+                os << ' ';
+            }
+            os << f.key << '=';
+            switch (f.type) {
+                case LogField::INT:
+                    os << f.i;
+                    break;
+                case LogField::UINT:
+                    os << f.u;
+                    break;
+                case LogField::DOUBLE:
+                    os << f.d;
+                    break;
+                case LogField::BOOL:
+                    os << (f.b ? "true" : "false");
+                    break;
+                case LogField::STRING:
+                    if (f.str.len == 0 || memchr(f.str.ptr, ' ', f.str.len)
+                            || memchr(f.str.ptr, '"', f.str.len)
+                            || memchr(f.str.ptr, '=', f.str.len)) {
+                        os << '"';
+                        for (uint32_t j = 0; j < f.str.len; ++j) {
+                            if (f.str.ptr[j] == '"' || f.str.ptr[j] == '\\') {
+                                os << '\\';
+                            }
+                            os << f.str.ptr[j];
+                        }
+                        os << '"';
+                    } else {
+                        os.write(f.str.ptr, f.str.len);
+                    }
+                    break;
+            }
+        }
+    }
+};
+
+// %X{key} 输出日志上下文里的 key，%X 不带 key 输出全部 key=value
+class ContextFormatItem : public LogFormatter::FormatItem 
+{
+public:
+    ContextFormatItem(const std::string& str = "")
+        :m_key(str) {}
+    void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override {
+        const LogContext::ptr& ctx = event->getContext();
+        if (!ctx) {
+            return;
+        }
+        if (!m_key.empty()) {
+            auto it = ctx->find(m_key);
+            if (it != ctx->end()) {
+                os << it->second;
+            }
+            return;
+        }
+        bool first = true;
+        for (auto& i : *ctx) {
+            if (!first) {
+                os << ' ';
+            }
+            first = false;
+            os << i.first << '=' << i.second;
+        }
+    }
+private:
+    std::string m_key;
+};
+
 // 输出
 class StringFormatItem : public LogFormatter::FormatItem 
 {
@@ -190,55 +608,313 @@ private:
     std::string m_string;
 };
 
+// 每个线程当前的日志上下文
+static thread_local LogContext::ptr t_log_context;
+
+void LogContext::Put(const std::string& key, const std::string& value) {
+    std::shared_ptr<Map> m = t_log_context ? std::make_shared<Map>(*t_log_context)
+                                           : std::make_shared<Map>();
+    (*m)[key] = value;
+    t_log_context = m;
+}
+
+void LogContext::Remove(const std::string& key) {
+    if (!t_log_context || !t_log_context->count(key)) {
+        return;
+    }
+    if (t_log_context->size() == 1) {
+        t_log_context.reset();
+        return;
+    }
+    std::shared_ptr<Map> m = std::make_shared<Map>(*t_log_context);
+    m->erase(key);
+    t_log_context = m;
+}
+
+void LogContext::Clear() {
+    t_log_context.reset();
+}
+
+std::string LogContext::Get(const std::string& key) {
+    if (!t_log_context) {
+        return "";
+    }
+    auto it = t_log_context->find(key);
+    return it == t_log_context->end() ? "" : it->second;
+}
+
+LogContext::ptr LogContext::GetCurrent() {
+    return t_log_context;
+}
+
+void LogContext::SetCurrent(ptr ctx) {
+    t_log_context.swap(ctx);
+}
+
+LogContext::Scoped::Scoped(const std::string& key, const std::string& value)
+    :m_key(key)
+    ,m_hadOld(false) {
+    if (t_log_context) {
+        auto it = t_log_context->find(key);
+        if (it != t_log_context->end()) {
+            m_old = it->second;
+            m_hadOld = true;
+        }
+    }
+    Put(key, value);
+}
+
+LogContext::Scoped::~Scoped() {
+    if (m_hadOld) {
+        Put(m_key, m_old);
+    } else {
+        Remove(m_key);
+    }
+}
+
 LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse,
-            uint32_t thread_id, uint32_t fiber_id, uint64_t time) 
+            uint32_t thread_id, uint32_t fiber_id, uint64_t time, const std::string& thread_name)
             :m_file(file)
             ,m_line(line)
             ,m_elapse(elapse)
             ,m_threadId(thread_id)
             ,m_fiberId(fiber_id)
-            ,m_time(time) 
+            ,m_time(time)
+            ,m_threadName(thread_name)
             ,m_logger(logger) 
-            ,m_level(level) {
+            ,m_level(level)
+            ,m_context(LogContext::GetCurrent()) {
 
 }
 
 
 Logger::Logger(const std::string& name)
-    :m_name(name), m_level(LogLevel::DEBUG) {
+    :m_name(name), m_level(LogLevel::DEBUG), m_effectiveLevel(LogLevel::DEBUG)
+    ,m_appenders(new std::vector<LogAppender::ptr>) {
     // 初始化输出格式：时间，线程号，协程号，日志级别，日志名称，文件名，文件名，行号，日志内容
-    m_formatter.reset(new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"));    
+    m_formatter.reset(new LogFormatter(s_default_pattern));
+}
+
+void Logger::setLevel(LogLevel::Level val) {
+    {
+        MutexType::Lock lock(m_mutex);
+        m_level = val;
+    }
+    updateEffectiveLevel();
+}
+
+// 从上往下逐个加锁，和 getLogger 挂子日志器时的顺序一致
+void Logger::updateEffectiveLevel() {
+    MutexType::Lock lock(m_mutex);
+    if (m_level != LogLevel::UNKNOW) {
+        m_effectiveLevel = m_level;
+    } else if (m_parent) {
+        m_effectiveLevel = m_parent->getLevel();
+    } else {
+        m_effectiveLevel = LogLevel::DEBUG;
+    }
+    for (auto i : m_children) {
+        i->updateEffectiveLevel();
+    }
+}
+
+bool Logger::isAdditive() {
+    MutexType::Lock lock(m_mutex);
+    return m_additive;
+}
+
+void Logger::setAdditive(bool v) {
+    MutexType::Lock lock(m_mutex);
+    m_additive = v;
+}
+
+void Logger::setRateLimit(TokenBucket::ptr val) {
+    MutexType::Lock lock(m_mutex);
+    if (val == m_rateLimit) {
+        return;
+    }
+    if (m_rateLimit) {
+        m_retiredLimits.push_back(m_rateLimit);
+    }
+    m_rateLimit = val;
+    m_rateLimitPtr.store(val.get(), std::memory_order_release);
+}
+
+TokenBucket::ptr Logger::getRateLimit() {
+    MutexType::Lock lock(m_mutex);
+    return m_rateLimit;
+}
+
+LogFormatter::ptr Logger::getFormatter() {
+    MutexType::Lock lock(m_mutex);
+    return m_formatter;
+}
+
+void Logger::setFormatter(LogFormatter::ptr val) {
+    MutexType::Lock lock(m_mutex);
+    m_formatter = val;
+    // 没有自己formatter的appender跟着logger走
+    for (auto& i : *m_appenders) {
+        LogAppender::MutexType::Lock ll(i->m_mutex);
+        if (!i->m_hasFormatter) {
+            i->m_formatter = m_formatter;
+        }
+    }
+}
+
+void Logger::setFormatter(const std::string& val) {
+    LogFormatter::ptr new_val = LogFormatter::Create(val);
+    if (new_val->isError()) {
+        std::cout << "Logger setFormatter name=" << m_name
+                  << " value=" << val << " invalid formatter"
+                  << std::endl;
+        return;
+    }
+    setFormatter(new_val);
+}
+
+std::string Logger::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["name"] = m_name;
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    if (m_additive) {
+        node["additivity"] = true;
+    }
+    if (m_rateLimit) {
+        node["rate_limit"]["rate"] = m_rateLimit->getRate();
+        node["rate_limit"]["burst"] = m_rateLimit->getBurst();
+    }
+    for (auto& i : *m_appenders) {
+        node["appenders"].push_back(YAML::Load(i->toYamlString()));
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
 }
 
 // 添加appender
 void Logger::addAppender(LogAppender::ptr appender) {
+    MutexType::Lock lock(m_mutex);
     // 如果appender没有formatter，就把默认的传进去
-    if (!appender->getFormatter()) {
-        appender->setFormatter(m_formatter);
+    // 直接赋值m_formatter，这样logger换formatter时appender能跟着换
+    {
+        LogAppender::MutexType::Lock ll(appender->m_mutex);
+        if (!appender->m_formatter) {
+            appender->m_formatter = m_formatter;
+        }
     }
-    m_appenders.push_back(appender);
+    // 拷一份再换掉，正在用旧集合的 log 不受影响
+    std::shared_ptr<std::vector<LogAppender::ptr> > list(new std::vector<LogAppender::ptr>(*m_appenders));
+    list->push_back(appender);
+    m_appenders = list;
 }
 // 删除appender
 void Logger::delAppender(LogAppender::ptr appender) {
+    MutexType::Lock lock(m_mutex);
     // 遍历appenders集合，如果要删除的appender的指针在集合里，则删除
-    for (auto it = m_appenders.begin(); it != m_appenders.end(); ++it) {
+    std::shared_ptr<std::vector<LogAppender::ptr> > list(new std::vector<LogAppender::ptr>(*m_appenders));
+    for (auto it = list->begin(); it != list->end(); ++it) {
         if (*it == appender) {
-            m_appenders.erase(it);
+            list->erase(it);
+            m_appenders = list;
             break;
         }
     }
 }
 
+void Logger::clearAppenders() {
+    MutexType::Lock lock(m_mutex);
+    m_appenders.reset(new std::vector<LogAppender::ptr>);
+}
+
+Logger::AppenderList Logger::getAppenders() {
+    MutexType::Lock lock(m_mutex);
+    return m_appenders;
+}
+
+// flush、reopen 都可能阻塞在磁盘上，不持有日志器的锁
+void Logger::flush() {
+    AppenderList appenders = getAppenders();
+    for (auto& i : *appenders) {
+        i->flush();
+    }
+}
+
+void Logger::reopen() {
+    AppenderList appenders = getAppenders();
+    for (auto& i : *appenders) {
+        i->reopen();
+    }
+}
+
 // 日志输出
 void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
     // 传入的level大于等于m_level则输出
     // 遍历每个appender，再用appender把它输出出来
-    if (level >= m_level) {
+    if (level >= getLevel()) {
         // 返回对象T的shared_ptr指针，就能把自己作为智能指针传出去
+        TokenBucket* limit = m_rateLimitPtr.load(std::memory_order_acquire);
+        if (limit) {
+            if (!limit->tryAcquire()) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                m_metrics.addDrop();
+                return;
+            }
+            uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped) {
+                event->getSS() << " (... " << dropped << " messages dropped by rate limit)";
+            }
+        }
+
         auto self = shared_from_this(); 
-        for (auto& i : m_appenders) {
-            // appenders集合里是每个appender的ptr
-            i->log(self, level, event);
+        bool metrics = LogMetrics::IsEnabled();
+        uint64_t begin = metrics ? GetMonotonicNS() : 0;
+        uint64_t format_ns = 0;
+        uint64_t bytes = 0;
+        // 从自己往上找appender：没有appender或者设置了可加性就继续交给父日志器
+        // 父日志器的级别不再判断，和log4j一样只看appender自己的级别
+        // 锁里只取 appender 集合和可加性，调用 appender（可能阻塞在 I/O 上）时不持有锁，m_parent 创建后不会变
+        for (Logger* l = this; l; l = l->m_parent.get()) {
+            AppenderList appenders;
+            bool additive;
+            {
+                MutexType::Lock lock(l->m_mutex);
+                appenders = l->m_appenders;
+                additive = l->m_additive;
+            }
+            for (auto& i : *appenders) {
+                // appenders集合里是每个appender的ptr
+                if (!metrics) {
+                    i->log(self, level, event);
+                    continue;
+                }
+                // 格式化的耗时和字节数由 formatter 记在线程局部变量里，剩下的算写入
+                t_format_ns = 0;
+                t_format_bytes = 0;
+                uint64_t start = GetMonotonicNS();
+                i->log(self, level, event);
+                uint64_t used = GetMonotonicNS() - start;
+                uint64_t fmt = std::min(t_format_ns, used);
+                if (level >= i->getLevel()) {
+                    i->m_metrics.addEvent(level, t_format_bytes, fmt, used - fmt);
+                }
+                format_ns += fmt;
+                bytes += t_format_bytes;
+            }
+            if (!appenders->empty() && !additive) {
+                break;
+            }
+        }
+        if (metrics) {
+            uint64_t used = GetMonotonicNS() - begin;
+            format_ns = std::min(format_ns, used);
+            m_metrics.addEvent(level, bytes, format_ns, used - format_ns);
         }
     }
 }
@@ -263,49 +939,1005 @@ void Logger::fatal(LogEvent::ptr event) {
     log(LogLevel::FATAL, event);
 }
 
-FileLogAppender::FileLogAppender(const std::string& filename)
-    :m_filename(filename) {
-    reopen();
+void LogAppender::setFormatter(LogFormatter::ptr val) {
+    MutexType::Lock lock(m_mutex);
+    m_formatter = val;
+    m_hasFormatter = !!val;
 }
 
-void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
-    if (level >= m_level) {
-        m_filestream << m_formatter->format(logger, level, event);
+LogFormatter::ptr LogAppender::getFormatter() {
+    MutexType::Lock lock(m_mutex);
+    return m_formatter;
+}
+
+LogMetrics::Snapshot LogAppender::getMetrics() const {
+    LogMetrics::Snapshot s = m_metrics.getSnapshot();
+    s.drops += getDropped();
+    return s;
+}
+
+// 压缩模式下 flush 最多等写线程多久
+static const uint32_t s_flush_wait_ms = 2000;
+
+FileLogAppender::FileLogAppender(const std::string& filename, const std::string& compress,
+                                 int compress_level, size_t flush_bytes, uint32_t flush_ms,
+                                 size_t max_pending)
+    :m_filename(filename)
+    ,m_compressLevel(compress_level)
+    ,m_flushBytes(flush_bytes ? flush_bytes : 1)
+    ,m_flushMs(flush_ms ? flush_ms : 1)
+    ,m_maxPending(std::max(max_pending, m_flushBytes))
+    ,m_rawBytes(0)
+    ,m_fileBytes(0)
+    ,m_compressNs(0)
+    ,m_dropped(0) {
+    if (!compress.empty() && compress != "none") {
+        m_compressor = LogCompressor::Create(compress, compress_level);
+        if (m_compressor) {
+            m_compress = compress;
+        } else {
+            std::cout << "FileLogAppender compress=" << compress
+                      << " not supported, write plain file=" << filename << std::endl;
+        }
+    }
+    reopen();
+    if (m_compressor) {
+        m_pending.reserve(m_flushBytes);
+        m_lastWriteMs = GetCurrentMS();
+#ifndef SYLAR_SINGLE_THREAD
+        m_thread.reset(new Thread(std::bind(&FileLogAppender::writerLoop, this), "log_writer"));
+#endif
     }
 }
 
-// 有时候会重新打开日志文件，文件打开成功，返回true
-bool FileLogAppender::reopen() {
-    // 如果已经是打开的，则先关闭
-    if (m_filestream) {
-        m_filestream.close();
+FileLogAppender::~FileLogAppender() {
+    if (m_thread) {
+        {
+            Mutex::Lock lock(m_pendingMutex);
+            m_stop = true;
+        }
+        m_cond.notify_one();
+        m_thread->join();
+    } else if (m_compressor) {
+        flush();
     }
-    m_filestream.open(m_filename);
-    return !!m_filestream;
 }
 
-void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
-    // 初始化后有一个format，就可以直接把日志事件序列化下来
+void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
     if (level >= m_level) {
-        std::cout << m_formatter->format(logger, level, event);
+        MutexType::Lock lock(m_mutex);
+        if (!m_compressor) {
+            m_filestream << m_formatter->format(logger, level, event);
+            return;
+        }
+        // 调用方只做格式化，压缩和写文件交给后台线程
+        std::string str = m_formatter->format(logger, level, event);
+        lock.unlock();
+        if (!m_thread) {
+            // 单线程构建没有写线程，攒够一批或到了时间就在这里压缩
+            m_pending.append(str);
+            uint64_t now = GetCurrentMS();
+            if (m_pending.size() >= m_flushBytes || now - m_lastWriteMs >= m_flushMs) {
+                flush();
+            }
+            return;
+        }
+        bool notify = false;
+        {
+            Mutex::Lock plock(m_pendingMutex);
+            // 写线程跟不上，缓冲不再增长，丢弃这条
+            if (m_pending.size() + str.size() > m_maxPending) {
+                ++m_dropped;
+                m_full = true;
+                notify = true;
+            } else {
+                m_pending.append(str);
+                notify = m_pending.size() >= m_flushBytes;
+            }
+        }
+        if (notify) {
+            m_cond.notify_one();
+        }
     }
 }
 
-LogFormatter::LogFormatter(const std::string& pattern) 
-    :m_pattern(pattern) {
-    init();
+void FileLogAppender::writerLoop() {
+    std::string buf;
+    std::string frame;
+    std::unique_lock<Mutex> lock(m_pendingMutex);
+    while (true) {
+        m_cond.wait_for(lock, std::chrono::milliseconds(m_flushMs), [this]() {
+            return m_stop || m_full || m_pending.size() >= m_flushBytes || m_flushReq != m_flushDone;
+        });
+        buf.swap(m_pending);
+        m_full = false;
+        uint64_t req = m_flushReq;
+        bool stop = m_stop;
+        lock.unlock();
+
+        if (!buf.empty()) {
+            writeFrame(buf, frame);
+            buf.clear();
+        }
+
+        lock.lock();
+        m_flushDone = req;
+        m_flushedCond.notify_all();
+        if (stop && m_pending.empty()) {
+            break;
+        }
+    }
 }
 
-std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
-    std::stringstream ss;
-    for (auto& i : m_items) {
-        i->format(ss, logger, level, event);   // 输出事件到接收流
+void FileLogAppender::writeFrame(const std::string& buf, std::string& frame) {
+    // 一批日志压成一个帧
+    frame.clear();
+    uint64_t begin = GetCurrentUS();
+    bool ok = m_compressor->compressFrame(buf.c_str(), buf.size(), frame);
+    m_compressNs += (GetCurrentUS() - begin) * 1000;
+    m_rawBytes += buf.size();
+    MutexType::Lock flock(m_mutex);
+    if (ok) {
+        m_filestream.write(frame.c_str(), frame.size());
+        m_fileBytes += frame.size();
+    } else {
+        std::cout << "FileLogAppender compress=" << m_compress
+                  << " fail, drop " << buf.size() << " bytes" << std::endl;
     }
-    return ss.str();
+    m_filestream.flush();
 }
 
-// 做日志格式解析
-// 格式可能为 %xxx(%后直接跟格式) 和 %xxx{xxx}(格式里还套了格式，第一个xxx格式称为str，第二个xxx称为format），
+void FileLogAppender::flush() {
+    if (!m_compressor) {
+        MutexType::Lock lock(m_mutex);
+        m_filestream.flush();
+        return;
+    }
+    if (!m_thread) {
+        if (!m_pending.empty()) {
+            std::string frame;
+            writeFrame(m_pending, frame);
+            m_pending.clear();
+        }
+        m_lastWriteMs = GetCurrentMS();
+        return;
+    }
+    std::unique_lock<Mutex> lock(m_pendingMutex);
+    uint64_t req = ++m_flushReq;
+    m_cond.notify_one();
+    // 写线程卡在磁盘上时不能一直等，崩溃处理和退出都会调 flush
+    if (!m_flushedCond.wait_for(lock, std::chrono::milliseconds(s_flush_wait_ms),
+            [this, req]() { return m_flushDone >= req;})) {
+        std::cout << "FileLogAppender file=" << m_filename << " flush timeout after "
+                  << s_flush_wait_ms << "ms" << std::endl;
+    }
+}
+
+std::string FileLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "FileLogAppender";
+    node["file"] = m_filename;
+    if (m_compressor) {
+        node["compress"] = m_compress;
+        if (m_compressLevel) {
+            node["compress_level"] = m_compressLevel;
+        }
+        node["flush_bytes"] = m_flushBytes;
+        node["flush_ms"] = m_flushMs;
+        node["max_pending"] = m_maxPending;
+    }
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+// 有时候会重新打开日志文件，文件打开成功，返回true
+bool FileLogAppender::reopen() {
+    // 压缩模式先把缓冲里的写完，保证帧不会跨文件
+    if (m_compressor) {
+        flush();
+    }
+    MutexType::Lock lock(m_mutex);
+    // 如果已经是打开的，则先关闭
+    if (m_filestream) {
+        m_filestream.close();
+    }
+    // 追加写，配置重载重建appender时不会把已有日志清掉
+    m_filestream.open(m_filename, std::ios::app);
+    return !!m_filestream;
+}
+
+void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    // 初始化后有一个format，就可以直接把日志事件序列化下来
+    if (level >= m_level) {
+        MutexType::Lock lock(m_mutex);
+        std::cout << m_formatter->format(logger, level, event);
+    }
+}
+
+void StdoutLogAppender::flush() {
+    MutexType::Lock lock(m_mutex);
+    std::cout.flush();
+}
+
+std::string StdoutLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "StdoutLogAppender";
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+void NullLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (m_format && level >= m_level) {
+        MutexType::Lock lock(m_mutex);
+        m_formatter->format(logger, level, event);
+    }
+}
+
+std::string NullLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "NullLogAppender";
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+// 存活的环形缓冲，信号处理函数里要能遍历，用只增不删的无锁链表
+// 环形缓冲析构时只把节点的指针清空，节点留给后面注册的复用
+struct RingNode {
+    std::atomic<MemoryRingLogAppender*> ring;
+    RingNode* next;
+};
+static std::atomic<RingNode*> s_rings{nullptr};
+
+static void RegisterRing(MemoryRingLogAppender* ring) {
+    for (RingNode* n = s_rings.load(std::memory_order_acquire); n; n = n->next) {
+        MemoryRingLogAppender* expected = nullptr;
+        if (n->ring.compare_exchange_strong(expected, ring)) {
+            return;
+        }
+    }
+    RingNode* node = new RingNode;
+    node->ring.store(ring, std::memory_order_relaxed);
+    node->next = s_rings.load(std::memory_order_relaxed);
+    while (!s_rings.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                          std::memory_order_relaxed));
+}
+
+static void UnregisterRing(MemoryRingLogAppender* ring) {
+    for (RingNode* n = s_rings.load(std::memory_order_acquire); n; n = n->next) {
+        MemoryRingLogAppender* expected = ring;
+        if (n->ring.compare_exchange_strong(expected, nullptr)) {
+            return;
+        }
+    }
+}
+
+// 写满len个字节，处理EINTR和部分写，异步信号安全
+static void WriteAll(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t rt = write(fd, buf, len);
+        if (rt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        buf += rt;
+        len -= rt;
+    }
+}
+
+MemoryRingLogAppender::MemoryRingLogAppender(size_t capacity, size_t slot_size, bool raw)
+    :m_capacity(capacity ? capacity : 1)
+    ,m_slotSize(slot_size ? slot_size : 1)
+    ,m_raw(raw)
+    ,m_pos(0) {
+    m_data = new char[m_capacity * m_slotSize];
+    m_dumpBuf = new char[m_slotSize];
+    m_lens = new std::atomic<uint32_t>[m_capacity];
+    m_seqs = new std::atomic<uint64_t>[m_capacity];
+    for (size_t i = 0; i < m_capacity; ++i) {
+        m_lens[i] = 0;
+        m_seqs[i] = 0;
+    }
+    RegisterRing(this);
+}
+
+MemoryRingLogAppender::~MemoryRingLogAppender() {
+    UnregisterRing(this);
+    delete[] m_seqs;
+    delete[] m_lens;
+    delete[] m_dumpBuf;
+    delete[] m_data;
+}
+
+void MemoryRingLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level < m_level) {
+        return;
+    }
+    std::string str;
+    if (m_raw) {
+        str = LogLevel::ToString(level);
+        str.append(1, ' ');
+        str.append(event->getContent());
+        str.append(1, '\n');
+    } else {
+        // 写槽位是无锁的，这里只在取formatter时加锁
+        str = getFormatter()->format(logger, level, event);
+    }
+
+    uint64_t pos = m_pos.fetch_add(1, std::memory_order_relaxed);
+    size_t idx = pos % m_capacity;
+    char* slot = m_data + idx * m_slotSize;
+    // 序号先置成奇数，dump 会跳过正在写的槽
+    m_seqs[idx].store(pos * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    size_t len = std::min(str.size(), m_slotSize);
+    memcpy(slot, str.c_str(), len);
+    if (len < str.size()) {
+        slot[len - 1] = '\n';   // 截断的也保证以换行结尾
+    }
+    m_lens[idx].store(len, std::memory_order_relaxed);
+    m_seqs[idx].store(pos * 2 + 2, std::memory_order_release);
+}
+
+void MemoryRingLogAppender::dump(int fd) const {
+    uint64_t pos = m_pos.load(std::memory_order_acquire);
+    uint64_t begin = pos > m_capacity ? pos - m_capacity : 0;
+    for (uint64_t i = begin; i < pos; ++i) {
+        size_t idx = i % m_capacity;
+        // 只要序号为 i 的那条写完的内容：先拷出来，拷完序号没变才输出
+        uint64_t seq = m_seqs[idx].load(std::memory_order_acquire);
+        if (seq != i * 2 + 2) {
+            continue;
+        }
+        uint32_t len = m_lens[idx].load(std::memory_order_relaxed);
+        memcpy(m_dumpBuf, m_data + idx * m_slotSize, len);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_seqs[idx].load(std::memory_order_relaxed) != seq) {
+            continue;
+        }
+        WriteAll(fd, m_dumpBuf, len);
+    }
+}
+
+void MemoryRingLogAppender::DumpAll(int fd) {
+    for (RingNode* n = s_rings.load(std::memory_order_acquire); n; n = n->next) {
+        MemoryRingLogAppender* ring = n->ring.load(std::memory_order_acquire);
+        if (ring) {
+            ring->dump(fd);
+        }
+    }
+}
+
+std::string MemoryRingLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "MemoryRingLogAppender";
+    node["capacity"] = m_capacity;
+    node["slot_size"] = m_slotSize;
+    node["raw"] = m_raw;
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+MmapFileLogAppender::MmapFileLogAppender(const std::string& filename, size_t segment_size,
+                                         SyncPolicy sync, uint32_t sync_ms)
+    :m_filename(filename)
+    ,m_segmentSize(segment_size < 4096 ? 4096 : segment_size)
+    ,m_sync(sync)
+    ,m_syncMs(sync_ms) {
+    // 找到最后一段，接着写
+    struct stat st;
+    if (stat(segmentName(0).c_str(), &st) == 0) {
+        uint32_t idx = 0;
+        while (stat(segmentName(idx + 1).c_str(), &st) == 0) {
+            ++idx;
+        }
+        openSegment(idx, true);
+    } else {
+        openSegment(0, false);
+    }
+}
+
+MmapFileLogAppender::~MmapFileLogAppender() {
+    closeSegment();
+}
+
+std::string MmapFileLogAppender::segmentName(uint32_t index) const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), ".%06u", index);
+    return m_filename + buf;
+}
+
+size_t MmapFileLogAppender::FindValidEnd(const char* data, size_t size) {
+    size_t end = size;
+    // 先按 8 字节跳过末尾大段的 0
+    while (end >= 8 && end % 8 == 0) {
+        uint64_t v;
+        memcpy(&v, data + end - 8, 8);
+        if (v) {
+            break;
+        }
+        end -= 8;
+    }
+    while (end > 0 && data[end - 1] == 0) {
+        --end;
+    }
+    // 崩溃时最后一条可能只拷了一半，退到最后一个完整行
+    while (end > 0 && data[end - 1] != '\n') {
+        --end;
+    }
+    return end;
+}
+
+bool MmapFileLogAppender::openSegment(uint32_t index, bool recover) {
+    std::string name = segmentName(index);
+    int fd = open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cout << "MmapFileLogAppender open file=" << name
+                  << " errno=" << errno << " errstr=" << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    size_t old_size = fstat(fd, &st) == 0 ? st.st_size : 0;
+    if (recover && old_size > m_segmentSize) {
+        // 段大小改小了，旧的一段不再续写，直接开新的一段
+        // 等于段大小的是崩溃时没截断的，照常找有效结尾
+        close(fd);
+        return openSegment(index + 1, false);
+    }
+    if (!recover && old_size) {
+        // 新段不应该有内容，防止覆盖
+        close(fd);
+        return openSegment(index + 1, false);
+    }
+
+    int rt = posix_fallocate(fd, 0, m_segmentSize);
+    if (rt != 0) {
+        // 空间没有真正分配，不能映射，这一段退回 pwrite
+        std::cout << "MmapFileLogAppender fallocate file=" << name
+                  << " size=" << m_segmentSize << " errstr=" << strerror(rt)
+                  << ", fall back to write" << std::endl;
+        if (recover && old_size) {
+            // 不知道有效结尾在哪，旧的一段不再续写
+            close(fd);
+            return openSegment(index + 1, false);
+        }
+        m_index = index;
+        m_fd = fd;
+        m_data = nullptr;
+        m_cursor = 0;
+        m_synced = 0;
+        m_lastSyncMs = GetCurrentMS();
+        return true;
+    }
+    void* p = mmap(nullptr, m_segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        std::cout << "MmapFileLogAppender mmap file=" << name
+                  << " errno=" << errno << " errstr=" << strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    m_index = index;
+    m_fd = fd;
+    m_data = (char*)p;
+    m_cursor = 0;
+    if (recover && old_size) {
+        m_cursor = FindValidEnd(m_data, old_size);
+        // 清掉半行，下次恢复时不会把它当成日志
+        memset(m_data + m_cursor, 0, old_size - m_cursor);
+    }
+    m_synced = m_cursor;
+    m_lastSyncMs = GetCurrentMS();
+    return true;
+}
+
+void MmapFileLogAppender::closeSegment() {
+    if (m_fd < 0) {
+        return;
+    }
+    if (m_sync != NONE) {
+        sync();
+    }
+    if (m_data) {
+        munmap(m_data, m_segmentSize);
+        m_data = nullptr;
+    }
+    // 正常关闭时截掉后面没用到的部分
+    if (ftruncate(m_fd, m_cursor) != 0) {
+        std::cout << "MmapFileLogAppender ftruncate file=" << segmentName(m_index)
+                  << " errno=" << errno << " errstr=" << strerror(errno) << std::endl;
+    }
+    close(m_fd);
+    m_fd = -1;
+}
+
+void MmapFileLogAppender::sync() {
+    if (m_fd < 0 || m_synced >= m_cursor) {
+        return;
+    }
+    if (m_data) {
+        // msync 的地址要按页对齐
+        static const size_t s_page_size = sysconf(_SC_PAGESIZE);
+        size_t start = m_synced / s_page_size * s_page_size;
+        msync(m_data + start, m_cursor - start, MS_SYNC);
+    } else {
+        fdatasync(m_fd);
+    }
+    m_synced = m_cursor;
+    m_lastSyncMs = GetCurrentMS();
+}
+
+void MmapFileLogAppender::flush() {
+    MutexType::Lock lock(m_mutex);
+    sync();
+}
+
+void MmapFileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level < m_level) {
+        return;
+    }
+    MutexType::Lock lock(m_mutex);
+    if (m_fd < 0) {
+        ++m_dropped;
+        return;
+    }
+    std::string str = m_formatter->format(logger, level, event);
+    if (str.empty()) {
+        return;
+    }
+    // 0 用来判断有效结尾，不能出现在日志里
+    if (memchr(str.c_str(), 0, str.size())) {
+        std::replace(str.begin(), str.end(), '\0', ' ');
+    }
+    if (str.back() != '\n') {
+        str.push_back('\n');
+    }
+    if (str.size() > m_segmentSize) {
+        str.resize(m_segmentSize);
+        str.back() = '\n';
+    }
+    if (m_cursor + str.size() > m_segmentSize) {
+        closeSegment();
+        if (!openSegment(m_index + 1, false)) {
+            ++m_dropped;
+            return;
+        }
+    }
+    if (m_data) {
+        memcpy(m_data + m_cursor, str.c_str(), str.size());
+    } else if (pwrite(m_fd, str.c_str(), str.size(), m_cursor) != (ssize_t)str.size()) {
+        // 写了一半的也不要，下次从同一个位置覆盖
+        ++m_dropped;
+        return;
+    }
+    m_cursor += str.size();
+
+    if ((m_sync == ERROR && level >= LogLevel::ERROR)
+            || (m_sync == PERIODIC && GetCurrentMS() - m_lastSyncMs >= m_syncMs)) {
+        sync();
+    }
+}
+
+MmapFileLogAppender::SyncPolicy MmapFileLogAppender::SyncPolicyFromString(const std::string& str) {
+    if (str == "error") {
+        return ERROR;
+    } else if (str == "periodic") {
+        return PERIODIC;
+    }
+    return NONE;
+}
+
+const char* MmapFileLogAppender::SyncPolicyToString(SyncPolicy v) {
+    switch (v) {
+        case ERROR:
+            return "error";
+        case PERIODIC:
+            return "periodic";
+        default:
+            return "none";
+    }
+}
+
+std::string MmapFileLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "MmapFileLogAppender";
+    node["file"] = m_filename;
+    node["segment_size"] = m_segmentSize;
+    node["sync"] = SyncPolicyToString(m_sync);
+    node["sync_ms"] = m_syncMs;
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+// 日志级别转 syslog 的 severity
+static int ToSyslogSeverity(LogLevel::Level level) {
+    switch (level) {
+        case LogLevel::DEBUG:
+            return 7;
+        case LogLevel::INFO:
+            return 6;
+        case LogLevel::WARN:
+            return 4;
+        case LogLevel::ERROR:
+            return 3;
+        case LogLevel::FATAL:
+            return 2;
+        default:
+            return 5;
+    }
+}
+
+// RFC 5424 的头部字段只能是可见 ASCII，不能有空格，空的用 "-"
+static void AppendSyslogToken(std::string& out, const std::string& str, size_t max_len) {
+    if (str.empty()) {
+        out.push_back('-');
+        return;
+    }
+    for (size_t i = 0; i < str.size() && i < max_len; ++i) {
+        char c = str[i];
+        out.push_back((c > 32 && c < 127) ? c : '_');
+    }
+}
+
+SyslogLogAppender::SyslogLogAppender(const std::string& ident, int facility, const std::string& path)
+    :m_ident(ident)
+    ,m_facility(facility >= 0 && facility < 24 ? facility : 1)
+    ,m_path(path)
+    ,m_dropped(0) {
+    char host[256] = {0};
+    if (gethostname(host, sizeof(host) - 1) == 0) {
+        m_hostname = host;
+    }
+    // 时间、级别都在头部里了，消息只要内容
+    setFormatter(LogFormatter::ptr(new LogFormatter("%m")));
+    connect();
+}
+
+SyslogLogAppender::~SyslogLogAppender() {
+    if (m_sock >= 0) {
+        close(m_sock);
+    }
+}
+
+bool SyslogLogAppender::connect() {
+    if (m_sock >= 0) {
+        close(m_sock);
+        m_sock = -1;
+    }
+    if (m_path.size() >= sizeof(((sockaddr_un*)0)->sun_path)) {
+        return false;
+    }
+    int sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return false;
+    }
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, m_path.c_str(), m_path.size());
+    if (::connect(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        return false;
+    }
+    m_sock = sock;
+    return true;
+}
+
+int SyslogLogAppender::FacilityFromString(const std::string& str) {
+    if (str == "user") {
+        return 1;
+    } else if (str == "daemon") {
+        return 3;
+    } else if (str.size() == 6 && str.compare(0, 5, "local") == 0
+            && str[5] >= '0' && str[5] <= '7') {
+        return 16 + str[5] - '0';
+    }
+    char* end = nullptr;
+    long v = strtol(str.c_str(), &end, 10);
+    if (str.empty() || *end || v < 0 || v >= 24) {
+        return -1;
+    }
+    return v;
+}
+
+void SyslogLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level < m_level) {
+        return;
+    }
+    MutexType::Lock lock(m_mutex);
+    // <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID [SD] MSG
+    std::string out;
+    out.reserve(256);
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "<%d>1 ", m_facility * 8 + ToSyslogSeverity(level));
+    out.append(buf, len);
+
+    struct tm tm;
+    time_t t = event->getTime();
+    localtime_r(&t, &tm);
+    len = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S%z", &tm);
+    // %z 是 +0800，RFC 5424 要 +08:00
+    if (len >= 5) {
+        out.append(buf, len - 2);
+        out.push_back(':');
+        out.append(buf + len - 2, 2);
+    } else {
+        out.push_back('-');
+    }
+    out.push_back(' ');
+    AppendSyslogToken(out, m_hostname, 255);
+    out.push_back(' ');
+    AppendSyslogToken(out, m_ident, 48);
+    out.push_back(' ');
+    len = snprintf(buf, sizeof(buf), "%d ", (int)getpid());
+    out.append(buf, len);
+    AppendSyslogToken(out, logger->getName(), 32);
+    out.push_back(' ');
+
+    // 日志上下文放到 STRUCTURED-DATA，32473 是 RFC 5612 给文档示例保留的企业号
+    const LogContext::ptr& ctx = event->getContext();
+    if (ctx && !ctx->empty()) {
+        out.append("[ctx@32473");
+        for (auto& i : *ctx) {
+            out.push_back(' ');
+            for (size_t j = 0; j < i.first.size() && j < 32; ++j) {
+                char c = i.first[j];
+                out.push_back((c > 32 && c < 127 && c != '=' && c != ']' && c != '"') ? c : '_');
+            }
+            out.append("=\"");
+            for (char c : i.second) {
+                if (c == '"' || c == '\\' || c == ']') {
+                    out.push_back('\\');
+                }
+                out.push_back(c);
+            }
+            out.push_back('"');
+        }
+        out.push_back(']');
+    } else {
+        out.push_back('-');
+    }
+
+    std::string msg = m_formatter->format(logger, level, event);
+    while (!msg.empty() && msg.back() == '\n') {
+        msg.pop_back();
+    }
+    if (!msg.empty()) {
+        out.push_back(' ');
+        out.append(msg);
+    }
+
+    if (m_sock < 0 && !connect()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ssize_t rt = ::send(m_sock, out.c_str(), out.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (rt < 0 && (errno == ECONNREFUSED || errno == ENOTCONN)) {
+        // syslog 重启过，重连一次
+        if (connect()) {
+            rt = ::send(m_sock, out.c_str(), out.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        }
+    }
+    if (rt < 0) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::string SyslogLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "SyslogLogAppender";
+    node["ident"] = m_ident;
+    node["facility"] = m_facility;
+    node["path"] = m_path;
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+UdpLogAppender::UdpLogAppender(const std::string& host, uint16_t port, size_t mtu, uint32_t flush_ms)
+    :m_host(host)
+    ,m_port(port)
+    ,m_mtu(mtu < 64 ? 64 : (mtu > 65507 ? 65507 : mtu))
+    ,m_flushMs(flush_ms)
+    ,m_dropped(0)
+    ,m_sent(0)
+    ,m_datagrams(0) {
+    addrinfo hints, *res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &res) != 0) {
+        std::cout << "UdpLogAppender getaddrinfo host=" << host << " port=" << port
+                  << " fail" << std::endl;
+        return;
+    }
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        int sock = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (sock < 0) {
+            continue;
+        }
+        if (::connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+            m_sock = sock;
+            break;
+        }
+        close(sock);
+    }
+    freeaddrinfo(res);
+    m_buf.reserve(m_mtu);
+#ifndef SYLAR_SINGLE_THREAD
+    if (m_sock >= 0 && m_flushMs) {
+        m_thread.reset(new Thread(std::bind(&UdpLogAppender::flushLoop, this), "log_udp"));
+    }
+#endif
+}
+
+UdpLogAppender::~UdpLogAppender() {
+    if (m_thread) {
+        {
+            Mutex::Lock lock(m_stopMutex);
+            m_stop = true;
+        }
+        m_stopCond.notify_one();
+        m_thread->join();
+    }
+    send();
+    if (m_sock >= 0) {
+        close(m_sock);
+    }
+}
+
+void UdpLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level < m_level) {
+        return;
+    }
+    MutexType::Lock lock(m_mutex);
+    std::string msg = m_formatter->format(logger, level, event);
+    if (msg.empty() || msg.back() != '\n') {
+        msg.push_back('\n');
+    }
+    if (msg.size() > m_mtu) {
+        msg.resize(m_mtu);
+        msg.back() = '\n';
+    }
+
+    uint64_t now = GetCurrentMS();
+    if (!m_buf.empty() && m_buf.size() + msg.size() > m_mtu) {
+        send();
+    }
+    if (m_buf.empty()) {
+        m_bufFirstMs = now;
+    }
+    m_buf.append(msg);
+    ++m_bufCount;
+    if (m_buf.size() >= m_mtu || now - m_bufFirstMs >= m_flushMs) {
+        send();
+    }
+}
+
+void UdpLogAppender::flush() {
+    MutexType::Lock lock(m_mutex);
+    send();
+}
+
+void UdpLogAppender::flushLoop() {
+    std::unique_lock<Mutex> lock(m_stopMutex);
+    while (!m_stop) {
+        m_stopCond.wait_for(lock, std::chrono::milliseconds(m_flushMs), [this]() { return m_stop;});
+        lock.unlock();
+        {
+            MutexType::Lock block(m_mutex);
+            if (!m_buf.empty() && GetCurrentMS() - m_bufFirstMs >= m_flushMs) {
+                send();
+            }
+        }
+        lock.lock();
+    }
+}
+
+void UdpLogAppender::send() {
+    if (m_buf.empty()) {
+        return;
+    }
+    ssize_t rt = -1;
+    if (m_sock >= 0) {
+        rt = ::send(m_sock, m_buf.c_str(), m_buf.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+    if (rt < 0) {
+        m_dropped.fetch_add(m_bufCount, std::memory_order_relaxed);
+    } else {
+        m_sent.fetch_add(m_bufCount, std::memory_order_relaxed);
+        m_datagrams.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_buf.clear();
+    m_bufCount = 0;
+}
+
+std::string UdpLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "UdpLogAppender";
+    node["host"] = m_host;
+    node["port"] = m_port;
+    node["mtu"] = m_mtu;
+    node["flush_ms"] = m_flushMs;
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+LogFormatter::LogFormatter(const std::string& pattern) 
+    :m_pattern(pattern) {
+    init();
+}
+
+std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    uint64_t begin = LogMetrics::IsEnabled() ? GetMonotonicNS() : 0;
+    std::stringstream ss;
+    for (auto& i : m_items) {
+        i->format(ss, logger, level, event);   // 输出事件到接收流
+    }
+    std::string str = ss.str();
+    AddFormatStat(begin, str.size());
+    return str;
+}
+
+// 做日志格式解析
+// 格式可能为 %xxx(%后直接跟格式) 和 %xxx{xxx}(格式里还套了格式，第一个xxx格式称为str，第二个xxx称为format），
 // 但也可能就是要输出 %，即转义 %%，则需要判断
 void LogFormatter::init() {  
     // str, format, type    
@@ -379,6 +2011,7 @@ void LogFormatter::init() {
             i = n - 1;
         }else if (fmt_status == 1) {    // 只找到 { 没有找到 } 括号，是错误的情况
             std::cout << "pattern parse error: " << m_pattern << " - " << m_pattern.substr(i) << std::endl;
+            m_error = true;
             vec.push_back(std::make_tuple("<<pattern_error>>", fmt, 0));    // 0表异常状态
         }
         // else if (fmt_status == 2) {    // 找到了 {} ，正常情况
@@ -404,12 +2037,15 @@ void LogFormatter::init() {
         XX(r, ElapseFormatItem),
         XX(c, NameFormatItem),
         XX(t, ThreadIdFormatItem),
+        XX(N, ThreadNameFormatItem),
         XX(n, NewLineFormatItem),
         XX(d, DateTimeFormatItem),
         XX(f, FilenameFormatItem),
         XX(l, LineFormatItem),
         XX(T, TabFormatItem),
         XX(F, FiberIdFormatItem),
+        XX(K, KeyValueFormatItem),
+        XX(X, ContextFormatItem),
 #undef XX
     /** 仿照log4j格式：
     * 如果使用pattern布局就要指定的打印信息的具体格式ConversionPattern，打印参数如下：
@@ -423,7 +2059,9 @@ void LogFormatter::init() {
     * %l 输出日志事件的发生位置，及在代码中的行数；
     * %f 输出文件名  
     * %T 输出tab符号    
+    * %N 输出线程名称
     * %F 输出协程号id
+    * %K 输出结构化字段 key=value
     **/
     };
 
@@ -437,6 +2075,7 @@ void LogFormatter::init() {
             if (it == s_format_items.end()) {
                 // 说明错误格式，因为找到第一个XXX就已经到尾端了，没有第二个{XXX}
                 m_items.push_back(FormatItem::ptr(new StringFormatItem("error_format %" + std::get<0>(i) + ">>")));
+                m_error = true;
             } else {
                 m_items.push_back(it->second(std::get<1>(i)));
             }
@@ -448,15 +2087,818 @@ void LogFormatter::init() {
 
     }
 
+LogFormatter::ptr LogFormatter::Create(const std::string& pattern) {
+    if (pattern == "json") {
+        return LogFormatter::ptr(new JsonLogFormatter);
+    }
+    return LogFormatter::ptr(new LogFormatter(pattern));
+}
+
+// 追加JSON字符串（带引号），按RFC 8259转义，UTF-8原样输出
+static void AppendJsonString(std::string& out, const char* str, size_t len) {
+    static const char* s_hex = "0123456789abcdef";
+    out.push_back('"');
+    const char* begin = str;    // 连续不需要转义的一段，一次性append
+    const char* end = str + len;
+    for (const char* p = str; p < end; ++p) {
+        unsigned char c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(begin, p - begin);
+        begin = p + 1;
+        switch (c) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            default:
+                out.append("\\u00");
+                out.push_back(s_hex[c >> 4]);
+                out.push_back(s_hex[c & 0xf]);
+                break;
+        }
+    }
+    out.append(begin, end - begin);
+    out.push_back('"');
+}
+
+static void AppendJsonKey(std::string& out, const char* key) {
+    AppendJsonString(out, key, strlen(key));
+    out.push_back(':');
+}
+
+static void AppendJsonUint(std::string& out, uint64_t v) {
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%lu", (unsigned long)v);
+    out.append(buf, len);
+}
+
+static void AppendJsonInt(std::string& out, int64_t v) {
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%ld", (long)v);
+    out.append(buf, len);
+}
+
+static void AppendJsonDouble(std::string& out, double v) {
+    // JSON没有NaN和Inf
+    if (v != v || v > 1.7976931348623157e308 || v < -1.7976931348623157e308) {
+        out.append("null");
+        return;
+    }
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%.17g", v);
+    out.append(buf, len);
+}
+
+JsonLogFormatter::JsonLogFormatter()
+    :LogFormatter("json") {
+}
+
+std::string JsonLogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    uint64_t begin = LogMetrics::IsEnabled() ? GetMonotonicNS() : 0;
+    std::string out;
+    out.reserve(256);
+
+    struct tm tm;
+    time_t t = event->getTime();
+    localtime_r(&t, &tm);
+    char buf[64];
+    size_t len = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+
+    out.push_back('{');
+    AppendJsonKey(out, "time");
+    AppendJsonString(out, buf, len);
+    out.push_back(',');
+    AppendJsonKey(out, "level");
+    AppendJsonString(out, LogLevel::ToString(level), strlen(LogLevel::ToString(level)));
+    out.push_back(',');
+    AppendJsonKey(out, "logger");
+    AppendJsonString(out, logger->getName().c_str(), logger->getName().size());
+    out.push_back(',');
+    AppendJsonKey(out, "thread");
+    AppendJsonUint(out, event->getThreadId());
+    out.push_back(',');
+    AppendJsonKey(out, "thread_name");
+    AppendJsonString(out, event->getThreadName().c_str(), event->getThreadName().size());
+    out.push_back(',');
+    AppendJsonKey(out, "fiber");
+    AppendJsonUint(out, event->getFiberId());
+    out.push_back(',');
+    AppendJsonKey(out, "file");
+    AppendJsonString(out, event->getFile(), strlen(event->getFile()));
+    out.push_back(',');
+    AppendJsonKey(out, "line");
+    AppendJsonInt(out, event->getLine());
+    out.push_back(',');
+    AppendJsonKey(out, "msg");
+    std::string content = event->getContent();
+    AppendJsonString(out, content.c_str(), content.size());
+
+    const LogContext::ptr& ctx = event->getContext();
+    if (ctx) {
+        out.push_back(',');
+        AppendJsonKey(out, "context");
+        out.push_back('{');
+        bool first = true;
+        for (auto& i : *ctx) {
+            if (!first) {
+                out.push_back(',');
+            }
+            first = false;
+            AppendJsonKey(out, i.first.c_str());
+            AppendJsonString(out, i.second.c_str(), i.second.size());
+        }
+        out.push_back('}');
+    }
+
+    if (event->getFieldCount()) {
+        out.push_back(',');
+        AppendJsonKey(out, "fields");
+        out.push_back('{');
+        for (size_t i = 0; i < event->getFieldCount(); ++i) {
+            const LogField& f = event->getField(i);
+            if (i) {
+                out.push_back(',');
+            }
+            AppendJsonKey(out, f.key);
+            switch (f.type) {
+                case LogField::INT:
+                    AppendJsonInt(out, f.i);
+                    break;
+                case LogField::UINT:
+                    AppendJsonUint(out, f.u);
+                    break;
+                case LogField::DOUBLE:
+                    AppendJsonDouble(out, f.d);
+                    break;
+                case LogField::BOOL:
+                    out.append(f.b ? "true" : "false");
+                    break;
+                case LogField::STRING:
+                    AppendJsonString(out, f.str.ptr, f.str.len);
+                    break;
+            }
+        }
+        out.push_back('}');
+    }
+    out.append("}\n");
+    AddFormatStat(begin, out.size());
+    return out;
+}
+
 LoggerManager::LoggerManager() {
     m_root.reset(new Logger);
     m_root->addAppender(LogAppender::ptr(new StdoutLogAppender));   // 默认appender
+
+    m_loggers[m_root->m_name] = m_root;
 }
 
 Logger::ptr LoggerManager::getLogger(const std::string& name) {
+    DefaultMutex::Lock lock(m_mutex);
     auto it = m_loggers.find(name);
-    return it == m_loggers.end() ? m_root : it->second;
+    if (it != m_loggers.end()) {
+        return it->second;
+    }
+
+    // 按需创建，从最短的前缀开始，保证父日志器都存在
+    Logger::ptr parent = m_root;
+    size_t pos = name.find('.', 1);
+    while (true) {
+        std::string sub = pos == std::string::npos ? name : name.substr(0, pos);
+        it = m_loggers.find(sub);
+        if (it != m_loggers.end()) {
+            parent = it->second;
+        } else {
+            Logger::ptr logger(new Logger(sub));
+            logger->m_parent = parent;
+            {
+                Logger::MutexType::Lock ll(parent->m_mutex);
+                parent->m_children.push_back(logger.get());
+            }
+            logger->setLevel(LogLevel::UNKNOW);     // 默认继承父日志器的级别
+            m_loggers[sub] = logger;
+            parent = logger;
+        }
+        if (pos == std::string::npos) {
+            break;
+        }
+        pos = name.find('.', pos + 1);
+    }
+    return parent;
+}
+
+std::string LoggerManager::toYamlString() {
+    DefaultMutex::Lock lock(m_mutex);
+    YAML::Node node;
+    for (auto& i : m_loggers) {
+        node.push_back(YAML::Load(i.second->toYamlString()));
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+void LoggerManager::flush() {
+    DefaultMutex::Lock lock(m_mutex);
+    for (auto& i : m_loggers) {
+        i.second->flush();
+    }
+}
+
+void LoggerManager::reopen() {
+    DefaultMutex::Lock lock(m_mutex);
+    for (auto& i : m_loggers) {
+        i.second->reopen();
+    }
+}
+
+static void MetricsToYaml(YAML::Node& node, const LogMetrics::Snapshot& s) {
+    node["events"] = s.getEvents();
+    for (int i = LogLevel::DEBUG; i < LogMetrics::kLevels; ++i) {
+        if (s.events[i]) {
+            node["levels"][LogLevel::ToString((LogLevel::Level)i)] = s.events[i];
+        }
+    }
+    node["bytes"] = s.bytes;
+    node["drops"] = s.drops;
+    node["format_ns"] = s.format_ns;
+    node["write_ns"] = s.write_ns;
+    node["write_p50_ns"] = s.getWritePercentile(0.5);
+    node["write_p99_ns"] = s.getWritePercentile(0.99);
+    node["write_p999_ns"] = s.getWritePercentile(0.999);
+}
+
+// appender 的类名，去掉命名空间
+static std::string AppenderTypeName(const LogAppender& appender) {
+    int status = 0;
+    char* name = abi::__cxa_demangle(typeid(appender).name(), nullptr, nullptr, &status);
+    std::string str = name ? name : typeid(appender).name();
+    free(name);
+    size_t pos = str.rfind("::");
+    return pos == std::string::npos ? str : str.substr(pos + 2);
+}
+
+std::string LoggerManager::getMetricsString() {
+    YAML::Node root(YAML::NodeType::Sequence);
+    DefaultMutex::Lock lock(m_mutex);
+    for (auto& i : m_loggers) {
+        LogMetrics::Snapshot s = i.second->getMetrics();
+        if (!s.getEvents() && !s.drops) {
+            continue;
+        }
+        YAML::Node node;
+        node["name"] = i.first;
+        MetricsToYaml(node, s);
+        Logger::AppenderList appenders = i.second->getAppenders();
+        for (auto& a : *appenders) {
+            YAML::Node anode;
+            anode["type"] = AppenderTypeName(*a);
+            FileLogAppender* file = dynamic_cast<FileLogAppender*>(a.get());
+            if (file) {
+                anode["file"] = file->getFilename();
+            }
+            MetricsToYaml(anode, a->getMetrics());
+            node["appenders"].push_back(anode);
+        }
+        root.push_back(node);
+    }
+    std::stringstream ss;
+    ss << root;
+    return ss.str();
 }
 
+// 配置文件中 logs 下每个 appender 的定义
+// FileLogAppender 的 flush_ms 默认值，和 Udp 的不一样
+static const uint32_t s_file_flush_ms = 1000;
+
+struct LogAppenderDefine {
+    int type = 0;   // 1 File, 2 Stdout, 3 Null, 4 MemoryRing, 5 Syslog, 6 Udp, 7 UringFile, 8 MmapFile
+    LogLevel::Level level = LogLevel::UNKNOW;
+    std::string formatter;
+    std::string file;
+    size_t capacity = 1024;     // MemoryRing 的条数
+    size_t slot_size = 256;     // MemoryRing 每条的最大长度
+    bool raw = false;           // MemoryRing 是否跳过formatter
+    std::string ident = "sylar";    // Syslog 的 APP-NAME
+    int facility = 1;               // Syslog 的设施号，默认 user
+    std::string path = "/dev/log";  // Syslog 的套接字路径
+    std::string host;               // Udp 收集端地址
+    uint16_t port = 0;              // Udp 收集端端口
+    size_t mtu = 1472;              // Udp 一个数据报最大字节数
+    uint32_t flush_ms = 100;        // Udp 攒批最长时间；File 压缩模式下也用，File 默认 1000
+    size_t buffer_size = 256 * 1024;    // UringFile 每块缓冲的大小
+    std::string compress = "none";  // File 的压缩算法 none/zstd/lz4/gzip
+    int compress_level = 0;         // File 的压缩级别，0 为默认
+    size_t flush_bytes = 256 * 1024;        // File 压缩模式下攒够多少字节压一帧
+    size_t max_pending = 8 * 1024 * 1024;   // File 压缩模式下缓冲的上限
+    size_t segment_size = 64 * 1024 * 1024; // MmapFile 每段的大小
+    std::string sync = "none";      // MmapFile 持久化策略 none/error/periodic
+    uint32_t sync_ms = 1000;        // MmapFile periodic 的间隔
+
+    bool operator==(const LogAppenderDefine& oth) const {
+        return type == oth.type
+            && level == oth.level
+            && formatter == oth.formatter
+            && file == oth.file
+            && capacity == oth.capacity
+            && slot_size == oth.slot_size
+            && raw == oth.raw
+            && ident == oth.ident
+            && facility == oth.facility
+            && path == oth.path
+            && host == oth.host
+            && port == oth.port
+            && mtu == oth.mtu
+            && flush_ms == oth.flush_ms
+            && buffer_size == oth.buffer_size
+            && compress == oth.compress
+            && compress_level == oth.compress_level
+            && flush_bytes == oth.flush_bytes
+            && max_pending == oth.max_pending
+            && segment_size == oth.segment_size
+            && sync == oth.sync
+            && sync_ms == oth.sync_ms;
+    }
+};
+
+// 配置文件中 logs 下每个 logger 的定义
+struct LogDefine {
+    std::string name;
+    LogLevel::Level level = LogLevel::UNKNOW;
+    std::string formatter;
+    std::vector<LogAppenderDefine> appenders;
+    double rate = 0;        // 令牌桶每秒条数，0 不限流
+    uint64_t burst = 0;     // 令牌桶突发条数，0 时取 rate
+    bool additivity = false;
+
+    bool operator==(const LogDefine& oth) const {
+        return name == oth.name
+            && level == oth.level
+            && additivity == oth.additivity
+            && formatter == oth.formatter
+            && appenders == oth.appenders
+            && rate == oth.rate
+            && burst == oth.burst;
+    }
+
+    // 放进 std::set 里，按名字排序去重
+    bool operator<(const LogDefine& oth) const {
+        return name < oth.name;
+    }
+};
+
+// YAML string 转 LogDefine
+template<>
+class LexicalCast<std::string, LogDefine>
+{
+public:
+    LogDefine operator()(const std::string& v) {
+        YAML::Node n = YAML::Load(v);
+        LogDefine ld;
+        if (!n["name"].IsDefined()) {
+            std::cout << "log config error: name is null, " << n << std::endl;
+            throw std::logic_error("log config name is null");
+        }
+        ld.name = n["name"].as<std::string>();
+        ld.level = LogLevel::FromString(n["level"].IsDefined() ? n["level"].as<std::string>() : "");
+        if (n["formatter"].IsDefined()) {
+            ld.formatter = n["formatter"].as<std::string>();
+        }
+        if (n["additivity"].IsDefined()) {
+            ld.additivity = n["additivity"].as<bool>();
+        }
+        if (n["rate_limit"].IsDefined()) {
+            auto r = n["rate_limit"];
+            if (r["rate"].IsDefined()) {
+                ld.rate = r["rate"].as<double>();
+            }
+            if (r["burst"].IsDefined()) {
+                ld.burst = r["burst"].as<uint64_t>();
+            }
+        }
+
+        if (n["appenders"].IsDefined()) {
+            for (size_t x = 0; x < n["appenders"].size(); ++x) {
+                auto a = n["appenders"][x];
+                if (!a["type"].IsDefined()) {
+                    std::cout << "log config error: appender type is null, " << a << std::endl;
+                    continue;
+                }
+                std::string type = a["type"].as<std::string>();
+                LogAppenderDefine lad;
+                if (type == "FileLogAppender") {
+                    lad.type = 1;
+                    if (!a["file"].IsDefined()) {
+                        std::cout << "log config error: fileappender file is null, " << a << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if (a["compress"].IsDefined()) {
+                        lad.compress = a["compress"].as<std::string>();
+                    }
+                    if (a["compress_level"].IsDefined()) {
+                        lad.compress_level = a["compress_level"].as<int>();
+                    }
+                    if (a["flush_bytes"].IsDefined()) {
+                        lad.flush_bytes = a["flush_bytes"].as<size_t>();
+                    }
+                    lad.flush_ms = s_file_flush_ms;
+                    if (a["flush_ms"].IsDefined()) {
+                        lad.flush_ms = a["flush_ms"].as<uint32_t>();
+                    }
+                    if (a["max_pending"].IsDefined()) {
+                        lad.max_pending = a["max_pending"].as<size_t>();
+                    }
+                } else if (type == "StdoutLogAppender") {
+                    lad.type = 2;
+                } else if (type == "NullLogAppender") {
+                    lad.type = 3;
+                } else if (type == "MemoryRingLogAppender") {
+                    lad.type = 4;
+                    if (a["capacity"].IsDefined()) {
+                        lad.capacity = a["capacity"].as<size_t>();
+                    }
+                    if (a["slot_size"].IsDefined()) {
+                        lad.slot_size = a["slot_size"].as<size_t>();
+                    }
+                    if (a["raw"].IsDefined()) {
+                        lad.raw = a["raw"].as<bool>();
+                    }
+                } else if (type == "UringFileLogAppender") {
+                    lad.type = 7;
+                    if (!a["file"].IsDefined()) {
+                        std::cout << "log config error: uringfileappender file is null, " << a << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if (a["buffer_size"].IsDefined()) {
+                        lad.buffer_size = a["buffer_size"].as<size_t>();
+                    }
+                } else if (type == "MmapFileLogAppender") {
+                    lad.type = 8;
+                    if (!a["file"].IsDefined()) {
+                        std::cout << "log config error: mmapfileappender file is null, " << a << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if (a["segment_size"].IsDefined()) {
+                        lad.segment_size = a["segment_size"].as<size_t>();
+                    }
+                    if (a["sync"].IsDefined()) {
+                        lad.sync = a["sync"].as<std::string>();
+                    }
+                    if (a["sync_ms"].IsDefined()) {
+                        lad.sync_ms = a["sync_ms"].as<uint32_t>();
+                    }
+                } else if (type == "SyslogLogAppender") {
+                    lad.type = 5;
+                    if (a["ident"].IsDefined()) {
+                        lad.ident = a["ident"].as<std::string>();
+                    }
+                    if (a["facility"].IsDefined()) {
+                        lad.facility = SyslogLogAppender::FacilityFromString(a["facility"].as<std::string>());
+                        if (lad.facility < 0) {
+                            std::cout << "log config error: syslog facility is invalid, " << a << std::endl;
+                            continue;
+                        }
+                    }
+                    if (a["path"].IsDefined()) {
+                        lad.path = a["path"].as<std::string>();
+                    }
+                } else if (type == "UdpLogAppender") {
+                    lad.type = 6;
+                    if (!a["host"].IsDefined() || !a["port"].IsDefined()) {
+                        std::cout << "log config error: udpappender host or port is null, " << a << std::endl;
+                        continue;
+                    }
+                    lad.host = a["host"].as<std::string>();
+                    lad.port = a["port"].as<uint16_t>();
+                    if (a["mtu"].IsDefined()) {
+                        lad.mtu = a["mtu"].as<size_t>();
+                    }
+                    if (a["flush_ms"].IsDefined()) {
+                        lad.flush_ms = a["flush_ms"].as<uint32_t>();
+                    }
+                } else {
+                    std::cout << "log config error: appender type is invalid, " << a << std::endl;
+                    continue;
+                }
+                if (a["level"].IsDefined()) {
+                    lad.level = LogLevel::FromString(a["level"].as<std::string>());
+                }
+                if (a["formatter"].IsDefined()) {
+                    lad.formatter = a["formatter"].as<std::string>();
+                }
+                ld.appenders.push_back(lad);
+            }
+        }
+        return ld;
+    }
+};
+
+// LogDefine 转 YAML string
+template<>
+class LexicalCast<LogDefine, std::string>
+{
+public:
+    std::string operator()(const LogDefine& i) {
+        YAML::Node n;
+        n["name"] = i.name;
+        if (i.level != LogLevel::UNKNOW) {
+            n["level"] = LogLevel::ToString(i.level);
+        }
+        if (!i.formatter.empty()) {
+            n["formatter"] = i.formatter;
+        }
+        if (i.additivity) {
+            n["additivity"] = true;
+        }
+        if (i.rate > 0) {
+            n["rate_limit"]["rate"] = i.rate;
+            if (i.burst) {
+                n["rate_limit"]["burst"] = i.burst;
+            }
+        }
+
+        for (auto& a : i.appenders) {
+            YAML::Node na;
+            if (a.type == 1) {
+                na["type"] = "FileLogAppender";
+                na["file"] = a.file;
+                if (a.compress != "none") {
+                    na["compress"] = a.compress;
+                }
+                if (a.compress_level) {
+                    na["compress_level"] = a.compress_level;
+                }
+                if (a.flush_bytes != LogAppenderDefine().flush_bytes) {
+                    na["flush_bytes"] = a.flush_bytes;
+                }
+                if (a.flush_ms != s_file_flush_ms) {
+                    na["flush_ms"] = a.flush_ms;
+                }
+                if (a.max_pending != LogAppenderDefine().max_pending) {
+                    na["max_pending"] = a.max_pending;
+                }
+            } else if (a.type == 2) {
+                na["type"] = "StdoutLogAppender";
+            } else if (a.type == 3) {
+                na["type"] = "NullLogAppender";
+            } else if (a.type == 4) {
+                na["type"] = "MemoryRingLogAppender";
+                na["capacity"] = a.capacity;
+                na["slot_size"] = a.slot_size;
+                na["raw"] = a.raw;
+            } else if (a.type == 7) {
+                na["type"] = "UringFileLogAppender";
+                na["file"] = a.file;
+                na["buffer_size"] = a.buffer_size;
+            } else if (a.type == 8) {
+                na["type"] = "MmapFileLogAppender";
+                na["file"] = a.file;
+                na["segment_size"] = a.segment_size;
+                na["sync"] = a.sync;
+                na["sync_ms"] = a.sync_ms;
+            } else if (a.type == 5) {
+                na["type"] = "SyslogLogAppender";
+                na["ident"] = a.ident;
+                na["facility"] = a.facility;
+                na["path"] = a.path;
+            } else if (a.type == 6) {
+                na["type"] = "UdpLogAppender";
+                na["host"] = a.host;
+                na["port"] = a.port;
+                na["mtu"] = a.mtu;
+                na["flush_ms"] = a.flush_ms;
+            }
+            if (a.level != LogLevel::UNKNOW) {
+                na["level"] = LogLevel::ToString(a.level);
+            }
+            if (!a.formatter.empty()) {
+                na["formatter"] = a.formatter;
+            }
+            n["appenders"].push_back(na);
+        }
+        std::stringstream ss;
+        ss << n;
+        return ss.str();
+    }
+};
+
+sylar::ConfigVar<std::set<LogDefine> >::ptr g_log_defines =
+    sylar::Config::Lookup("logs", std::set<LogDefine>(), "logs config");
 
-}
\ No newline at end of file
+static sylar::ConfigVar<bool>::ptr g_log_metrics_enable =
+    sylar::Config::Lookup("log.metrics.enable", false, "count log events, bytes and latency per logger and appender");
+
+static sylar::ConfigVar<uint32_t>::ptr g_log_metrics_dump_interval =
+    sylar::Config::Lookup("log.metrics.dump_interval", (uint32_t)0, "dump log metrics every N seconds, 0 to disable");
+
+static sylar::ConfigVar<std::string>::ptr g_log_metrics_dump_logger =
+    sylar::Config::Lookup("log.metrics.dump_logger", std::string("log_metrics"), "logger that log metrics are dumped to");
+
+// 每隔 log.metrics.dump_interval 秒把开销统计输出到 log.metrics.dump_logger
+// 间隔改成 0 时线程退出，默认不启动线程
+class LogMetricsDumper
+{
+public:
+    // 不析构：进程退出时后台线程可能还在用
+    static LogMetricsDumper* GetInstance() {
+        static LogMetricsDumper* s_dumper = new LogMetricsDumper;
+        return s_dumper;
+    }
+
+    void setInterval(uint32_t sec) {
+#ifdef SYLAR_SINGLE_THREAD
+        // 单线程构建的锁是空操作，后台线程读统计、写日志都会和业务线程竞争
+        if (sec) {
+            std::cout << "log.metrics.dump_interval=" << sec
+                      << " ignored: SYLAR_SINGLE_THREAD build has no background dump thread" << std::endl;
+        }
+        return;
+#endif
+        Thread::ptr old;
+        {
+            Mutex::Lock lock(m_mutex);
+            m_interval = sec;
+            ++m_version;
+            if (sec && !m_thread) {
+                m_stop = false;
+                m_thread.reset(new Thread(std::bind(&LogMetricsDumper::run, this), "log_metrics"));
+            } else if (!sec && m_thread) {
+                m_stop = true;
+                old.swap(m_thread);
+            }
+        }
+        m_cond.notify_all();
+        if (old) {
+            old->join();
+        }
+    }
+private:
+    void run() {
+        std::unique_lock<Mutex> lock(m_mutex);
+        uint64_t version = m_version;
+        while (!m_stop) {
+            bool woken = m_cond.wait_for(lock, std::chrono::seconds(m_interval), [this, version]() {
+                return m_stop || m_version != version;
+            });
+            if (m_stop) {
+                break;
+            }
+            if (woken) {
+                // 间隔改了，按新的间隔重新计时
+                version = m_version;
+                continue;
+            }
+            lock.unlock();
+            Logger::ptr logger = SYLAR_LOG_NAME(g_log_metrics_dump_logger->getValue());
+            SYLAR_LOG_INFO(logger) << "log metrics:\n" << LoggerMgr::GetInstance()->getMetricsString();
+            lock.lock();
+        }
+    }
+private:
+    Mutex m_mutex;
+    std::condition_variable_any m_cond;
+    uint32_t m_interval = 0;
+    uint64_t m_version = 0;     // 每次改间隔加一，唤醒等待中的线程
+    bool m_stop = false;
+    Thread::ptr m_thread;
+};
+
+// 按定义生成 appender
+static sylar::ConfigVar<bool>::ptr g_log_fatal_backtrace =
+    sylar::Config::Lookup("log.fatal_backtrace", true, "append backtrace to FATAL log");
+
+static bool IsFatalBacktraceEnabled() {
+    // 其他编译单元静态初始化时打的日志可能早于这里的初始化
+    return g_log_fatal_backtrace && g_log_fatal_backtrace->getValue();
+}
+
+static LogAppender::ptr CreateAppender(const LogAppenderDefine& a) {
+    LogAppender::ptr ap;
+    if (a.type == 1) {
+        ap.reset(new FileLogAppender(a.file, a.compress, a.compress_level,
+                                     a.flush_bytes, a.flush_ms, a.max_pending));
+    } else if (a.type == 2) {
+        ap.reset(new StdoutLogAppender);
+    } else if (a.type == 3) {
+        ap.reset(new NullLogAppender);
+    } else if (a.type == 4) {
+        ap.reset(new MemoryRingLogAppender(a.capacity, a.slot_size, a.raw));
+    } else if (a.type == 7) {
+#ifdef SYLAR_HAVE_LIBURING
+        ap.reset(new UringFileLogAppender(a.file, a.buffer_size));
+#else
+        // 编译时没有 liburing，退回普通文件appender
+        std::cout << "log config: UringFileLogAppender needs liburing, use FileLogAppender file="
+                  << a.file << std::endl;
+        ap.reset(new FileLogAppender(a.file));
+#endif
+    } else if (a.type == 8) {
+        ap.reset(new MmapFileLogAppender(a.file, a.segment_size,
+                    MmapFileLogAppender::SyncPolicyFromString(a.sync), a.sync_ms));
+    } else if (a.type == 5) {
+        ap.reset(new SyslogLogAppender(a.ident, a.facility, a.path));
+    } else if (a.type == 6) {
+        ap.reset(new UdpLogAppender(a.host, a.port, a.mtu, a.flush_ms));
+    } else {
+        return nullptr;
+    }
+    ap->setLevel(a.level == LogLevel::UNKNOW ? LogLevel::DEBUG : a.level);
+    if (!a.formatter.empty()) {
+        LogFormatter::ptr fmt = LogFormatter::Create(a.formatter);
+        if (!fmt->isError()) {
+            ap->setFormatter(fmt);
+        } else {
+            std::cout << "log appender formatter=" << a.formatter
+                      << " is invalid" << std::endl;
+        }
+    }
+    return ap;
+}
+
+// 把一个 logger 更新到新定义，old 为空表示新增
+// 只动变化的部分：级别、formatter、appender 各自比较
+static void ApplyLogDefine(Logger::ptr logger, const LogDefine* old, const LogDefine& nld) {
+    // 没配置级别就继承父日志器，root 没有父日志器时为 DEBUG
+    if (!old || old->level != nld.level) {
+        logger->setLevel(nld.level);
+    }
+    if (!old || old->additivity != nld.additivity) {
+        logger->setAdditive(nld.additivity);
+    }
+    if (!old || old->formatter != nld.formatter) {
+        logger->setFormatter(nld.formatter.empty() ? s_default_pattern : nld.formatter);
+    }
+    if (!old || old->rate != nld.rate || old->burst != nld.burst) {
+        if (nld.rate > 0) {
+            logger->setRateLimit(TokenBucket::ptr(new TokenBucket(nld.rate,
+                            nld.burst ? nld.burst : (uint64_t)nld.rate)));
+        } else {
+            logger->setRateLimit(nullptr);
+        }
+    }
+    if (!old || !(old->appenders == nld.appenders)) {
+        logger->clearAppenders();
+        for (auto& a : nld.appenders) {
+            LogAppender::ptr ap = CreateAppender(a);
+            if (ap) {
+                logger->addAppender(ap);
+            }
+        }
+    }
+}
+
+void LoggerManager::init() {
+    g_log_defines->addListener([this](const std::set<LogDefine>& old_value,
+                const std::set<LogDefine>& new_value) {
+        SYLAR_LOG_INFO(m_root) << "on_logger_conf_changed";
+        // 新增和修改的
+        for (auto& i : new_value) {
+            auto it = old_value.find(i);
+            if (it == old_value.end()) {
+                ApplyLogDefine(getLogger(i.name), nullptr, i);
+            } else if (!(i == *it)) {
+                ApplyLogDefine(getLogger(i.name), &*it, i);
+            }
+        }
+
+        // 删除的：不真正删除（别处可能还拿着指针），恢复成默认状态
+        for (auto& i : old_value) {
+            if (new_value.find(i) != new_value.end()) {
+                continue;
+            }
+            Logger::ptr logger = getLogger(i.name);
+            logger->setLevel(logger == m_root ? LogLevel::DEBUG : LogLevel::UNKNOW);
+            logger->setAdditive(false);
+            logger->setFormatter(s_default_pattern);
+            logger->setRateLimit(nullptr);
+            logger->clearAppenders();
+            if (logger == m_root) {
+                logger->addAppender(LogAppender::ptr(new StdoutLogAppender));
+            }
+        }
+    });
+}
+
+// 静态对象在 main 之前执行，把 LoggerManager 挂到 logs 配置上
+struct LogIniter {
+    LogIniter() {
+        LoggerMgr::GetInstance()->init();
+        g_log_metrics_enable->addListener([](const bool& old_value, const bool& new_value) {
+            s_metrics_enabled = new_value;
+        });
+        g_log_metrics_dump_interval->addListener([](const uint32_t& old_value, const uint32_t& new_value) {
+            LogMetricsDumper::GetInstance()->setInterval(new_value);
+        });
+    }
+};
+
+static LogIniter __log_init;
+
+}
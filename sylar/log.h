@@ -13,15 +13,21 @@
 #include <time.h>
 #include <map>
 #include <stdarg.h>
+#include <atomic>
+#include <type_traits>
+#include <condition_variable>
 #include "util.h"
 #include "singleton.h"
+#include "compress.h"
+#include "mutex.h"
+#include "thread.h"
 
 // 定义一个宏，让日志输出更友好，因为不是什么日志都要输出的
 #define SYLAR_LOG_LEVEL(logger, level) \
     if (logger->getLevel() <= level) \
         sylar::LogEventWrap(sylar::LogEvent::ptr(new sylar::LogEvent(logger, level, \
         __FILE__, __LINE__, 0, sylar::GetThreadId(),\
-        sylar::GetFiberId(), time(0)))).getSS()
+        sylar::GetFiberId(), time(0), sylar::Thread::GetName())))
 
 #define SYLAR_LOG_DEBUG(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::DEBUG)
 #define SYLAR_LOG_INFO(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::INFO)
@@ -33,7 +39,7 @@
     if (logger->getLevel() <= level) \
         sylar::LogEventWrap(sylar::LogEvent::ptr(new sylar::LogEvent(logger, level, \
         __FILE__, __LINE__, 0, sylar::GetThreadId(),\
-        sylar::GetFiberId(), time(0)))).getEvent()->format(fmt, __VA_ARGS__)
+        sylar::GetFiberId(), time(0), sylar::Thread::GetName()))).getEvent()->format(fmt, __VA_ARGS__)
 
 #define SYLAR_LOG_FMT_DEBUG(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::DEBUG, fmt, __VA_ARGS__)
 #define SYLAR_LOG_FMT_INFO(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::INFO, fmt, __VA_ARGS__)
@@ -42,7 +48,27 @@
 #define SYLAR_LOG_FMT_FATAL(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::FATAL, fmt, __VA_ARGS__)
 
 
+// 按调用点限流，每个调用点有一份静态状态（lambda 里的 static，每个展开位置一个）
+// 被抑制的条数在下一条输出的日志后面带上
+#define SYLAR_LOG_SITE() \
+    ([]() -> sylar::LogSite& { static sylar::LogSite s_sylar_log_site; return s_sylar_log_site; }())
+
+#define SYLAR_LOG_SITE_LEVEL(logger, level, check) \
+    if (logger->getLevel() <= level) \
+        if (sylar::LogSite::Pass __sylar_log_pass = SYLAR_LOG_SITE().check) \
+            sylar::LogEventWrap(sylar::LogEvent::ptr(new sylar::LogEvent(logger, level, \
+            __FILE__, __LINE__, 0, sylar::GetThreadId(),\
+            sylar::GetFiberId(), time(0), sylar::Thread::GetName()))).setSuppressed(__sylar_log_pass.suppressed)
+
+// 每 n 条输出一条
+#define SYLAR_LOG_EVERY_N(logger, level, n) SYLAR_LOG_SITE_LEVEL(logger, level, everyN(n))
+// 只输出前 n 条
+#define SYLAR_LOG_FIRST_N(logger, level, n) SYLAR_LOG_SITE_LEVEL(logger, level, firstN(n))
+// 每 ms 毫秒最多输出一条
+#define SYLAR_LOG_EVERY_MS(logger, level, ms) SYLAR_LOG_SITE_LEVEL(logger, level, everyMs(ms))
+
 #define SYLAR_LOG_ROOT() sylar::LoggerMgr::GetInstance()->getRoot()
+#define SYLAR_LOG_NAME(name) sylar::LoggerMgr::GetInstance()->getLogger(name)
 
 
 namespace sylar
@@ -64,6 +90,69 @@ public:
     };
 
     static const char* ToString(LogLevel::Level level);
+    // 从字符串解析级别，大小写都支持，无法识别返回UNKNOW
+    static LogLevel::Level FromString(const std::string& str);
+};
+
+// 结构化日志字段，SYLAR_LOG_INFO(logger).kv("uid", uid) << ...
+// key 只保存指针，要求是字符串字面量之类生命周期足够长的字符串
+// 字符串的值拷贝到 LogEvent 内部的缓冲里
+struct LogField {
+    enum Type {
+        INT = 0,
+        UINT = 1,
+        DOUBLE = 2,
+        BOOL = 3,
+        STRING = 4
+    };
+    const char* key;
+    Type type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        bool b;
+        struct {
+            const char* ptr;
+            uint32_t len;
+        } str;
+    };
+};
+
+// 日志上下文（MDC），比如请求id、trace id，设置一次后这个线程上的每条日志都会带上
+// 内容是不可变的 map，修改时复制一份新的（写时复制），
+// 日志事件只拷贝 shared_ptr，上下文没变时不会有内存分配
+class LogContext
+{
+public:
+    typedef std::map<std::string, std::string> Map;
+    typedef std::shared_ptr<const Map> ptr;
+
+    static void Put(const std::string& key, const std::string& value);
+    static void Remove(const std::string& key);
+    static void Clear();
+    // 不存在返回空字符串
+    static std::string Get(const std::string& key);
+
+    // 当前上下文的快照，空上下文返回 nullptr
+    static ptr GetCurrent();
+    // 整体替换当前上下文，协程切换时用来保存/恢复各自的上下文
+    static void SetCurrent(ptr ctx);
+
+    // 作用域内设置 key，析构时恢复成原来的值
+    class Scoped
+    {
+    public:
+        Scoped(const std::string& key, const std::string& value);
+        ~Scoped();
+    private:
+        Scoped(const Scoped&) = delete;
+        Scoped& operator=(const Scoped&) = delete;
+    private:
+        std::string m_key;
+        std::string m_old;
+        bool m_hadOld;
+    };
 };
 
 // 日志事件
@@ -72,13 +161,14 @@ class LogEvent
 public:
     typedef std::shared_ptr<LogEvent> ptr;
     LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level Level, const char* file, int32_t m_line, uint32_t elapse,
-            uint32_t thread_id, uint32_t fiber_id, uint64_t time);
+            uint32_t thread_id, uint32_t fiber_id, uint64_t time, const std::string& thread_name);
 
     const char* getFile() const { return m_file;}
     int32_t getLine() const { return m_line;}
     uint32_t getElapse() const { return m_elapse;}
     uint32_t getThreadId() const { return m_threadId;}
     uint32_t getFiberId() const { return m_fiberId;}
+    const std::string& getThreadName() const { return m_threadName;}
     uint64_t getTime() const { return m_time;}
     std::string getContent() const { return m_ss.str();}
     std::shared_ptr<Logger> getLogger() const { return m_logger;} 
@@ -87,6 +177,49 @@ public:
     std::stringstream& getSS() { return m_ss;}
     void format(const char* fmt, ...);
     void format(const char* fmt, va_list al);
+
+    // 这条日志之前被限流抑制的条数
+    uint64_t getSuppressed() const { return m_suppressed;}
+    void setSuppressed(uint64_t v) { m_suppressed = v;}
+
+    // 添加结构化字段，整数、浮点、bool、字符串
+    template<class T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type
+    addField(const char* key, T v) {
+        LogField f;
+        f.key = key;
+        if (std::is_signed<T>::value) {
+            f.type = LogField::INT;
+            f.i = v;
+        } else {
+            f.type = LogField::UINT;
+            f.u = v;
+        }
+        pushField(f);
+    }
+    template<class T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type
+    addField(const char* key, T v) {
+        LogField f;
+        f.key = key;
+        f.type = LogField::DOUBLE;
+        f.d = v;
+        pushField(f);
+    }
+    void addField(const char* key, bool v);
+    void addField(const char* key, const char* v);
+    void addField(const char* key, const std::string& v);
+    void addField(const char* key, const char* v, size_t len);
+
+    // 创建事件时的日志上下文，可能为 nullptr
+    const LogContext::ptr& getContext() const { return m_context;}
+
+    size_t getFieldCount() const { return m_fieldCount;}
+    const LogField& getField(size_t i) const {
+        return i < s_inline_fields ? m_fields[i] : m_moreFields[i - s_inline_fields];
+    }
+private:
+    void pushField(const LogField& f);
 private:
     const char* m_file = nullptr;   // 文件名
     int32_t m_line = 0;             // 行号
@@ -94,10 +227,23 @@ private:
     uint32_t m_threadId = 0;        // 线程id
     uint32_t m_fiberId = 0;         // 协程id
     uint64_t m_time;                // 时间戳
+    std::string m_threadName;       // 线程名称，内核限制 15 个字符以内，不会额外分配内存
     std::stringstream m_ss;          // 消息
 
     std::shared_ptr<Logger> m_logger;
     LogLevel::Level m_level;
+    uint64_t m_suppressed = 0;      // 调用点限流抑制的条数
+    LogContext::ptr m_context;      // 日志上下文快照
+
+    // 字段和字符串值都先放在对象内部，超出了才用堆
+    static const size_t s_inline_fields = 8;
+    static const size_t s_inline_buf = 256;
+    LogField m_fields[s_inline_fields];
+    size_t m_fieldCount = 0;
+    char m_buf[s_inline_buf];
+    size_t m_bufUsed = 0;
+    std::vector<LogField> m_moreFields;
+    std::list<std::string> m_moreStrs;  // list保证已有字符串地址不变
 };
 
 // LogEvent使用智能指针，在使用宏方便日志输出的时候有点困难，所以构造一个LogEventWrap类
@@ -109,20 +255,143 @@ public:
     ~LogEventWrap();
     LogEvent::ptr getEvent() const { return m_event;}
     std::stringstream& getSS();
+    LogEventWrap& setSuppressed(uint64_t v) { m_event->setSuppressed(v); return *this;}
+
+    // 结构化字段，可以连着写 .kv("a", 1).kv("b", "x") << "msg"
+    template<class T>
+    LogEventWrap& kv(const char* key, const T& v) {
+        m_event->addField(key, v);
+        return *this;
+    }
+
+    // 宏展开后直接对 wrap 做 <<，转给内部的 stringstream
+    template<class T>
+    std::ostream& operator<<(const T& v) {
+        return getSS() << v;
+    }
+    std::ostream& operator<<(std::ostream& (*pf)(std::ostream&)) {
+        return getSS() << pf;
+    }
 
 private:
     LogEvent::ptr m_event;
 };
 
+// 调用点限流状态，配合 SYLAR_LOG_EVERY_N/FIRST_N/EVERY_MS 使用，全是原子操作
+class LogSite
+{
+public:
+    // 判断结果，pass 为 true 时 suppressed 为上次输出之后被抑制的条数
+    struct Pass {
+        bool pass;
+        uint64_t suppressed;
+        explicit operator bool() const { return pass;}
+    };
+
+    Pass everyN(uint64_t n);
+    Pass firstN(uint64_t n);
+    Pass everyMs(uint64_t ms);
+private:
+    Pass suppress();
+private:
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_suppressed{0};
+    std::atomic<uint64_t> m_lastMs{0};
+};
+
+// 令牌桶限流（GCRA 实现，一个原子变量，无锁）
+// rate 每秒允许的条数，burst 允许突发的条数
+class TokenBucket
+{
+public:
+    typedef std::shared_ptr<TokenBucket> ptr;
+    TokenBucket(double rate, uint64_t burst);
+
+    // 拿到令牌返回 true
+    bool tryAcquire();
+
+    double getRate() const { return m_rate;}
+    uint64_t getBurst() const { return m_burst;}
+private:
+    double m_rate;
+    uint64_t m_burst;
+    uint64_t m_interval;                // 每个令牌的间隔，纳秒
+    uint64_t m_tolerance;               // 允许提前的时间，纳秒
+    std::atomic<uint64_t> m_tat{0};     // 理论上下一个令牌的到达时间
+};
+
+// 日志开销统计：按级别的条数、字节数、丢弃数、格式化耗时、写入耗时直方图
+// 计数按 CPU 分片，分片数是 CPU 数向上取 2 的幂，写当前 CPU 那片，读的时候汇总，
+// 同一时刻一片只有一个线程在写，线程再多也没有缓存行争用
+// 分片第一次计数时才分配，没开统计的日志器和 appender 只多一个指针
+// 直方图是 HDR 风格的：按 2 的幂分段，每段再线性分 4 个桶，相对误差不超过 25%
+class LogMetrics
+{
+public:
+    static const int kLevels = 6;       // LogLevel::UNKNOW ~ FATAL
+    static const int kSubBuckets = 4;
+    static const int kBuckets = 160;    // 覆盖到 2^40 纳秒（约 18 分钟），再大的算进最后一个桶
+
+    struct Snapshot {
+        uint64_t events[kLevels] = {0};
+        uint64_t bytes = 0;
+        uint64_t drops = 0;
+        uint64_t format_ns = 0;     // 格式化总耗时
+        uint64_t write_ns = 0;      // 写入总耗时（不含格式化）
+        uint64_t write_hist[kBuckets] = {0};
+
+        uint64_t getEvents() const;
+        // 写入耗时的分位数（桶的上界），p 取 0 ~ 1，没有数据返回 0
+        uint64_t getWritePercentile(double p) const;
+        // 输出成一行 key=value
+        std::string toString() const;
+    };
+
+    LogMetrics();
+    ~LogMetrics();
+
+    // 一条日志：level 级别，bytes 格式化后的长度，两段耗时都是纳秒
+    void addEvent(LogLevel::Level level, uint64_t bytes, uint64_t format_ns, uint64_t write_ns);
+    void addDrop(uint64_t n = 1);
+    Snapshot getSnapshot() const;
+    void reset();
+
+    // 纳秒值对应的直方图桶，以及桶的上界
+    static int BucketIndex(uint64_t ns);
+    static uint64_t BucketUpper(int idx);
+    // 统计开关，配置 log.metrics.enable，默认关闭，关掉后不再读时钟
+    static bool IsEnabled();
+private:
+    // C++11 的 new 不保证 alignas(64)，改为在每片后面填一个缓存行，
+    // 相邻两片常写的计数（开头的几个）不会落在同一个缓存行里
+    struct Shard {
+        std::atomic<uint64_t> events[kLevels];
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> drops;
+        std::atomic<uint64_t> format_ns;
+        std::atomic<uint64_t> write_ns;
+        std::atomic<uint64_t> write_hist[kBuckets];
+        char pad[64];
+    };
+    Shard& getShard();
+    static uint32_t ShardCount();
+private:
+    std::atomic<Shard*> m_shards;   // ShardCount() 片，第一次计数时分配
+};
+
 // 日志格式器
 class LogFormatter
 {
 public:
     typedef std::shared_ptr<LogFormatter> ptr;
     LogFormatter(const std::string& m_pattern);
+    virtual ~LogFormatter() {}
+
+    // 按pattern创建formatter，pattern为 "json" 时创建 JsonLogFormatter
+    static LogFormatter::ptr Create(const std::string& pattern);
     
     // 格式：%t     %thread_id %m%n
-    std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event);
+    virtual std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event);
 public:
     // 基类format项，后面会具体用很多子类来实现
     class FormatItem 
@@ -135,17 +404,34 @@ public:
     };
 
     void init();        // 做日志格式（pattern）解析
-private:
+
+    bool isError() const { return m_error;}
+    const std::string getPattern() const { return m_pattern;}
+protected:
     std::string m_pattern;                  // 格式结构，根据pattern格式解析出item的信息
+private:
     std::vector<FormatItem::ptr> m_items;   // 日志格式有很多项
+    bool m_error = false;                   // pattern是否有错误
+};
+
+// JSON格式器，每条日志输出一行JSON对象，结构化字段放在 "fields" 里
+// 配置里 formatter 写 json 即可使用
+class JsonLogFormatter : public LogFormatter
+{
+public:
+    typedef std::shared_ptr<JsonLogFormatter> ptr;
+    JsonLogFormatter();
+    std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
 };
 
 // 日志输出地
 // 由于有多种日志输出地，此类作为它们的基类
 class LogAppender
 {
+friend class Logger;
 public:
     typedef std::shared_ptr<LogAppender> ptr;
+    typedef DefaultMutex MutexType;
 
     /**
      * @brief 析构函数
@@ -155,10 +441,22 @@ public:
 
     // 定义基类的log，纯虚函数，所以在子类必须实现
     virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;
+    // 输出成YAML字符串，用于把当前日志配置dump出来
+    virtual std::string toYamlString() = 0;
+    // 把缓冲中的日志写出去，崩溃和退出前调用
+    virtual void flush() {}
+    // 重新打开输出目标（日志文件被 logrotate 移走后、fork 出的子进程里），成功返回true
+    virtual bool reopen() { return true;}
+    // appender 自己丢弃的条数（发送缓冲满等），不丢日志的返回 0
+    virtual uint64_t getDropped() const { return 0;}
+
+    // 开销统计：达到 appender 级别的条数、字节数、丢弃数、格式化和写入耗时
+    LogMetrics::Snapshot getMetrics() const;
 
     // 不同的输出地有不同的输出格式
-    void setFormatter(LogFormatter::ptr val) { m_formatter = val;}
-    LogFormatter::ptr getFormatter() const { return m_formatter;}
+    // 手动设置过的formatter不会被logger的formatter覆盖
+    void setFormatter(LogFormatter::ptr val);
+    LogFormatter::ptr getFormatter();
 
     LogLevel::Level getLevel() const { return m_level;}
     void setLevel(LogLevel::Level val) { m_level = val;}
@@ -166,15 +464,20 @@ public:
 //// 因为是基类，成员属性用protected则子类就能使用到
 protected:
     LogLevel::Level m_level = LogLevel::DEBUG;            // 日志级别
+    bool m_hasFormatter = false;        // 是否有自己的formatter
     LogFormatter::ptr m_formatter;      // 输出格式
+    MutexType m_mutex;                  // 保护formatter和各子类的输出状态
+    LogMetrics m_metrics;               // 由 Logger::log 统计
 };
 
 // 日志器
 // 只有继承了std::enable_shared_from_this<Logger>，成员函数才能用shared_from_this()获取自己的指针
 class Logger : public std::enable_shared_from_this<Logger>
 {
+friend class LoggerManager;
 public:
     typedef std::shared_ptr<Logger> ptr;
+    typedef DefaultMutex MutexType;
 
     Logger(const std::string& name = "root");
     void log(LogLevel::Level level, LogEvent::ptr event);
@@ -189,15 +492,58 @@ public:
 
     void addAppender(LogAppender::ptr appender);            // 添加appender
     void delAppender(LogAppender::ptr appender);            // 删除appender
-    LogLevel::Level getLevel() const { return m_level;}     // 获取日志级别
-    void setLevel(LogLevel::Level val) { m_level = val;}    // 设置级别
+    void clearAppenders();                                  // 清空appender
+    void flush();                                           // 所有appender刷盘
+    void reopen();                                          // 所有appender重新打开输出目标
+    // 开销统计：通过级别判断的条数、被限流丢弃的条数、所有 appender 加起来的字节数和耗时
+    LogMetrics::Snapshot getMetrics() const { return m_metrics.getSnapshot();}
+    // 获取生效的日志级别，已缓存好，宏里判断级别只读一次
+    LogLevel::Level getLevel() const { return m_effectiveLevel.load(std::memory_order_relaxed);}
+    // 设置级别，UNKNOW 表示继承父日志器；会刷新所有子日志器的缓存
+    void setLevel(LogLevel::Level val);
+    // 自己配置的级别，UNKNOW 表示继承
+    LogLevel::Level getConfiguredLevel() const { return m_level;}
 
     const std::string& getName() const { return m_name;}
+    Logger::ptr getParent() const { return m_parent;}
+
+    // 可加性：为 true 时输出到自己的 appender 后，继续输出到父日志器的 appender
+    // 自己没有 appender 时总是交给父日志器
+    bool isAdditive();
+    void setAdditive(bool v);
+
+    // 设置formatter，没有自己formatter的appender也一起更新
+    void setFormatter(LogFormatter::ptr val);
+    void setFormatter(const std::string& val);
+    LogFormatter::ptr getFormatter();
+
+    // 设置令牌桶限流，传空取消；超出的日志丢弃，丢弃条数带在下一条输出的日志后面
+    void setRateLimit(TokenBucket::ptr val);
+    TokenBucket::ptr getRateLimit();
+
+    std::string toYamlString();
+private:
+    // appender 集合改动时整个换掉，log 在锁里只拷指针，调用 appender 时不持有日志器的锁
+    typedef std::shared_ptr<const std::vector<LogAppender::ptr> > AppenderList;
+    // 重新计算生效级别，并递归刷新子日志器
+    void updateEffectiveLevel();
+    // 在锁里取一份 appender 集合
+    AppenderList getAppenders();
 private:
     std::string m_name;                         // 日志名称
     LogLevel::Level m_level;                    // 日志级别
-    std::list<LogAppender::ptr> m_appenders;    // Appender集合
+    std::atomic<LogLevel::Level> m_effectiveLevel;  // 生效的日志级别（考虑继承后）
+    AppenderList m_appenders;                   // Appender集合，不为空指针
     LogFormatter::ptr m_formatter;             // 初始化的时候可能appender不需要formatter，直接用logformatter就行
+    Logger::ptr m_parent;                       // 父日志器，a.b.c 的父为 a.b，顶层的父为 root
+    std::vector<Logger*> m_children;            // 子日志器，都由 LoggerManager 持有
+    bool m_additive = false;                    // 是否也输出到父日志器的appender
+    TokenBucket::ptr m_rateLimit;               // 限流，为空不限流
+    std::atomic<TokenBucket*> m_rateLimitPtr{nullptr};  // 同上，log 热路径直接读，不加锁不动引用计数
+    std::vector<TokenBucket::ptr> m_retiredLimits;  // 换下来的限流器，可能还有线程拿着裸指针，保留到析构
+    std::atomic<uint64_t> m_dropped{0};         // 被限流丢弃的条数
+    LogMetrics m_metrics;                       // 开销统计
+    MutexType m_mutex;                          // 保护上面的appender、formatter、子日志器等
 };
 
 // 定义输出到控制台的Appender
@@ -206,23 +552,249 @@ class StdoutLogAppender : public LogAppender
 public:
     typedef std::shared_ptr<StdoutLogAppender> ptr;
     void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+    void flush() override;
 private:
 };
 
 // 定义输出到文件的Appender
+// compress 不为 none 时边写边压缩：调用方只格式化并放进缓冲，
+// 后台写线程攒够 flush_bytes 或者每隔 flush_ms 把缓冲压成一个完整的帧写进文件，
+// flush() 也会切出一个帧，所以写了一半的文件也能解压出已经落盘的部分
+// 写线程跟不上时缓冲最多攒 max_pending 字节，再来的日志丢弃并计数，不会卡住调用方
 class FileLogAppender : public LogAppender
 {
 public:
     typedef std::shared_ptr<FileLogAppender> ptr;
-    FileLogAppender(const std::string& filename);
+    // compress 为 none、zstd、lz4、gzip，编译时没有对应的库则退回 none
+    FileLogAppender(const std::string& filename, const std::string& compress = "none",
+                    int compress_level = 0, size_t flush_bytes = 256 * 1024, uint32_t flush_ms = 1000,
+                    size_t max_pending = 8 * 1024 * 1024);
+    ~FileLogAppender();
     void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+    // 压缩模式下等后台线程把已有的日志写完，最多等 2 秒，写线程卡住时不拖住调用方
+    void flush() override;
+
+    // 压缩模式下缓冲满了丢弃的条数
+    uint64_t getDropped() const override { return m_dropped;}
+
+    const std::string& getFilename() const { return m_filename;}
+    const std::string& getCompress() const { return m_compress;}
 
     // 有时候会重新打开日志文件，文件打开成功，返回true
-    bool reopen();              
+    bool reopen() override;
 
+    // 压缩前、写进文件的字节数，压缩花的时间
+    uint64_t getRawBytes() const { return m_rawBytes;}
+    uint64_t getFileBytes() const { return m_fileBytes;}
+    uint64_t getCompressNs() const { return m_compressNs;}
+private:
+    // 后台写线程
+    void writerLoop();
+    // 把一批日志压成一个帧写进文件
+    void writeFrame(const std::string& buf, std::string& frame);
 private:
     std::string m_filename;         // 文件名
-    std::ofstream m_filestream;     // ofstream是从内存到硬盘
+    std::ofstream m_filestream;     // ofstream是从内存到硬盘，由 m_mutex 保护
+
+    std::string m_compress = "none";
+    int m_compressLevel;
+    LogCompressor::ptr m_compressor;
+    size_t m_flushBytes;
+    uint32_t m_flushMs;
+    size_t m_maxPending;
+    Thread::ptr m_thread;           // SYLAR_SINGLE_THREAD 下为空，调用线程自己压缩
+    uint64_t m_lastWriteMs = 0;     // 没有写线程时，上次写帧的时间
+    Mutex m_pendingMutex;           // 保护下面几个
+    std::condition_variable_any m_cond;
+    std::condition_variable_any m_flushedCond;
+    std::string m_pending;          // 等待压缩的日志
+    bool m_full = false;            // 缓冲满了在丢日志，写线程要马上取走
+    bool m_stop = false;
+    uint64_t m_flushReq = 0;        // flush 请求序号
+    uint64_t m_flushDone = 0;       // 已完成的 flush 序号
+
+    std::atomic<uint64_t> m_rawBytes;
+    std::atomic<uint64_t> m_fileBytes;
+    std::atomic<uint64_t> m_compressNs;
+    std::atomic<uint64_t> m_dropped;
+};
+
+// 什么都不输出的Appender，只做格式化，用来测格式化的开销
+class NullLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<NullLogAppender> ptr;
+    // format为false时连格式化也跳过
+    NullLogAppender(bool format = true)
+        :m_format(format) {}
+    void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+private:
+    bool m_format;
+};
+
+// 内存环形缓冲Appender，保留最近capacity条日志，满了覆盖最旧的
+// 内存在构造时一次分配好，每条日志占一个固定大小的槽，超长的截断
+// 用于线上开DEBUG只花内存不落盘，崩溃时把最近的日志dump出来
+class MemoryRingLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<MemoryRingLogAppender> ptr;
+    // raw为true时不走formatter，只存 "级别 内容"，更省时间
+    MemoryRingLogAppender(size_t capacity = 1024, size_t slot_size = 256, bool raw = false);
+    ~MemoryRingLogAppender();
+    void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+
+    // 按时间顺序把缓冲里的日志写到fd，只用write，可以在信号处理函数里调用
+    void dump(int fd) const;
+
+    // dump所有存活的环形缓冲，同样是异步信号安全的；环形缓冲的个数没有上限
+    static void DumpAll(int fd);
+
+    size_t getCapacity() const { return m_capacity;}
+    size_t getSlotSize() const { return m_slotSize;}
+    bool isRaw() const { return m_raw;}
+private:
+    size_t m_capacity;
+    size_t m_slotSize;
+    bool m_raw;
+    char* m_data;                           // capacity * slot_size 的缓冲
+    std::atomic<uint32_t>* m_lens;          // 每个槽的有效长度，0表示为空
+    // 每个槽的序号：序号为 pos 的日志开始写时置为 2*pos+1，写完置为 2*pos+2
+    // dump 拷出槽内容前后各读一次，奇数或者前后不一致说明被改写了，跳过
+    std::atomic<uint64_t>* m_seqs;
+    char* m_dumpBuf;                        // dump 时拷槽内容用，信号处理函数里不能分配内存
+    std::atomic<uint64_t> m_pos;            // 下一条日志的序号
+};
+
+// 内存映射文件Appender，用于只追加的审计日志，写日志时没有系统调用
+// 文件分段：filename.000000、filename.000001 ...，每段 fallocate 成 segment_size 后映射，
+// 日志 memcpy 进去，写满了换下一段，正常关闭时把文件截断到实际长度
+// 重启时找到最后一段，跳过末尾的 0 和不完整的一行，接着往后写
+// fallocate 失败（磁盘满等）时这一段不映射，退回 pwrite 写文件，写失败的丢弃并计数；
+// 不用 ftruncate 撑出稀疏文件，否则磁盘满时写映射内存会 SIGBUS
+class MmapFileLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<MmapFileLogAppender> ptr;
+    // 持久化策略：NONE 交给内核回写，ERROR 在 ERROR 及以上的日志后 msync，
+    // PERIODIC 距上次 msync 超过 sync_ms 时在下一条日志后 msync
+    enum SyncPolicy {
+        NONE = 0,
+        ERROR = 1,
+        PERIODIC = 2
+    };
+    MmapFileLogAppender(const std::string& filename, size_t segment_size = 64 * 1024 * 1024,
+                        SyncPolicy sync = NONE, uint32_t sync_ms = 1000);
+    ~MmapFileLogAppender();
+    void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+    // msync 已写的部分
+    void flush() override;
+
+    const std::string& getFilename() const { return m_filename;}
+    uint32_t getSegmentIndex() const { return m_index;}
+    size_t getCursor() const { return m_cursor;}
+    bool isValid() const { return m_fd >= 0;}
+    // 当前段是否映射了，false 表示退回了 pwrite
+    bool isMapped() const { return m_data != nullptr;}
+    uint64_t getDropped() const override { return m_dropped;}
+
+    static SyncPolicy SyncPolicyFromString(const std::string& str);
+    static const char* SyncPolicyToString(SyncPolicy v);
+    // 在一段数据里找日志的有效结尾：去掉末尾的 0 和最后一个 '\n' 之后的半行
+    static size_t FindValidEnd(const char* data, size_t size);
+private:
+    std::string segmentName(uint32_t index) const;
+    bool openSegment(uint32_t index, bool recover);
+    void closeSegment();
+    void sync();
+private:
+    std::string m_filename;
+    size_t m_segmentSize;
+    SyncPolicy m_sync;
+    uint32_t m_syncMs;
+    uint32_t m_index = 0;           // 当前段号
+    int m_fd = -1;
+    char* m_data = nullptr;         // 映射的地址
+    size_t m_cursor = 0;            // 写到的位置
+    size_t m_synced = 0;            // msync 过的位置
+    uint64_t m_lastSyncMs = 0;
+    std::atomic<uint64_t> m_dropped{0};
+};
+
+// 输出到本机syslog的Appender，RFC 5424 格式，走 /dev/log 的 Unix 数据报套接字
+// 日志上下文作为 STRUCTURED-DATA 带上，默认 formatter 只输出 %m
+// 非阻塞发送，syslog 忙或没起来时丢弃并计数，不会卡住调用方
+class SyslogLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<SyslogLogAppender> ptr;
+    // facility 为 syslog 的设施号，1 是 user，16~23 是 local0~local7
+    SyslogLogAppender(const std::string& ident = "sylar", int facility = 1,
+                      const std::string& path = "/dev/log");
+    ~SyslogLogAppender();
+    void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+
+    uint64_t getDropped() const override { return m_dropped;}
+
+    // 设施名转设施号，user/daemon/local0~local7 或者数字，无法识别返回 -1
+    static int FacilityFromString(const std::string& str);
+private:
+    bool connect();
+private:
+    std::string m_ident;
+    int m_facility;
+    std::string m_path;
+    std::string m_hostname;
+    int m_sock = -1;
+    std::atomic<uint64_t> m_dropped;
+};
+
+// 通过UDP发给日志收集端的Appender
+// 多条日志拼成一个数据报，每条以 '\n' 结尾，凑满 mtu 或者距第一条超过 flush_ms 就发
+// 后台线程每隔 flush_ms 检查一次，最后一条之后没有新日志也会按时发出去
+// 单条超过 mtu 的截断；非阻塞发送，失败时按条数计入丢弃，不会卡住调用方
+class UdpLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<UdpLogAppender> ptr;
+    // mtu 为一个数据报最多的字节数，默认 1472 为以太网 MTU 减去 IP 和 UDP 头
+    UdpLogAppender(const std::string& host, uint16_t port, size_t mtu = 1472, uint32_t flush_ms = 100);
+    ~UdpLogAppender();
+    void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+    // 把攒着的日志立刻发出去
+    void flush() override;
+
+    bool isValid() const { return m_sock >= 0;}
+    uint64_t getDropped() const override { return m_dropped;}
+    uint64_t getSent() const { return m_sent;}
+    uint64_t getDatagrams() const { return m_datagrams;}
+private:
+    void send();
+    // 后台线程：定时把超过 flush_ms 的缓冲发出去
+    void flushLoop();
+private:
+    std::string m_host;
+    uint16_t m_port;
+    size_t m_mtu;
+    uint32_t m_flushMs;
+    int m_sock = -1;
+    std::string m_buf;              // 攒着的日志
+    uint32_t m_bufCount = 0;        // m_buf 里的条数
+    uint64_t m_bufFirstMs = 0;      // m_buf 里第一条的时间
+    Thread::ptr m_thread;           // SYLAR_SINGLE_THREAD 下不起定时线程，超时的包在下一条日志或 flush 时发出
+    Mutex m_stopMutex;
+    std::condition_variable_any m_stopCond;
+    bool m_stop = false;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_sent;
+    std::atomic<uint64_t> m_datagrams;
 };
 
 // 日志管理器
@@ -231,11 +803,28 @@ class LoggerManager
 {
 public:
     LoggerManager();
+    // 获取日志器，不存在则创建一个
+    // 名字按 '.' 分层，net.http.server 的父为 net.http，再到 net，最后是 root
+    // 新建的日志器继承父日志器的级别，没有appender时使用父日志器的appender
     Logger::ptr getLogger(const std::string& name);
 
+    // 挂到logs配置上：配置变化时按差异更新日志器
     void init();
     Logger::ptr getRoot() const { return m_root;}
+
+    // 把所有日志器的当前状态输出成YAML
+    std::string toYamlString();
+
+    // 所有日志器的appender刷盘
+    void flush();
+
+    // 所有日志器的appender重新打开输出目标
+    void reopen();
+
+    // 所有日志器和它们的appender的开销统计，YAML 格式，没有日志的日志器跳过
+    std::string getMetricsString();
 private:
+    DefaultMutex m_mutex;
     std::map<std::string, Logger::ptr> m_loggers;
     Logger::ptr m_root;
 };
@@ -0,0 +1,253 @@
+#include "log_uring.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <yaml-cpp/yaml.h>
+
+namespace sylar
+{
+
+// 两块缓冲，最多两个写在内核里，队列深度给一点余量
+static const unsigned s_queue_depth = 4;
+
+UringFileLogAppender::UringFileLogAppender(const std::string& filename, size_t buffer_size)
+    :m_filename(filename)
+    ,m_bufSize(buffer_size < 4096 ? 4096 : buffer_size) {
+    int rt = io_uring_queue_init(s_queue_depth, &m_ring, 0);
+    if (rt < 0) {
+        std::cout << "UringFileLogAppender io_uring_queue_init fail rt=" << rt
+                  << " errstr=" << strerror(-rt) << std::endl;
+    } else {
+        m_ringInited = true;
+    }
+
+    struct iovec iov[2];
+    for (int i = 0; i < 2; ++i) {
+        void* p = nullptr;
+        if (posix_memalign(&p, 4096, m_bufSize) != 0) {
+            p = nullptr;
+        }
+        m_bufs[i].data = (char*)p;
+        iov[i].iov_base = p;
+        iov[i].iov_len = m_bufSize;
+    }
+    if (m_ringInited && m_bufs[0].data && m_bufs[1].data) {
+        rt = io_uring_register_buffers(&m_ring, iov, 2);
+        if (rt < 0) {
+            std::cout << "UringFileLogAppender io_uring_register_buffers fail rt=" << rt
+                      << " errstr=" << strerror(-rt) << std::endl;
+            io_uring_queue_exit(&m_ring);
+            m_ringInited = false;
+        }
+    }
+    reopen();
+}
+
+UringFileLogAppender::~UringFileLogAppender() {
+    flush();
+    if (m_ringInited) {
+        io_uring_unregister_buffers(&m_ring);
+        io_uring_queue_exit(&m_ring);
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+    free(m_bufs[0].data);
+    free(m_bufs[1].data);
+}
+
+bool UringFileLogAppender::reopen() {
+    // 旧文件里的日志先写完
+    flush();
+    MutexType::Lock lock(m_mutex);
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+    // 不用 O_APPEND，每次写带上偏移，两块缓冲的写谁先完成都没关系
+    m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        std::cout << "UringFileLogAppender open file=" << m_filename
+                  << " errno=" << errno << " errstr=" << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    m_offset = fstat(m_fd, &st) == 0 ? st.st_size : 0;
+    return true;
+}
+
+void UringFileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level) {
+        MutexType::Lock lock(m_mutex);
+        if (m_fd < 0) {
+            return;
+        }
+        std::string str = m_formatter->format(logger, level, event);
+        append(str.c_str(), str.size());
+    }
+}
+
+void UringFileLogAppender::append(const char* data, size_t len) {
+    if (!m_ringInited || !m_bufs[0].data || !m_bufs[1].data) {
+        writeSync(data, len, m_offset);
+        m_offset += len;
+        return;
+    }
+    Buffer* b = &m_bufs[m_cur];
+    if (b->used + len > m_bufSize) {
+        submit(m_cur);
+        m_cur ^= 1;
+        waitBuffer(m_cur);
+        b = &m_bufs[m_cur];
+    }
+    if (len > m_bufSize || !m_ringInited) {
+        // 单条超过缓冲大小，或者等待时 io_uring 出错已经关掉，直接同步写
+        writeSync(data, len, m_offset);
+        m_offset += len;
+        return;
+    }
+    memcpy(b->data + b->used, data, len);
+    b->used += len;
+    // 顺手收掉已经完成的写，不等待
+    reap(false);
+}
+
+void UringFileLogAppender::submit(int idx) {
+    Buffer& b = m_bufs[idx];
+    if (b.used == 0 || b.inflight) {
+        return;
+    }
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+    while (!sqe) {
+        reap(true);
+        if (!m_ringInited) {
+            // failRing 已经把这块同步写掉了
+            return;
+        }
+        sqe = io_uring_get_sqe(&m_ring);
+    }
+    io_uring_prep_write_fixed(sqe, m_fd, b.data, b.used, m_offset, idx);
+    io_uring_sqe_set_data(sqe, (void*)(uintptr_t)idx);
+    b.submitted = b.used;
+    b.offset = m_offset;
+    b.inflight = true;
+    m_offset += b.used;
+
+    int rt = io_uring_submit(&m_ring);
+    if (rt < 0) {
+        // 没提交出去就同步写掉
+        ++m_errors;
+        writeSync(b.data, b.submitted, b.offset);
+        b.inflight = false;
+        b.used = 0;
+    }
+}
+
+void UringFileLogAppender::reap(bool wait) {
+    while (m_bufs[0].inflight || m_bufs[1].inflight) {
+        struct io_uring_cqe* cqe = nullptr;
+        int rt = wait ? io_uring_wait_cqe(&m_ring, &cqe) : io_uring_peek_cqe(&m_ring, &cqe);
+        if (rt == -EINTR) {
+            continue;
+        }
+        if (rt < 0 && wait) {
+            failRing(rt);
+            return;
+        }
+        if (rt < 0 || !cqe) {
+            return;
+        }
+        int idx = (int)(uintptr_t)io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&m_ring, cqe);
+
+        Buffer& b = m_bufs[idx & 1];
+        if (res < 0) {
+            ++m_errors;
+            writeSync(b.data, b.submitted, b.offset);
+        } else if ((size_t)res < b.submitted) {
+            // 部分写，剩下的同步补上
+            writeSync(b.data + res, b.submitted - res, b.offset + res);
+        }
+        b.inflight = false;
+        b.used = 0;
+        wait = false;
+    }
+}
+
+void UringFileLogAppender::failRing(int rt) {
+    std::cout << "UringFileLogAppender file=" << m_filename << " io_uring_wait_cqe fail rt=" << rt
+              << " errstr=" << strerror(-rt) << ", fallback to pwrite" << std::endl;
+    ++m_errors;
+    // 在内核里的按原来的偏移写，内核之后再写完也是同样的内容；没提交的接在后面
+    for (auto& b : m_bufs) {
+        if (b.inflight) {
+            writeSync(b.data, b.submitted, b.offset);
+            b.inflight = false;
+            b.used = 0;
+        }
+    }
+    Buffer& cur = m_bufs[m_cur];
+    if (cur.used) {
+        writeSync(cur.data, cur.used, m_offset);
+        m_offset += cur.used;
+        cur.used = 0;
+    }
+    // 之后不再往注册过的缓冲里写，内核里没完成的写读到的还是原来的内容
+    io_uring_unregister_buffers(&m_ring);
+    io_uring_queue_exit(&m_ring);
+    m_ringInited = false;
+}
+
+void UringFileLogAppender::waitBuffer(int idx) {
+    while (m_bufs[idx].inflight) {
+        reap(true);
+    }
+}
+
+void UringFileLogAppender::writeSync(const char* data, size_t len, uint64_t offset) {
+    while (len > 0 && m_fd >= 0) {
+        ssize_t rt = pwrite(m_fd, data, len, offset);
+        if (rt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ++m_errors;
+            return;
+        }
+        data += rt;
+        len -= rt;
+        offset += rt;
+    }
+}
+
+void UringFileLogAppender::flush() {
+    MutexType::Lock lock(m_mutex);
+    if (!m_ringInited) {
+        return;
+    }
+    submit(m_cur);
+    waitBuffer(0);
+    waitBuffer(1);
+}
+
+std::string UringFileLogAppender::toYamlString() {
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "UringFileLogAppender";
+    node["file"] = m_filename;
+    node["buffer_size"] = m_bufSize;
+    if (m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    if (m_hasFormatter && m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+} // namespace sylar
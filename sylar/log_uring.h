@@ -0,0 +1,68 @@
+#ifndef __SYLAR_LOG_URING_H__
+#define __SYLAR_LOG_URING_H__
+
+// 依赖 liburing，cmake 检测到时才定义 SYLAR_HAVE_LIBURING 并编译 log_uring.cc
+#ifdef SYLAR_HAVE_LIBURING
+
+#include "log.h"
+#include <liburing.h>
+
+namespace sylar
+{
+
+// 用 io_uring 写文件的Appender
+// 两块注册过的缓冲轮流用：调用方往一块里拷日志，写满后提交给内核，换另一块继续拷，
+// 只有两块都在内核里没写完时才会等待。日志先攒在缓冲里，flush 时才保证提交并写完
+class UringFileLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<UringFileLogAppender> ptr;
+    UringFileLogAppender(const std::string& filename, size_t buffer_size = 256 * 1024);
+    ~UringFileLogAppender();
+    void log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+    // 提交当前缓冲并等所有写完成
+    void flush() override;
+
+    const std::string& getFilename() const { return m_filename;}
+    bool isValid() const { return m_fd >= 0 && m_ringInited;}
+    uint64_t getErrors() const { return m_errors;}
+
+    // 重新打开日志文件，成功返回true
+    bool reopen() override;
+private:
+    struct Buffer {
+        char* data = nullptr;
+        size_t used = 0;        // 已拷进来的字节数
+        size_t submitted = 0;   // 提交给内核的字节数
+        uint64_t offset = 0;    // 在文件中的偏移
+        bool inflight = false;  // 是否还在内核里
+    };
+
+    void append(const char* data, size_t len);
+    void submit(int idx);
+    // 收割完成的写，wait 为 true 时至少等到一个
+    void reap(bool wait);
+    void waitBuffer(int idx);
+    // 等待完成事件出错（不是 EINTR）：还在内核里的和没提交的缓冲都同步写掉，
+    // 关掉 io_uring，之后全部同步写，免得 waitBuffer、flush、析构一直等
+    void failRing(int rt);
+    // 同步写，io_uring 出错或单条超过缓冲大小时用
+    void writeSync(const char* data, size_t len, uint64_t offset);
+private:
+    std::string m_filename;
+    size_t m_bufSize;
+    int m_fd = -1;
+    uint64_t m_offset = 0;          // 下一次写的文件偏移
+    bool m_ringInited = false;
+    struct io_uring m_ring;
+    Buffer m_bufs[2];
+    int m_cur = 0;                  // 正在拷贝的缓冲
+    uint64_t m_errors = 0;
+};
+
+} // namespace sylar
+
+#endif // SYLAR_HAVE_LIBURING
+
+#endif // !__SYLAR_LOG_URING_H__
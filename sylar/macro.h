@@ -0,0 +1,69 @@
+#ifndef __SYLAR_MACRO_H__
+#define __SYLAR_MACRO_H__
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "log.h"
+#include "util.h"
+
+// 分支预测提示，条件大概率成立/不成立
+#if defined __GNUC__ || defined __llvm__
+#   define SYLAR_LIKELY(x)      __builtin_expect(!!(x), 1)
+#   define SYLAR_UNLIKELY(x)    __builtin_expect(!!(x), 0)
+#else
+#   define SYLAR_LIKELY(x)      (x)
+#   define SYLAR_UNLIKELY(x)    (x)
+#endif
+
+// 告诉编译器 x 一定成立，只用于已经证明成立的不变式，需要时显式使用
+// x 不成立是未定义行为；clang 下 x 不会被求值，x 必须没有副作用
+// gcc 没有 __builtin_assume，用 unreachable 代替
+#if defined __clang__
+#   define SYLAR_ASSUME(x)      __builtin_assume(x)
+#elif defined __GNUC__
+#   define SYLAR_ASSUME(x)      do { if (!(x)) __builtin_unreachable(); } while (0)
+#else
+#   define SYLAR_ASSUME(x)      do { (void)sizeof(x); } while (0)
+#endif
+
+// 断言失败：输出到 root 日志并带上调用栈，刷盘后 abort
+// release（NDEBUG）下同样检查，x 总会被求值，调用处可以依赖它的副作用
+#define SYLAR_ASSERT(x) \
+    do { \
+        if (SYLAR_UNLIKELY(!(x))) { \
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ASSERTION: " #x \
+                << "\nbacktrace:\n" \
+                << sylar::BacktraceToString(100, 2, "    "); \
+            sylar::LoggerMgr::GetInstance()->flush(); \
+            abort(); \
+        } \
+    } while (0)
+
+// 断言失败时额外输出 w
+#define SYLAR_ASSERT2(x, w) \
+    do { \
+        if (SYLAR_UNLIKELY(!(x))) { \
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ASSERTION: " #x \
+                << "\n" << w \
+                << "\nbacktrace:\n" \
+                << sylar::BacktraceToString(100, 2, "    "); \
+            sylar::LoggerMgr::GetInstance()->flush(); \
+            abort(); \
+        } \
+    } while (0)
+
+// 系统调用失败等环境错误，不是不变式：无条件输出 w、errno 和调用栈，刷盘后 abort
+#define SYLAR_PANIC(w) \
+    do { \
+        int sylar_panic_errno = errno; \
+        SYLAR_LOG_FATAL(SYLAR_LOG_ROOT()) << "PANIC: " << w \
+            << " errno=" << sylar_panic_errno \
+            << " errstr=" << strerror(sylar_panic_errno) \
+            << "\nbacktrace:\n" \
+            << sylar::BacktraceToString(100, 2, "    "); \
+        sylar::LoggerMgr::GetInstance()->flush(); \
+        abort(); \
+    } while (0)
+
+#endif // !__SYLAR_MACRO_H__
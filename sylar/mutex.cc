@@ -0,0 +1,33 @@
+#include "mutex.h"
+#include <stdexcept>
+#include <errno.h>
+
+namespace sylar
+{
+
+Semaphore::Semaphore(uint32_t count) {
+    if (sem_init(&m_semaphore, 0, count)) {
+        throw std::logic_error("sem_init error");
+    }
+}
+
+Semaphore::~Semaphore() {
+    sem_destroy(&m_semaphore);
+}
+
+void Semaphore::wait() {
+    // 被信号打断时继续等
+    while (sem_wait(&m_semaphore)) {
+        if (errno != EINTR) {
+            throw std::logic_error("sem_wait error");
+        }
+    }
+}
+
+void Semaphore::notify() {
+    if (sem_post(&m_semaphore)) {
+        throw std::logic_error("sem_post error");
+    }
+}
+
+} // namespace sylar
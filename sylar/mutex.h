@@ -0,0 +1,284 @@
+#ifndef __SYLAR_MUTEX_H__
+#define __SYLAR_MUTEX_H__
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdint.h>
+#include <atomic>
+#include "noncopyable.h"
+
+// 自旋等待时让出流水线，降低功耗，也让同核的另一个超线程跑得快一点
+#if defined __x86_64__ || defined __i386__
+#   define SYLAR_CPU_PAUSE()    __builtin_ia32_pause()
+#elif defined __aarch64__
+#   define SYLAR_CPU_PAUSE()    __asm__ __volatile__("yield" ::: "memory")
+#else
+#   define SYLAR_CPU_PAUSE()    do {} while (0)
+#endif
+
+namespace sylar
+{
+
+// 信号量
+class Semaphore : Noncopyable
+{
+public:
+    Semaphore(uint32_t count = 0);
+    ~Semaphore();
+
+    // 获取信号量，为 0 时阻塞
+    void wait();
+    // 释放信号量
+    void notify();
+private:
+    sem_t m_semaphore;
+};
+
+// 局部锁，构造时加锁，析构时解锁
+template<class T>
+struct ScopedLockImpl
+{
+public:
+    ScopedLockImpl(T& mutex)
+        :m_mutex(mutex) {
+        m_mutex.lock();
+        m_locked = true;
+    }
+
+    ~ScopedLockImpl() {
+        unlock();
+    }
+
+    void lock() {
+        if (!m_locked) {
+            m_mutex.lock();
+            m_locked = true;
+        }
+    }
+
+    void unlock() {
+        if (m_locked) {
+            m_mutex.unlock();
+            m_locked = false;
+        }
+    }
+private:
+    T& m_mutex;
+    bool m_locked;
+};
+
+// 局部读锁
+template<class T>
+struct ReadScopedLockImpl
+{
+public:
+    ReadScopedLockImpl(T& mutex)
+        :m_mutex(mutex) {
+        m_mutex.rdlock();
+        m_locked = true;
+    }
+
+    ~ReadScopedLockImpl() {
+        unlock();
+    }
+
+    void lock() {
+        if (!m_locked) {
+            m_mutex.rdlock();
+            m_locked = true;
+        }
+    }
+
+    void unlock() {
+        if (m_locked) {
+            m_mutex.unlock();
+            m_locked = false;
+        }
+    }
+private:
+    T& m_mutex;
+    bool m_locked;
+};
+
+// 局部写锁
+template<class T>
+struct WriteScopedLockImpl
+{
+public:
+    WriteScopedLockImpl(T& mutex)
+        :m_mutex(mutex) {
+        m_mutex.wrlock();
+        m_locked = true;
+    }
+
+    ~WriteScopedLockImpl() {
+        unlock();
+    }
+
+    void lock() {
+        if (!m_locked) {
+            m_mutex.wrlock();
+            m_locked = true;
+        }
+    }
+
+    void unlock() {
+        if (m_locked) {
+            m_mutex.unlock();
+            m_locked = false;
+        }
+    }
+private:
+    T& m_mutex;
+    bool m_locked;
+};
+
+// 互斥量
+class Mutex : Noncopyable
+{
+public:
+    typedef ScopedLockImpl<Mutex> Lock;
+
+    Mutex() {
+        pthread_mutex_init(&m_mutex, nullptr);
+    }
+
+    ~Mutex() {
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    void lock() {
+        pthread_mutex_lock(&m_mutex);
+    }
+
+    void unlock() {
+        pthread_mutex_unlock(&m_mutex);
+    }
+private:
+    pthread_mutex_t m_mutex;
+};
+
+// 空锁，单线程时替换掉真正的锁，加解锁都是空函数，编译后没有开销
+class NullMutex : Noncopyable
+{
+public:
+    typedef ScopedLockImpl<NullMutex> Lock;
+    void lock() {}
+    void unlock() {}
+};
+
+// 读写锁，读多写少时用
+class RWMutex : Noncopyable
+{
+public:
+    typedef ReadScopedLockImpl<RWMutex> ReadLock;
+    typedef WriteScopedLockImpl<RWMutex> WriteLock;
+
+    RWMutex() {
+        pthread_rwlock_init(&m_lock, nullptr);
+    }
+
+    ~RWMutex() {
+        pthread_rwlock_destroy(&m_lock);
+    }
+
+    void rdlock() {
+        pthread_rwlock_rdlock(&m_lock);
+    }
+
+    void wrlock() {
+        pthread_rwlock_wrlock(&m_lock);
+    }
+
+    void unlock() {
+        pthread_rwlock_unlock(&m_lock);
+    }
+private:
+    pthread_rwlock_t m_lock;
+};
+
+// 空读写锁
+class NullRWMutex : Noncopyable
+{
+public:
+    typedef ReadScopedLockImpl<NullRWMutex> ReadLock;
+    typedef WriteScopedLockImpl<NullRWMutex> WriteLock;
+    void rdlock() {}
+    void wrlock() {}
+    void unlock() {}
+};
+
+// 自旋锁，临界区很短时用
+// 等锁时先只读（不抢缓存行），每轮 pause 的次数翻倍，超过上限后 sched_yield 让出 CPU
+class Spinlock : Noncopyable
+{
+public:
+    typedef ScopedLockImpl<Spinlock> Lock;
+
+    Spinlock()
+        :m_locked(false) {
+    }
+
+    void lock() {
+        uint32_t spins = 1;
+        while (true) {
+            if (!m_locked.load(std::memory_order_relaxed)
+                    && !m_locked.exchange(true, std::memory_order_acquire)) {
+                return;
+            }
+            if (spins <= s_max_spins) {
+                for (uint32_t i = 0; i < spins; ++i) {
+                    SYLAR_CPU_PAUSE();
+                }
+                spins <<= 1;
+            } else {
+                sched_yield();
+            }
+        }
+    }
+
+    void unlock() {
+        m_locked.store(false, std::memory_order_release);
+    }
+private:
+    static const uint32_t s_max_spins = 64;
+    std::atomic<bool> m_locked;
+};
+
+// 原子锁，一直 test_and_set 直到成功，没有退避，用来和 Spinlock 对比
+class CASLock : Noncopyable
+{
+public:
+    typedef ScopedLockImpl<CASLock> Lock;
+
+    CASLock() {
+        m_mutex.clear();
+    }
+
+    void lock() {
+        while (std::atomic_flag_test_and_set_explicit(&m_mutex, std::memory_order_acquire));
+    }
+
+    void unlock() {
+        std::atomic_flag_clear_explicit(&m_mutex, std::memory_order_release);
+    }
+private:
+    volatile std::atomic_flag m_mutex;
+};
+
+// 日志、配置等组件用的锁
+// 定义 SYLAR_SINGLE_THREAD（cmake -DSYLAR_SINGLE_THREAD=ON）时全部换成空锁，单线程程序没有加锁开销
+// 这时库自己也不起后台线程：压缩写文件在调用线程里做，UDP 不起定时发送线程，
+// 不支持 log.metrics.dump_interval、守护进程的控制线程和 sylar_coro
+#ifdef SYLAR_SINGLE_THREAD
+typedef NullMutex DefaultMutex;
+typedef NullRWMutex DefaultRWMutex;
+#else
+typedef Spinlock DefaultMutex;
+typedef RWMutex DefaultRWMutex;
+#endif
+
+} // namespace sylar
+
+#endif // !__SYLAR_MUTEX_H__
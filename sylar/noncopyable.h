@@ -0,0 +1,19 @@
+#ifndef __SYLAR_NONCOPYABLE_H__
+#define __SYLAR_NONCOPYABLE_H__
+
+namespace sylar
+{
+
+// 继承它的类不能拷贝和赋值，比如锁、线程
+class Noncopyable
+{
+public:
+    Noncopyable() = default;
+    ~Noncopyable() = default;
+    Noncopyable(const Noncopyable&) = delete;
+    Noncopyable& operator=(const Noncopyable&) = delete;
+};
+
+} // namespace sylar
+
+#endif // !__SYLAR_NONCOPYABLE_H__
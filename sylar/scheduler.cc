@@ -0,0 +1,263 @@
+#include "scheduler.h"
+#include "macro.h"
+
+namespace sylar
+{
+
+static Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static thread_local Scheduler* t_scheduler = nullptr;
+static thread_local Fiber* t_scheduler_fiber = nullptr;    // 调度协程
+
+// YieldToHold(fn, arg) 登记的回调，切回调度协程后执行
+static thread_local void (*t_after_switch_fn)(void*) = nullptr;
+static thread_local void* t_after_switch_arg = nullptr;
+
+Scheduler::Scheduler(size_t threads, bool use_caller, const std::string& name)
+    :m_name(name) {
+    SYLAR_ASSERT(threads > 0);
+
+    if (use_caller) {
+        sylar::Fiber::GetThis();
+        --threads;
+
+        SYLAR_ASSERT(GetThis() == nullptr);
+        t_scheduler = this;
+
+        m_rootFiber.reset(new Fiber(std::bind(&Scheduler::run, this), 0, true));
+
+        t_scheduler_fiber = m_rootFiber.get();
+        m_rootThread = sylar::GetThreadId();
+        m_threadIds.push_back(m_rootThread);
+    } else {
+        m_rootThread = -1;
+    }
+    m_threadCount = threads;
+}
+
+Scheduler::~Scheduler() {
+    SYLAR_ASSERT(m_stopping);
+    if (GetThis() == this) {
+        t_scheduler = nullptr;
+    }
+}
+
+Scheduler* Scheduler::GetThis() {
+    return t_scheduler;
+}
+
+Fiber* Scheduler::GetMainFiber() {
+    return t_scheduler_fiber;
+}
+
+void Scheduler::start() {
+    MutexType::Lock lock(m_mutex);
+    if (!m_stopping) {
+        return;
+    }
+    m_stopping = false;
+    SYLAR_ASSERT(m_threads.empty());
+
+    m_threads.resize(m_threadCount);
+    for (size_t i = 0; i < m_threadCount; ++i) {
+        m_threads[i].reset(new Thread(std::bind(&Scheduler::run, this),
+                            m_name + "_" + std::to_string(i)));
+        m_threadIds.push_back(m_threads[i]->getId());
+    }
+}
+
+void Scheduler::stop() {
+    m_autoStop = true;
+    if (m_rootFiber && m_threadCount == 0
+            && (m_rootFiber->getState() == Fiber::TERM
+                || m_rootFiber->getState() == Fiber::INIT)) {
+        SYLAR_LOG_INFO(g_logger) << this << " stopped";
+        m_stopping = true;
+
+        if (stopping()) {
+            return;
+        }
+    }
+
+    if (m_rootThread != -1) {
+        SYLAR_ASSERT(GetThis() == this);
+    } else {
+        SYLAR_ASSERT(GetThis() != this);
+    }
+
+    m_stopping = true;
+    tickle(true);
+
+    if (m_rootFiber) {
+        if (!stopping()) {
+            m_rootFiber->call();
+        }
+    }
+
+    std::vector<Thread::ptr> thrs;
+    {
+        MutexType::Lock lock(m_mutex);
+        thrs.swap(m_threads);
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+}
+
+void Scheduler::setThis() {
+    t_scheduler = this;
+}
+
+void Scheduler::YieldToHold(void (*fn)(void*), void* arg) {
+    SYLAR_ASSERT2(GetThis() && t_scheduler_fiber != Fiber::GetThis().get(),
+                  "must be called in a scheduled fiber");
+    t_after_switch_fn = fn;
+    t_after_switch_arg = arg;
+    Fiber::YieldToHold();
+}
+
+void Scheduler::runAfterSwitch() {
+    if (t_after_switch_fn) {
+        auto fn = t_after_switch_fn;
+        t_after_switch_fn = nullptr;
+        fn(t_after_switch_arg);
+    }
+}
+
+bool Scheduler::hasTaskNoLock(int thread) {
+    for (auto& i : m_fibers) {
+        if (i.thread == -1 || i.thread == thread) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::run() {
+    setThis();
+    if (sylar::GetThreadId() != m_rootThread) {
+        t_scheduler_fiber = Fiber::GetThis().get();
+    }
+
+    Fiber::ptr idle_fiber(new Fiber(std::bind(&Scheduler::idle, this)));
+    Fiber::ptr cb_fiber;
+
+    FiberAndThread ft;
+    while (true) {
+        ft.reset();
+        bool tickle_me = false;
+        bool is_active = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            auto it = m_fibers.begin();
+            while (it != m_fibers.end()) {
+                if (it->thread != -1 && it->thread != sylar::GetThreadId()) {
+                    // 指定了别的线程
+                    ++it;
+                    tickle_me = true;
+                    continue;
+                }
+
+                SYLAR_ASSERT(it->fiber || it->cb);
+                ft = *it;
+                m_fibers.erase(it++);
+                ++m_activeThreadCount;
+                is_active = true;
+                break;
+            }
+            // 还有别的任务，有线程在等才需要唤醒
+            tickle_me = (tickle_me || it != m_fibers.end()) && m_waitingThreadCount > 0;
+        }
+
+        if (tickle_me) {
+            tickle(true);
+        }
+
+        if (ft.fiber && (ft.fiber->getState() != Fiber::TERM
+                        && ft.fiber->getState() != Fiber::EXCEPT)) {
+            ft.fiber->swapIn();
+            --m_activeThreadCount;
+
+            // HOLD 的协程可能在 runAfterSwitch 之后立刻被别的线程唤醒，状态只能在这之前看
+            if (ft.fiber->getState() == Fiber::READY) {
+                schedule(ft.fiber);
+            }
+            ft.reset();
+            runAfterSwitch();
+        } else if (ft.cb) {
+            if (cb_fiber) {
+                cb_fiber->reset(ft.cb);
+            } else {
+                cb_fiber.reset(new Fiber(ft.cb));
+            }
+            ft.reset();
+            cb_fiber->swapIn();
+            --m_activeThreadCount;
+            if (cb_fiber->getState() == Fiber::READY) {
+                schedule(cb_fiber);
+                cb_fiber.reset();
+            } else if (cb_fiber->getState() == Fiber::EXCEPT
+                    || cb_fiber->getState() == Fiber::TERM) {
+                // 执行完的协程留着复用栈
+                cb_fiber->reset(nullptr);
+            } else {
+                cb_fiber.reset();
+            }
+            runAfterSwitch();
+        } else {
+            if (is_active) {
+                --m_activeThreadCount;
+                continue;
+            }
+            if (idle_fiber->getState() == Fiber::TERM) {
+                SYLAR_LOG_DEBUG(g_logger) << "idle fiber term";
+                break;
+            }
+
+            ++m_idleThreadCount;
+            idle_fiber->swapIn();
+            --m_idleThreadCount;
+            continue;
+        }
+
+        if (m_stopping && m_activeThreadCount == 0) {
+            // 停止中最后一个干活的线程结束了，叫醒等着的线程检查能不能退出
+            tickle(true);
+        }
+    }
+}
+
+void Scheduler::tickle(bool all) {
+    // 加锁保证等待的线程要么还没检查队列，要么已经在条件变量上等，不会漏掉通知
+    MutexType::Lock lock(m_mutex);
+    if (all) {
+        m_cond.notify_all();
+    } else {
+        m_cond.notify_one();
+    }
+}
+
+bool Scheduler::stopping() {
+    MutexType::Lock lock(m_mutex);
+    return m_autoStop && m_stopping
+        && m_fibers.empty() && m_activeThreadCount == 0;
+}
+
+void Scheduler::idle() {
+    int thread = sylar::GetThreadId();
+    while (!stopping()) {
+        {
+            MutexType::Lock lock(m_mutex);
+            bool can_stop = m_autoStop && m_stopping
+                && m_fibers.empty() && m_activeThreadCount == 0;
+            if (!can_stop && !hasTaskNoLock(thread)) {
+                ++m_waitingThreadCount;
+                m_cond.wait(lock);
+                --m_waitingThreadCount;
+            }
+        }
+        Fiber::YieldToHold();
+    }
+}
+
+} // namespace sylar
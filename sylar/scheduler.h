@@ -0,0 +1,155 @@
+#ifndef __SYLAR_SCHEDULER_H__
+#define __SYLAR_SCHEDULER_H__
+
+#include <memory>
+#include <vector>
+#include <list>
+#include <string>
+#include <atomic>
+#include <condition_variable>
+#include "fiber.h"
+#include "thread.h"
+#include "mutex.h"
+
+namespace sylar
+{
+
+// 协程调度器，N 个线程执行 M 个协程
+// use_caller 为 true 时创建调度器的线程也参与调度（在 stop() 里执行）
+// 没有任务的线程在 idle 协程里等条件变量，schedule 时唤醒
+class Scheduler
+{
+public:
+    typedef std::shared_ptr<Scheduler> ptr;
+    typedef Mutex MutexType;
+
+    Scheduler(size_t threads = 1, bool use_caller = true, const std::string& name = "scheduler");
+    virtual ~Scheduler();
+
+    const std::string& getName() const { return m_name;}
+
+    // 当前线程所在的调度器
+    static Scheduler* GetThis();
+    // 当前线程的调度协程
+    static Fiber* GetMainFiber();
+
+    void start();
+    // 等所有任务执行完再返回
+    void stop();
+
+    // 调度一个协程或者函数，thread 不为 -1 时只在 tid 为 thread 的线程上执行
+    template<class FiberOrCb>
+    void schedule(FiberOrCb fc, int thread = -1) {
+        bool need_tickle = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            need_tickle = scheduleNoLock(fc, thread);
+        }
+        if (need_tickle) {
+            tickle(thread != -1);
+        }
+    }
+
+    // 批量调度，只加一次锁
+    template<class InputIterator>
+    void schedule(InputIterator begin, InputIterator end) {
+        bool need_tickle = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            while (begin != end) {
+                need_tickle = scheduleNoLock(&*begin, -1) || need_tickle;
+                ++begin;
+            }
+        }
+        if (need_tickle) {
+            tickle(true);
+        }
+    }
+
+    // 挂起当前协程，切回调度协程之后再调用 fn(arg)
+    // 协程同步原语用它在协程真正切出去之后才释放等待队列的锁，
+    // 否则别的线程可能在协程还没切出去时就把它唤醒执行
+    static void YieldToHold(void (*fn)(void*), void* arg);
+protected:
+    // 唤醒等任务的线程，all 为 true 时全部唤醒（任务指定了线程时，不知道该唤醒谁）
+    virtual void tickle(bool all = false);
+    // 调度循环，每个线程执行一份
+    void run();
+    // 是否可以结束
+    virtual bool stopping();
+    // 没有任务时执行
+    virtual void idle();
+
+    void setThis();
+
+    bool hasIdleThreads() { return m_idleThreadCount > 0;}
+private:
+    template<class FiberOrCb>
+    bool scheduleNoLock(FiberOrCb fc, int thread) {
+        FiberAndThread ft(fc, thread);
+        if (ft.fiber || ft.cb) {
+            m_fibers.push_back(ft);
+        }
+        // 有线程在等任务才需要唤醒
+        return m_waitingThreadCount > 0;
+    }
+
+    // 队列里有没有线程 thread 能执行的任务，需要持有 m_mutex
+    bool hasTaskNoLock(int thread);
+    // 调用 YieldToHold(fn, arg) 登记的回调
+    static void runAfterSwitch();
+private:
+    struct FiberAndThread {
+        Fiber::ptr fiber;
+        std::function<void()> cb;
+        int thread;
+
+        FiberAndThread(Fiber::ptr f, int thr)
+            :fiber(f), thread(thr) {
+        }
+
+        FiberAndThread(Fiber::ptr* f, int thr)
+            :thread(thr) {
+            fiber.swap(*f);
+        }
+
+        FiberAndThread(std::function<void()> f, int thr)
+            :cb(f), thread(thr) {
+        }
+
+        FiberAndThread(std::function<void()>* f, int thr)
+            :thread(thr) {
+            cb.swap(*f);
+        }
+
+        FiberAndThread()
+            :thread(-1) {
+        }
+
+        void reset() {
+            fiber = nullptr;
+            cb = nullptr;
+            thread = -1;
+        }
+    };
+private:
+    MutexType m_mutex;
+    std::condition_variable_any m_cond;     // 等任务的线程在这上面等
+    std::vector<Thread::ptr> m_threads;
+    std::list<FiberAndThread> m_fibers;     // 待执行的任务
+    Fiber::ptr m_rootFiber;                 // use_caller 时 caller 线程的调度协程
+    std::string m_name;
+protected:
+    std::vector<int> m_threadIds;
+    size_t m_threadCount = 0;
+    std::atomic<size_t> m_activeThreadCount {0};
+    std::atomic<size_t> m_idleThreadCount {0};
+    size_t m_waitingThreadCount = 0;        // 在条件变量上等的线程数，由 m_mutex 保护
+    std::atomic<bool> m_stopping {true};
+    std::atomic<bool> m_autoStop {false};
+    int m_rootThread = 0;                   // use_caller 时 caller 线程的 tid
+};
+
+} // namespace sylar
+
+#endif // !__SYLAR_SCHEDULER_H__
@@ -1,6 +1,8 @@
 #ifndef __SYLAR_SINGLETON_H__
 #define __SYLAR_SINGLETON_H__
 
+#include <memory>
+
 namespace sylar
 {
 
@@ -0,0 +1,280 @@
+#include "stack_allocator.h"
+#include "config.h"
+#include "log.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#include <vector>
+
+namespace sylar
+{
+
+static Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static ConfigVar<uint32_t>::ptr g_fiber_stack_size =
+    Config::Lookup<uint32_t>("fiber.stack_size", 128 * 1024, "fiber stack size");
+
+static ConfigVar<std::string>::ptr g_fiber_stack_allocator =
+    Config::Lookup<std::string>("fiber.stack_allocator", "pool", "fiber stack allocator: malloc, mmap, pool");
+
+static ConfigVar<uint32_t>::ptr g_fiber_stack_pool_size =
+    Config::Lookup<uint32_t>("fiber.stack_pool_size", 64, "max cached fiber stacks per thread");
+
+// 配置 fiber.stack_pool_size，变化时更新
+static std::atomic<uint32_t> s_pool_max {64};
+
+static std::atomic<uint64_t> s_in_use_bytes {0};
+static std::atomic<uint64_t> s_pooled_bytes {0};
+static std::atomic<uint64_t> s_peak_bytes {0};
+static std::atomic<uint64_t> s_stacks {0};
+
+static void UpdatePeak() {
+    uint64_t cur = s_in_use_bytes + s_pooled_bytes;
+    uint64_t peak = s_peak_bytes;
+    while (cur > peak && !s_peak_bytes.compare_exchange_weak(peak, cur));
+}
+
+static size_t GetPageSize() {
+    static size_t s_page_size = sysconf(_SC_PAGESIZE);
+    return s_page_size;
+}
+
+static size_t RoundToPage(size_t size) {
+    size_t page = GetPageSize();
+    return (size + page - 1) / page * page;
+}
+
+class MallocStackAllocator : public StackAllocator
+{
+public:
+    void* alloc(size_t size) override {
+        void* p = malloc(size);
+        if (p) {
+            s_in_use_bytes += size;
+            ++s_stacks;
+            UpdatePeak();
+        }
+        return p;
+    }
+
+    void dealloc(void* vp, size_t size) override {
+        if (vp) {
+            free(vp);
+            s_in_use_bytes -= size;
+            --s_stacks;
+        }
+    }
+
+    const char* getName() const override { return "malloc";}
+};
+
+class MmapStackAllocator : public StackAllocator
+{
+public:
+    void* alloc(size_t size) override {
+        void* p = Map(size);
+        if (p) {
+            s_in_use_bytes += RoundToPage(size) + GetPageSize();
+            ++s_stacks;
+            UpdatePeak();
+        }
+        return p;
+    }
+
+    void dealloc(void* vp, size_t size) override {
+        if (vp) {
+            Unmap(vp, size);
+            s_in_use_bytes -= RoundToPage(size) + GetPageSize();
+            --s_stacks;
+        }
+    }
+
+    size_t getGuardSize() const override { return GetPageSize();}
+    const char* getName() const override { return "mmap";}
+
+    // 映射 guard + size，低地址的一页设为 PROT_NONE，返回保护页之上的地址
+    static void* Map(size_t size) {
+        size_t page = GetPageSize();
+        size_t total = RoundToPage(size) + page;
+        void* p = mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            SYLAR_LOG_ERROR(g_logger) << "fiber stack mmap fail size=" << total
+                << " errno=" << errno << " errstr=" << strerror(errno);
+            return nullptr;
+        }
+        if (mprotect(p, page, PROT_NONE)) {
+            SYLAR_LOG_ERROR(g_logger) << "fiber stack mprotect fail errno=" << errno
+                << " errstr=" << strerror(errno);
+            munmap(p, total);
+            return nullptr;
+        }
+        return (char*)p + page;
+    }
+
+    static void Unmap(void* vp, size_t size) {
+        size_t page = GetPageSize();
+        munmap((char*)vp - page, RoundToPage(size) + page);
+    }
+};
+
+// 每个线程的空闲栈链表，线程退出时释放
+struct StackPool {
+    struct Item {
+        void* ptr;
+        size_t size;
+    };
+    std::vector<Item> items;
+
+    ~StackPool() {
+        for (auto& i : items) {
+            MmapStackAllocator::Unmap(i.ptr, i.size);
+            s_pooled_bytes -= RoundToPage(i.size) + GetPageSize();
+        }
+    }
+};
+
+static thread_local StackPool* t_stack_pool = nullptr;
+static thread_local bool t_stack_pool_destroyed = false;
+
+struct StackPoolHolder {
+    ~StackPoolHolder() {
+        delete t_stack_pool;
+        t_stack_pool = nullptr;
+        t_stack_pool_destroyed = true;
+    }
+};
+
+static thread_local StackPoolHolder t_stack_pool_holder;
+
+// 线程退出过程中（线程局部变量已经析构）返回 nullptr
+static StackPool* GetStackPool() {
+    if (!t_stack_pool && !t_stack_pool_destroyed) {
+        // 访问一下 holder，保证线程退出时会析构它
+        (void)&t_stack_pool_holder;
+        t_stack_pool = new StackPool;
+    }
+    return t_stack_pool;
+}
+
+class PoolStackAllocator : public StackAllocator
+{
+public:
+    void* alloc(size_t size) override {
+        StackPool* pool = GetStackPool();
+        if (pool) {
+            for (size_t i = pool->items.size(); i > 0; --i) {
+                auto& item = pool->items[i - 1];
+                if (item.size == size) {
+                    void* p = item.ptr;
+                    item = pool->items.back();
+                    pool->items.pop_back();
+                    uint64_t bytes = RoundToPage(size) + GetPageSize();
+                    s_pooled_bytes -= bytes;
+                    s_in_use_bytes += bytes;
+                    ++s_stacks;
+                    return p;
+                }
+            }
+        }
+        void* p = MmapStackAllocator::Map(size);
+        if (p) {
+            s_in_use_bytes += RoundToPage(size) + GetPageSize();
+            ++s_stacks;
+            UpdatePeak();
+        }
+        return p;
+    }
+
+    void dealloc(void* vp, size_t size) override {
+        if (!vp) {
+            return;
+        }
+        uint64_t bytes = RoundToPage(size) + GetPageSize();
+        s_in_use_bytes -= bytes;
+        --s_stacks;
+        StackPool* pool = GetStackPool();
+        if (pool && pool->items.size() < s_pool_max) {
+            pool->items.push_back({vp, size});
+            s_pooled_bytes += bytes;
+            return;
+        }
+        MmapStackAllocator::Unmap(vp, size);
+    }
+
+    size_t getGuardSize() const override { return GetPageSize();}
+    const char* getName() const override { return "pool";}
+};
+
+static MallocStackAllocator s_malloc_allocator;
+static MmapStackAllocator s_mmap_allocator;
+static PoolStackAllocator s_pool_allocator;
+
+// 配置变化时更新，创建协程时不用每次读配置
+static std::atomic<StackAllocator*> s_default_allocator {&s_pool_allocator};
+static std::atomic<size_t> s_default_stack_size {128 * 1024};
+
+StackAllocator* StackAllocator::Get(const std::string& name) {
+    if (name == "malloc") {
+        return &s_malloc_allocator;
+    } else if (name == "mmap") {
+        return &s_mmap_allocator;
+    } else if (name == "pool") {
+        return &s_pool_allocator;
+    }
+    return nullptr;
+}
+
+StackAllocator* StackAllocator::GetDefault() {
+    return s_default_allocator;
+}
+
+size_t StackAllocator::GetDefaultStackSize() {
+    return s_default_stack_size;
+}
+
+StackAllocator::Stats StackAllocator::GetStats() {
+    Stats s;
+    s.in_use_bytes = s_in_use_bytes;
+    s.pooled_bytes = s_pooled_bytes;
+    s.peak_bytes = s_peak_bytes;
+    s.stacks = s_stacks;
+    return s;
+}
+
+struct StackAllocatorIniter {
+    StackAllocatorIniter() {
+        g_fiber_stack_size->addListener([](const uint32_t& old_value, const uint32_t& new_value) {
+            // 太小的栈连日志都打不了
+            if (new_value < 16 * 1024) {
+                SYLAR_LOG_ERROR(g_logger) << "fiber.stack_size=" << new_value
+                    << " too small, keep " << s_default_stack_size;
+                return;
+            }
+            SYLAR_LOG_INFO(g_logger) << "fiber.stack_size changed from "
+                << old_value << " to " << new_value;
+            s_default_stack_size = new_value;
+        });
+        g_fiber_stack_allocator->addListener([](const std::string& old_value, const std::string& new_value) {
+            StackAllocator* a = StackAllocator::Get(new_value);
+            if (!a) {
+                SYLAR_LOG_ERROR(g_logger) << "fiber.stack_allocator=" << new_value
+                    << " unknown, keep " << s_default_allocator.load()->getName();
+                return;
+            }
+            SYLAR_LOG_INFO(g_logger) << "fiber.stack_allocator changed from "
+                << old_value << " to " << new_value;
+            s_default_allocator = a;
+        });
+        g_fiber_stack_pool_size->addListener([](const uint32_t& old_value, const uint32_t& new_value) {
+            s_pool_max = new_value;
+        });
+    }
+};
+
+static StackAllocatorIniter __stack_allocator_init;
+
+} // namespace sylar
@@ -0,0 +1,47 @@
+#ifndef __SYLAR_STACK_ALLOCATOR_H__
+#define __SYLAR_STACK_ALLOCATOR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace sylar
+{
+
+// 协程栈分配器
+// malloc：直接 malloc，栈溢出时悄悄踩坏相邻内存
+// mmap：每个栈单独 mmap，栈底（低地址）多映射一页 PROT_NONE 的保护页，溢出时立刻 SIGSEGV
+// pool：mmap 分配，释放的栈放进当前线程的空闲链表，下次同样大小的直接复用，省掉 mmap/munmap
+// 用哪个由配置 fiber.stack_allocator 决定，栈大小由 fiber.stack_size 决定
+class StackAllocator
+{
+public:
+    virtual ~StackAllocator() {}
+
+    // 返回栈的低地址，可用范围 [p, p + size)
+    virtual void* alloc(size_t size) = 0;
+    virtual void dealloc(void* vp, size_t size) = 0;
+    // 栈下面保护页的大小，没有保护页返回 0
+    virtual size_t getGuardSize() const { return 0;}
+    virtual const char* getName() const = 0;
+
+    // 按名称取分配器（malloc、mmap、pool），不认识的返回 nullptr
+    // 分配器是全局对象，不会析构，协程可以一直拿着创建时用的分配器
+    static StackAllocator* Get(const std::string& name);
+    // 配置 fiber.stack_allocator 指定的分配器
+    static StackAllocator* GetDefault();
+    // 配置 fiber.stack_size
+    static size_t GetDefaultStackSize();
+
+    struct Stats {
+        uint64_t in_use_bytes;  // 协程正在用的栈（含保护页）
+        uint64_t pooled_bytes;  // 各线程空闲链表里缓存的栈
+        uint64_t peak_bytes;    // in_use + pooled 的峰值
+        uint64_t stacks;        // 协程正在用的栈个数
+    };
+    static Stats GetStats();
+};
+
+} // namespace sylar
+
+#endif // !__SYLAR_STACK_ALLOCATOR_H__
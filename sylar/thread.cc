@@ -0,0 +1,190 @@
+#include "thread.h"
+#include "log.h"
+#include "util.h"
+#include "crash.h"
+#include <sched.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdexcept>
+#include <fstream>
+
+namespace sylar
+{
+
+static thread_local Thread* t_thread = nullptr;
+static thread_local std::string t_thread_name;
+static thread_local bool t_thread_name_inited = false;
+
+static Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 内核里的线程名最多 15 个字符
+static void SetKernelName(pthread_t thread, const std::string& name) {
+    pthread_setname_np(thread, name.substr(0, 15).c_str());
+}
+
+static bool SetAffinity(pthread_t thread, const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto& i : cpus) {
+        if (i >= 0 && i < CPU_SETSIZE) {
+            CPU_SET(i, &set);
+        }
+    }
+    int rt = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (rt) {
+        SYLAR_LOG_ERROR(g_logger) << "pthread_setaffinity_np fail rt=" << rt
+            << " errstr=" << strerror(rt);
+        return false;
+    }
+    return true;
+}
+
+Thread::Thread(std::function<void()> cb, const std::string& name, const std::vector<int>& cpus)
+    :m_cb(cb)
+    ,m_name(name.empty() ? "UNKNOW" : name)
+    ,m_cpus(cpus) {
+    int rt = pthread_create(&m_thread, nullptr, &Thread::run, this);
+    if (rt) {
+        SYLAR_LOG_ERROR(g_logger) << "pthread_create fail rt=" << rt
+            << " name=" << m_name;
+        throw std::logic_error("pthread_create error");
+    }
+    m_semaphore.wait();
+}
+
+Thread::~Thread() {
+    if (m_thread) {
+        pthread_detach(m_thread);
+    }
+}
+
+void Thread::join() {
+    if (m_thread) {
+        int rt = pthread_join(m_thread, nullptr);
+        if (rt) {
+            SYLAR_LOG_ERROR(g_logger) << "pthread_join fail rt=" << rt
+                << " name=" << m_name;
+            throw std::logic_error("pthread_join error");
+        }
+        m_thread = 0;
+    }
+}
+
+bool Thread::setAffinity(const std::vector<int>& cpus) {
+    if (!m_thread) {
+        return false;
+    }
+    return SetAffinity(m_thread, cpus);
+}
+
+bool Thread::setNumaNode(int node) {
+    std::vector<int> cpus;
+    if (!GetNumaNodeCpus(node, cpus)) {
+        SYLAR_LOG_ERROR(g_logger) << "setNumaNode invalid node=" << node
+            << " name=" << m_name;
+        return false;
+    }
+    return setAffinity(cpus);
+}
+
+Thread* Thread::GetThis() {
+    return t_thread;
+}
+
+const std::string& Thread::GetName() {
+    if (!t_thread_name_inited) {
+        char buf[16] = {0};
+        if (pthread_getname_np(pthread_self(), buf, sizeof(buf)) == 0 && buf[0]) {
+            t_thread_name = buf;
+        } else {
+            t_thread_name = "UNKNOW";
+        }
+        t_thread_name_inited = true;
+    }
+    return t_thread_name;
+}
+
+void Thread::SetName(const std::string& name) {
+    if (name.empty()) {
+        return;
+    }
+    if (t_thread) {
+        t_thread->m_name = name;
+    }
+    t_thread_name = name;
+    t_thread_name_inited = true;
+    SetKernelName(pthread_self(), name);
+}
+
+bool Thread::SetCurrentAffinity(const std::vector<int>& cpus) {
+    return SetAffinity(pthread_self(), cpus);
+}
+
+int Thread::GetNumaNodeCount() {
+    int count = 0;
+    std::vector<int> cpus;
+    while (GetNumaNodeCpus(count, cpus)) {
+        ++count;
+    }
+    return count ? count : 1;
+}
+
+bool Thread::GetNumaNodeCpus(int node, std::vector<int>& cpus) {
+    cpus.clear();
+    if (node < 0) {
+        return false;
+    }
+    // cpulist 的格式：0-3,8-11
+    std::ifstream ifs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!ifs || !std::getline(ifs, list)) {
+        return false;
+    }
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        int begin_cpu = 0;
+        int end_cpu = 0;
+        int n = sscanf(list.substr(pos, end - pos).c_str(), "%d-%d", &begin_cpu, &end_cpu);
+        if (n == 1) {
+            end_cpu = begin_cpu;
+        }
+        if (n >= 1) {
+            for (int i = begin_cpu; i <= end_cpu; ++i) {
+                cpus.push_back(i);
+            }
+        }
+        pos = end + 1;
+    }
+    return !cpus.empty();
+}
+
+void* Thread::run(void* arg) {
+    Thread* thread = (Thread*)arg;
+    t_thread = thread;
+    t_thread_name = thread->m_name;
+    t_thread_name_inited = true;
+    thread->m_id = GetThreadId();
+    SetKernelName(pthread_self(), thread->m_name);
+    if (!thread->m_cpus.empty()) {
+        SetAffinity(pthread_self(), thread->m_cpus);
+    }
+    InstallAltSignalStack();
+
+    std::function<void()> cb;
+    cb.swap(thread->m_cb);
+
+    // 通知之后构造函数返回，Thread 对象可能被销毁，下面不能再用 thread
+    thread->m_semaphore.notify();
+
+    cb();
+    return 0;
+}
+
+} // namespace sylar
@@ -0,0 +1,65 @@
+#ifndef __SYLAR_THREAD_H__
+#define __SYLAR_THREAD_H__
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include "mutex.h"
+
+namespace sylar
+{
+
+// 线程
+// 构造时创建线程，等新线程设置好名称、tid、CPU 亲和性之后构造函数才返回，
+// 所以构造完 getId() 一定是有效的
+// 线程名通过 pthread_setname_np 设置，top -H、gdb 里能看到，日志格式里加 %N 输出（默认格式不带）
+class Thread : Noncopyable
+{
+public:
+    typedef std::shared_ptr<Thread> ptr;
+    // name 内核最多保留 15 个字符，更长的只截断内核里的名称，GetName() 还是完整的
+    // cpus 不为空时线程在执行 cb 之前先绑定到这些 CPU 上
+    Thread(std::function<void()> cb, const std::string& name, const std::vector<int>& cpus = {});
+    // 没有 join 的线程会被 detach
+    ~Thread();
+
+    pid_t getId() const { return m_id;}
+    const std::string& getName() const { return m_name;}
+
+    void join();
+
+    // 把线程绑定到 cpus 上，线程运行中也可以调用
+    bool setAffinity(const std::vector<int>& cpus);
+    // 把线程绑定到 NUMA 节点 node 的所有 CPU 上
+    bool setNumaNode(int node);
+
+    // 当前线程，不是 Thread 创建的线程返回 nullptr
+    static Thread* GetThis();
+    // 当前线程的名称，不是 Thread 创建的线程取内核里的名称（主线程就是进程名）
+    static const std::string& GetName();
+    // 设置当前线程的名称，主线程之类不是 Thread 创建的线程也可以用
+    static void SetName(const std::string& name);
+
+    // 把当前线程绑定到 cpus 上
+    static bool SetCurrentAffinity(const std::vector<int>& cpus);
+    // NUMA 节点数，读 /sys/devices/system/node，没有 NUMA 信息时返回 1
+    static int GetNumaNodeCount();
+    // NUMA 节点 node 上的 CPU 列表，节点不存在返回 false
+    static bool GetNumaNodeCpus(int node, std::vector<int>& cpus);
+private:
+    static void* run(void* arg);
+private:
+    pid_t m_id = -1;
+    pthread_t m_thread = 0;
+    std::function<void()> m_cb;
+    std::string m_name;
+    std::vector<int> m_cpus;
+    Semaphore m_semaphore;      // 新线程跑起来之后通知构造函数返回
+};
+
+} // namespace sylar
+
+#endif // !__SYLAR_THREAD_H__
@@ -1,18 +1,139 @@
 #include "util.h"
+#include "fiber.h"
+#include <dirent.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <execinfo.h>
+#include <stdlib.h>
+#include <sys/time.h>
 
 namespace sylar
 {
 
+// 线程id缓存在线程局部变量里，只在第一次取的时候做一次系统调用
+static thread_local pid_t t_thread_id = 0;
+
+// fork 出来的子进程里调用 fork 的线程 tid 变了，清掉缓存
+static void ResetThreadIdAfterFork() {
+    t_thread_id = 0;
+}
+
+struct ThreadIdForkIniter {
+    ThreadIdForkIniter() {
+        pthread_atfork(nullptr, nullptr, &ResetThreadIdAfterFork);
+    }
+};
+
+static ThreadIdForkIniter s_thread_id_fork_initer;
+
 pid_t GetThreadId() {   // 获取线程id
-    return syscall(SYS_gettid);
+    if (!t_thread_id) {
+        t_thread_id = syscall(SYS_gettid);
+    }
+    return t_thread_id;
 }
 
-uint32_t GetFiberId() { // 获取协程id，现在还没有实现协程，则默认返回0
-    return 0;   
+uint32_t GetFiberId() { // 获取协程id，不在协程里返回0
+    return sylar::Fiber::GetFiberId();
 }
 
-    
-} // namespace sylar
+uint64_t GetCurrentMS() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000ul + tv.tv_usec / 1000;
+}
+
+uint64_t GetCurrentUS() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000 * 1000ul + tv.tv_usec;
+}
+
+// backtrace_symbols 的格式为 module(mangled+offset) [addr]，把 mangled 部分 demangle
+static std::string demangle(const char* str) {
+    std::string line(str);
+    size_t begin = line.find('(');
+    size_t end = line.find('+', begin);
+    if (begin == std::string::npos || end == std::string::npos || end == begin + 1) {
+        return line;
+    }
+    std::string mangled = line.substr(begin + 1, end - begin - 1);
+    int status = 0;
+    char* name = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    if (status != 0 || !name) {
+        return line;
+    }
+    std::string rt = line.substr(0, begin + 1) + name + line.substr(end);
+    free(name);
+    return rt;
+}
+
+void Backtrace(std::vector<std::string>& bt, int size, int skip) {
+    void** array = (void**)malloc(sizeof(void*) * size);
+    size_t s = ::backtrace(array, size);
+
+    char** strings = backtrace_symbols(array, s);
+    if (strings == NULL) {
+        free(array);
+        return;
+    }
 
+    for (size_t i = skip; i < s; ++i) {
+        bt.push_back(demangle(strings[i]));
+    }
 
+    free(strings);
+    free(array);
+}
+
+std::string BacktraceToString(int size, int skip, const std::string& prefix) {
+    std::vector<std::string> bt;
+    Backtrace(bt, size, skip);
+    std::stringstream ss;
+    for (size_t i = 0; i < bt.size(); ++i) {
+        ss << prefix << bt[i] << std::endl;
+    }
+    return ss.str();
+}
+
+static void ListAllFileImpl(std::vector<std::string>& files
+                            ,const std::string& path
+                            ,const std::string& subfix) {
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(dir)) != nullptr) {
+        if (dp->d_type == DT_DIR) {
+            if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, "..")) {
+                continue;
+            }
+            ListAllFileImpl(files, path + "/" + dp->d_name, subfix);
+        } else if (dp->d_type == DT_REG) {
+            std::string filename(dp->d_name);
+            if (subfix.empty()) {
+                files.push_back(path + "/" + filename);
+            } else {
+                if (filename.size() < subfix.size()) {
+                    continue;
+                }
+                if (filename.substr(filename.length() - subfix.size()) == subfix) {
+                    files.push_back(path + "/" + filename);
+                }
+            }
+        }
+    }
+    closedir(dir);
+}
+
+void FSUtil::ListAllFile(std::vector<std::string>& files
+                        ,const std::string& path
+                        ,const std::string& subfix) {
+    ListAllFileImpl(files, path, subfix);
+    // readdir 的顺序不固定，排序后加载顺序才稳定
+    std::sort(files.begin(), files.end());
+}
     
+} // namespace sylar
@@ -7,6 +7,10 @@
 #include <sys/syscall.h>
 #include <stdio.h>
 #include <stdint.h>     
+#include <cxxabi.h>
+#include <typeinfo>
+#include <string>
+#include <vector>
 
 namespace sylar
 {
@@ -14,6 +18,37 @@ namespace sylar
 pid_t GetThreadId();        // 获取线程id
 uint32_t GetFiberId();      // 获取协程id
 
+uint64_t GetCurrentMS();    // 当前时间，毫秒
+uint64_t GetCurrentUS();    // 当前时间，微秒
+
+// 获取当前的调用栈，函数名已 demangle
+// size 最多取多少层，skip 跳过最上面几层（Backtrace 自己算一层）
+void Backtrace(std::vector<std::string>& bt, int size = 64, int skip = 1);
+// 调用栈转成字符串，每层一行，prefix 为每行的前缀
+std::string BacktraceToString(int size = 64, int skip = 2, const std::string& prefix = "");
+
+// 获取类型的可读名称（demangle 之后的），每个类型只转换一次
+// demangle 失败时退回 typeid(T).name()，不会返回空指针
+template<class T>
+const char* TypeToName() {
+    static const char* s_name = []() {
+        int status = 0;
+        const char* name = abi::__cxa_demangle(typeid(T).name(), nullptr, nullptr, &status);
+        return status == 0 && name ? name : typeid(T).name();
+    }();
+    return s_name;
+}
+
+// 文件系统相关工具
+class FSUtil
+{
+public:
+    // 递归列出 path 下所有以 subfix 结尾的文件，结果按路径排序
+    static void ListAllFile(std::vector<std::string>& files
+                            ,const std::string& path
+                            ,const std::string& subfix);
+};
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "../sylar/fiber_sync.h"
+#include <time.h>
+#include <iostream>
+#include <fstream>
+#include <deque>
+#include <condition_variable>
+#include <thread>
+
+// 生产者消费者基准：同样的有界队列，一种是线程 + 阻塞锁/条件变量，
+// 一种是调度器上的协程 + Channel（等待时挂起协程，不阻塞线程）
+// 结果输出为 JSON，用法：bench_fiber_sync [输出文件]，不给文件则输出到 stdout
+
+struct BenchResult {
+    std::string name;
+    int pairs;              // 生产者、消费者各多少个
+    int workers;            // 线程数（协程模式下是调度线程数）
+    uint64_t messages;
+    double ns_per_msg;
+};
+
+static std::vector<BenchResult> s_results;
+
+static const size_t s_capacity = 64;
+static const uint64_t s_messages = 200000;
+
+static uint64_t GetCurrentNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static void AddResult(const std::string& name, int pairs, int workers, uint64_t used) {
+    double ns = (double)used / s_messages;
+    s_results.push_back({name, pairs, workers, s_messages, ns});
+    std::cerr << name << " pairs=" << pairs << " workers=" << workers
+              << " " << ns << " ns/msg" << std::endl;
+}
+
+// 线程阻塞版本的有界队列
+class BlockingQueue
+{
+public:
+    void push(int v) {
+        sylar::Mutex::Lock lock(m_mutex);
+        while (m_queue.size() >= s_capacity) {
+            m_notFull.wait(lock);
+        }
+        m_queue.push_back(v);
+        m_notEmpty.notify_one();
+    }
+
+    bool pop(int& v) {
+        sylar::Mutex::Lock lock(m_mutex);
+        while (m_queue.empty() && !m_closed) {
+            m_notEmpty.wait(lock);
+        }
+        if (m_queue.empty()) {
+            return false;
+        }
+        v = m_queue.front();
+        m_queue.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        sylar::Mutex::Lock lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+    }
+private:
+    sylar::Mutex m_mutex;
+    std::condition_variable_any m_notFull;
+    std::condition_variable_any m_notEmpty;
+    std::deque<int> m_queue;
+    bool m_closed = false;
+};
+
+static void RunThreads(int pairs) {
+    BlockingQueue queue;
+    uint64_t per = s_messages / pairs;
+    std::atomic<int> producing {pairs};
+    std::atomic<uint64_t> received {0};
+    uint64_t begin = GetCurrentNS();
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < pairs; ++i) {
+        thrs.push_back(sylar::Thread::ptr(new sylar::Thread([&]() {
+            for (uint64_t j = 0; j < per; ++j) {
+                queue.push(j);
+            }
+            if (--producing == 0) {
+                queue.close();
+            }
+        }, "producer")));
+        thrs.push_back(sylar::Thread::ptr(new sylar::Thread([&]() {
+            int v;
+            while (queue.pop(v)) {
+                ++received;
+            }
+        }, "consumer")));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    AddResult("thread_blocking", pairs, pairs * 2, GetCurrentNS() - begin);
+}
+
+static void RunFibers(int pairs, int workers) {
+    sylar::Channel<int> chan(s_capacity);
+    uint64_t per = s_messages / pairs;
+    std::atomic<int> producing {pairs};
+    std::atomic<uint64_t> received {0};
+    uint64_t begin = GetCurrentNS();
+    sylar::Scheduler sc(workers, false, "bench");
+    sc.start();
+    for (int i = 0; i < pairs; ++i) {
+        // 协程多的时候栈给小一点
+        sc.schedule(sylar::Fiber::ptr(new sylar::Fiber([&]() {
+            for (uint64_t j = 0; j < per; ++j) {
+                chan.push(j);
+            }
+            if (--producing == 0) {
+                chan.close();
+            }
+        }, 64 * 1024)));
+        sc.schedule(sylar::Fiber::ptr(new sylar::Fiber([&]() {
+            int v;
+            while (chan.pop(v)) {
+                ++received;
+            }
+        }, 64 * 1024)));
+    }
+    sc.stop();
+    AddResult("fiber_channel", pairs, workers, GetCurrentNS() - begin);
+}
+
+static void DumpJson(std::ostream& os) {
+    os << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < s_results.size(); ++i) {
+        auto& r = s_results[i];
+        os << "    {\"name\": \"" << r.name << "\", \"pairs\": " << r.pairs
+           << ", \"workers\": " << r.workers
+           << ", \"messages\": " << r.messages
+           << ", \"ns_per_msg\": " << r.ns_per_msg << "}"
+           << (i + 1 == s_results.size() ? "\n" : ",\n");
+    }
+    os << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    // 线程数太多时创建线程本身就很慢，线程版本只测到 256 对
+    for (int pairs : {1, 4, 16, 64, 256}) {
+        RunThreads(pairs);
+    }
+    for (int pairs : {1, 4, 16, 64, 256, 1024, 4096}) {
+        RunFibers(pairs, workers);
+    }
+
+    if (argc > 1) {
+        std::ofstream ofs(argv[1], std::ios::trunc);
+        DumpJson(ofs);
+    } else {
+        DumpJson(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include "../sylar/log.h"
+#include "../sylar/log_uring.h"
+#include <sys/time.h>
+#include <thread>
+#include <fstream>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// 日志热路径的基准测试，结果输出为 JSON，便于不同版本之间对比
+// 用法：bench_log [输出文件]，不给文件则输出到 stdout
+
+struct BenchResult {
+    std::string name;
+    int threads;
+    uint64_t iterations;
+    double ns_per_op;
+    uint64_t file_bytes;        // 写文件的用例：文件大小
+    double compress_ns_per_mb;  // 压缩的用例：每 MB 原始日志的压缩耗时
+};
+
+static std::vector<BenchResult> s_results;
+
+static uint64_t GetCurrentNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+// 每个线程跑 iterations 次 cb，记录每次调用的平均耗时
+static void Run(const std::string& name, int threads, uint64_t iterations,
+                std::function<void()> cb) {
+    uint64_t begin = GetCurrentNS();
+    if (threads == 1) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            cb();
+        }
+    } else {
+        std::vector<std::thread> thrs;
+        for (int t = 0; t < threads; ++t) {
+            thrs.push_back(std::thread([iterations, cb]() {
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    cb();
+                }
+            }));
+        }
+        for (auto& t : thrs) {
+            t.join();
+        }
+    }
+    uint64_t used = GetCurrentNS() - begin;
+    // 多线程时按总调用次数平均，反映整体吞吐
+    double ns = (double)used / (iterations * threads);
+    s_results.push_back({name, threads, iterations, ns, 0, 0});
+    std::cerr << name << " threads=" << threads << " " << ns << " ns/op" << std::endl;
+}
+
+static sylar::Logger::ptr NewLogger(const std::string& name, const std::string& pattern) {
+    sylar::Logger::ptr logger(new sylar::Logger(name));
+    logger->setFormatter(pattern);
+    logger->addAppender(sylar::LogAppender::ptr(new sylar::NullLogAppender));
+    return logger;
+}
+
+// 写文件的appender，pattern 固定为最简，只比较写文件的开销
+static void RunFile(const std::string& name, const std::string& file, sylar::LogAppender::ptr appender) {
+    sylar::Logger::ptr logger(new sylar::Logger(name));
+    logger->setFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T[%p]%T[%c]%T%f:%l%T%m%n");
+    logger->addAppender(appender);
+    uint64_t seq = 0;
+    Run(name, 1, 1000000, [logger, &seq]() {
+        ++seq;
+        SYLAR_LOG_INFO(logger) << "request id=" << seq << " uid=" << seq % 9973
+            << " cost=" << seq % 137 << "ms some payload to make the line longer";
+    });
+    logger->flush();
+    // 压缩的 appender 后台写，flush 之后才是最终大小
+    struct stat st;
+    if (stat(file.c_str(), &st) == 0) {
+        s_results.back().file_bytes = st.st_size;
+    }
+    auto fa = std::dynamic_pointer_cast<sylar::FileLogAppender>(appender);
+    if (fa && fa->getRawBytes()) {
+        s_results.back().compress_ns_per_mb = (double)fa->getCompressNs() * 1024 * 1024 / fa->getRawBytes();
+    }
+    std::cerr << name << " file_bytes=" << s_results.back().file_bytes
+              << " compress_ns_per_mb=" << s_results.back().compress_ns_per_mb << std::endl;
+    unlink(file.c_str());
+}
+
+static void DumpJson(std::ostream& os) {
+    os << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < s_results.size(); ++i) {
+        auto& r = s_results[i];
+        os << "    {\"name\": \"" << r.name << "\", \"threads\": " << r.threads
+           << ", \"iterations\": " << r.iterations
+           << ", \"ns_per_op\": " << r.ns_per_op;
+        if (r.file_bytes) {
+            os << ", \"file_bytes\": " << r.file_bytes;
+        }
+        if (r.compress_ns_per_mb) {
+            os << ", \"compress_ns_per_mb\": " << r.compress_ns_per_mb;
+        }
+        os << "}"
+           << (i + 1 == s_results.size() ? "\n" : ",\n");
+    }
+    os << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    const uint64_t n = 200000;
+    sylar::Logger::ptr def = NewLogger("bench_default", "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n");
+    sylar::Logger::ptr min = NewLogger("bench_minimal", "%m%n");
+
+    sylar::Logger::ptr disabled = NewLogger("bench_disabled", "%m%n");
+    disabled->setLevel(sylar::LogLevel::ERROR);
+    Run("disabled_level", 1, n * 10, [disabled]() {
+        SYLAR_LOG_DEBUG(disabled) << "disabled " << 1;
+    });
+
+    Run("default_pattern_stream", 1, n, [def]() {
+        SYLAR_LOG_INFO(def) << "hello " << 42 << " world";
+    });
+    Run("minimal_pattern_stream", 1, n, [min]() {
+        SYLAR_LOG_INFO(min) << "hello " << 42 << " world";
+    });
+    Run("default_pattern_fmt", 1, n, [def]() {
+        SYLAR_LOG_FMT_INFO(def, "hello %d world", 42);
+    });
+    Run("minimal_pattern_fmt", 1, n, [min]() {
+        SYLAR_LOG_FMT_INFO(min, "hello %d world", 42);
+    });
+
+    sylar::Logger::ptr ring(new sylar::Logger("bench_ring"));
+    ring->setFormatter("%m%n");
+    ring->addAppender(sylar::LogAppender::ptr(new sylar::MemoryRingLogAppender(4096, 256)));
+    Run("memory_ring_stream", 1, n, [ring]() {
+        SYLAR_LOG_INFO(ring) << "hello " << 42 << " world";
+    });
+
+    // tmpfs 和当前目录所在的磁盘各跑一遍
+    std::vector<std::pair<std::string, std::string> > dirs = {
+        {"tmpfs", "/dev/shm/sylar_bench_log.txt"},
+        {"disk", "./sylar_bench_log.txt"}
+    };
+    for (auto& d : dirs) {
+        unlink(d.second.c_str());
+        RunFile("file_ofstream_" + d.first, d.second,
+                sylar::LogAppender::ptr(new sylar::FileLogAppender(d.second)));
+        RunFile("file_mmap_" + d.first, d.second,
+                sylar::LogAppender::ptr(new sylar::MmapFileLogAppender(d.second)));
+        unlink((d.second + ".000000").c_str());
+ // 压缩写：和 file_ofstream 对比文件大小和压缩耗时，没编译进来的算法跳过
+        for (auto& c : {"zstd", "lz4", "gzip"}) {
+            sylar::FileLogAppender::ptr fa(new sylar::FileLogAppender(d.second, c));
+            if (fa->getCompress() == c) {
+                RunFile(std::string("file_") + c + "_" + d.first, d.second, fa);
+            }
+        }
+#ifdef SYLAR_HAVE_LIBURING
+        RunFile("file_uring_" + d.first, d.second,
+                sylar::LogAppender::ptr(new sylar::UringFileLogAppender(d.second)));
+#endif
+    }
+
+    int max_threads = std::max(2u, std::thread::hardware_concurrency());
+    for (int t = 1; t <= max_threads; t *= 2) {
+        Run("contention_minimal_pattern", t, n / t, [min]() {
+            SYLAR_LOG_INFO(min) << "hello " << 42 << " world";
+        });
+    }
+
+    if (argc > 1) {
+        std::ofstream ofs(argv[1], std::ios::trunc);
+        DumpJson(ofs);
+    } else {
+        DumpJson(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "../sylar/mutex.h"
+#include <time.h>
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <functional>
+
+// 锁的竞争基准：每种锁在不同线程数、不同临界区长度下每次加解锁（含临界区）的平均耗时
+// 结果输出为 JSON，用法：bench_mutex [输出文件]，不给文件则输出到 stdout
+
+struct BenchResult {
+    std::string name;
+    int threads;
+    int work;               // 临界区里做多少次累加
+    uint64_t iterations;
+    double ns_per_op;
+};
+
+static std::vector<BenchResult> s_results;
+
+static uint64_t GetCurrentNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+// 临界区：对共享计数器做 work 次累加，volatile 防止被优化掉
+static volatile uint64_t s_counter = 0;
+
+static void Work(int work) {
+    for (int i = 0; i < work; ++i) {
+        s_counter = s_counter + 1;
+    }
+}
+
+template<class MutexType>
+static void Run(const std::string& name, int threads, int work, uint64_t iterations) {
+    MutexType mutex;
+    s_counter = 0;
+    uint64_t begin = GetCurrentNS();
+    std::vector<std::thread> thrs;
+    for (int t = 0; t < threads; ++t) {
+        thrs.push_back(std::thread([&mutex, work, iterations]() {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                typename MutexType::Lock lock(mutex);
+                Work(work);
+            }
+        }));
+    }
+    for (auto& t : thrs) {
+        t.join();
+    }
+    uint64_t used = GetCurrentNS() - begin;
+    double ns = (double)used / (iterations * threads);
+    s_results.push_back({name, threads, work, iterations, ns});
+    std::cerr << name << " threads=" << threads << " work=" << work
+              << " " << ns << " ns/op" << std::endl;
+}
+
+// 读写锁分别测读锁和写锁
+template<class RWMutexType>
+static void RunRead(const std::string& name, int threads, int work, uint64_t iterations) {
+    RWMutexType mutex;
+    uint64_t begin = GetCurrentNS();
+    std::vector<std::thread> thrs;
+    for (int t = 0; t < threads; ++t) {
+        thrs.push_back(std::thread([&mutex, work, iterations]() {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                typename RWMutexType::ReadLock lock(mutex);
+                // 读锁下不能写共享计数器，只空转
+                for (volatile int j = 0; j < work; ++j);
+            }
+        }));
+    }
+    for (auto& t : thrs) {
+        t.join();
+    }
+    uint64_t used = GetCurrentNS() - begin;
+    double ns = (double)used / (iterations * threads);
+    s_results.push_back({name, threads, work, iterations, ns});
+    std::cerr << name << " threads=" << threads << " work=" << work
+              << " " << ns << " ns/op" << std::endl;
+}
+
+struct RWMutexWrite : public sylar::RWMutex {
+    typedef sylar::RWMutex::WriteLock Lock;
+};
+
+static void DumpJson(std::ostream& os) {
+    os << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < s_results.size(); ++i) {
+        auto& r = s_results[i];
+        os << "    {\"name\": \"" << r.name << "\", \"threads\": " << r.threads
+           << ", \"work\": " << r.work
+           << ", \"iterations\": " << r.iterations
+           << ", \"ns_per_op\": " << r.ns_per_op << "}"
+           << (i + 1 == s_results.size() ? "\n" : ",\n");
+    }
+    os << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    const uint64_t n = 200000;
+    int max_threads = std::max(2u, std::thread::hardware_concurrency());
+    for (int work : {0, 10, 100, 1000}) {
+        // 临界区越长总次数越少，控制每组的运行时间
+        uint64_t iters = work >= 1000 ? n / 20 : (work >= 100 ? n / 4 : n);
+        for (int t = 1; t <= max_threads; t *= 2) {
+            if (t == 1) {
+                // 空锁只能单线程用，作为没有锁的基线
+                Run<sylar::NullMutex>("null_mutex", 1, work, iters);
+            }
+            Run<sylar::Mutex>("mutex", t, work, iters / t);
+            Run<sylar::Spinlock>("spinlock", t, work, iters / t);
+            Run<sylar::CASLock>("cas_lock", t, work, iters / t);
+            Run<RWMutexWrite>("rwmutex_write", t, work, iters / t);
+            RunRead<sylar::RWMutex>("rwmutex_read", t, work, iters / t);
+        }
+    }
+
+    if (argc > 1) {
+        std::ofstream ofs(argv[1], std::ios::trunc);
+        DumpJson(ofs);
+    } else {
+        DumpJson(std::cout);
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string.h>
 #include "../sylar/log.h"
 #include "../sylar/util.h"
 
@@ -28,8 +29,97 @@ int main(int argc, char** argv)
     SYLAR_LOG_FMT_ERROR(logger, "test macro fmt error %s", "aa");
     // SYLAR_LOG_FMT_ERROR(logger, "test macro fmt error %s", "aaaaa");
 
+    // 环形缓冲只保留最近的3条
+    sylar::MemoryRingLogAppender::ptr ring(new sylar::MemoryRingLogAppender(3, 128, true));
+    logger->addAppender(ring);
+    for (int i = 0; i < 5; ++i) {
+        SYLAR_LOG_INFO(logger) << "ring " << i;
+    }
+    std::cout << "ring dump:" << std::endl;
+    ring->dump(STDOUT_FILENO);
+    logger->delAppender(ring);
+
+    // 环形缓冲的个数没有上限，DumpAll 每个都能 dump 到
+    {
+        sylar::Logger::ptr many(new sylar::Logger("many_rings"));
+        std::vector<sylar::MemoryRingLogAppender::ptr> rings;
+        for (int i = 0; i < 20; ++i) {
+            rings.push_back(sylar::MemoryRingLogAppender::ptr(new sylar::MemoryRingLogAppender(1, 64, true)));
+            many->addAppender(rings.back());
+        }
+        SYLAR_LOG_INFO(many) << "many rings";
+        FILE* f = tmpfile();
+        sylar::MemoryRingLogAppender::DumpAll(fileno(f));
+        rewind(f);
+        int lines = 0;
+        char buf[128];
+        while (fgets(buf, sizeof(buf), f)) {
+            lines += strcmp(buf, "INFO many rings\n") == 0;
+        }
+        fclose(f);
+        std::cout << "DumpAll rings=" << lines << std::endl;
+        if (lines != 20) {
+            return 1;
+        }
+    }
+
+    // 按调用点限流
+    for (int i = 0; i < 10; ++i) {
+        SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::INFO, 4) << "every 4, i=" << i;
+        SYLAR_LOG_FIRST_N(logger, sylar::LogLevel::INFO, 2) << "first 2, i=" << i;
+        SYLAR_LOG_EVERY_MS(logger, sylar::LogLevel::INFO, 1000) << "every 1000ms, i=" << i;
+    }
+
+    // 按日志器限流：每秒1条，突发3条
+    logger->setRateLimit(sylar::TokenBucket::ptr(new sylar::TokenBucket(1, 3)));
+    for (int i = 0; i < 10; ++i) {
+        SYLAR_LOG_INFO(logger) << "rate limit, i=" << i;
+    }
+    sleep(1);
+    SYLAR_LOG_INFO(logger) << "rate limit after 1s";
+    logger->setRateLimit(nullptr);
+
+    // 结构化字段：文本格式用 %K，JSON格式直接输出
+    sylar::LogFormatter::ptr kv_fmt(new sylar::LogFormatter("%p%T%m%T%K%n"));
+    logger->setFormatter(kv_fmt);
+    SYLAR_LOG_INFO(logger).kv("uid", 10086).kv("name", "sylar cxy").kv("ok", true) << "test kv";
+    logger->setFormatter("json");
+    SYLAR_LOG_INFO(logger).kv("uid", 10086).kv("cost", 1.5).kv("path", std::string("/a\"b\n")) << "test json\t";
+    logger->setFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n");
+
     auto l = sylar::LoggerMgr::GetInstance()->getLogger("xx");
     SYLAR_LOG_ERROR(l) << "xxx";
 
+    // 分层日志器：net.http.server 继承 net 的级别，net 有 appender 后就不再走 root
+    auto net = SYLAR_LOG_NAME("net");
+    auto server = SYLAR_LOG_NAME("net.http.server");
+    net->setLevel(sylar::LogLevel::WARN);
+    SYLAR_LOG_INFO(server) << "should not print, level=" << sylar::LogLevel::ToString(server->getLevel());
+    SYLAR_LOG_WARN(server) << "warn from net.http.server via root";
+    net->addAppender(sylar::LogAppender::ptr(new sylar::StdoutLogAppender));
+    SYLAR_LOG_WARN(server) << "warn via net only";
+    net->setAdditive(true);
+    SYLAR_LOG_WARN(server) << "warn via net and root";
+    SYLAR_LOG_NAME("net.http")->setLevel(sylar::LogLevel::DEBUG);
+    SYLAR_LOG_DEBUG(server) << "debug after net.http set to DEBUG";
+
+    // 日志上下文：%X{key} 输出单个 key，%X 输出全部
+    logger->setFormatter("%p%T[%X{request_id}]%T%m%T%X%n");
+    sylar::LogContext::Put("request_id", "req-1");
+    {
+        sylar::LogContext::Scoped trace("trace_id", "abc123");
+        SYLAR_LOG_INFO(logger) << "with trace";
+        {
+            sylar::LogContext::Scoped req("request_id", "req-2");
+            SYLAR_LOG_INFO(logger) << "nested request";
+        }
+        SYLAR_LOG_INFO(logger) << "request restored";
+    }
+    SYLAR_LOG_INFO(logger) << "trace removed";
+    logger->setFormatter("json");
+    SYLAR_LOG_INFO(logger) << "json with context";
+    sylar::LogContext::Clear();
+    SYLAR_LOG_INFO(logger) << "json without context";
+
     return 0;
 }
\ No newline at end of file
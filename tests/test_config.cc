@@ -1,6 +1,9 @@
 #include "../sylar/config.h"
 #include "../sylar/log.h"
+#include "../sylar/env.h"
+#include "../sylar/macro.h"
 #include <yaml-cpp/yaml.h>
+#include <thread>
 
 sylar::ConfigVar<int>::ptr g_int_value_config = 
     sylar::Config::Lookup("system.port", (int)8080, "system port");
@@ -8,6 +11,11 @@ sylar::ConfigVar<int>::ptr g_int_value_config =
 sylar::ConfigVar<float>::ptr g_float_value_config = 
     sylar::Config::Lookup("system.value", (float)10.2f, "system value");
 
+// 配置文件在可执行文件旁边的 conf 目录，可以用 -c 指定
+static std::string GetLogConf() {
+    return sylar::EnvMgr::GetInstance()->getConfigPath() + "/log.yml";
+}
+
 // 遍历打印yaml
 void print_yaml(const YAML::Node& node, int level) {
     if (node.IsScalar()) {
@@ -30,15 +38,125 @@ void print_yaml(const YAML::Node& node, int level) {
 
 void test_yaml() {
     // 加载 yaml
-    YAML::Node root = YAML::LoadFile("/home/cxy/Projects/Sylar/bin/conf/log.yml");
+    YAML::Node root = YAML::LoadFile(GetLogConf());
     print_yaml(root, 0);
     // SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << root;
 }
 
+void test_config() {
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before: " << g_int_value_config->getValue();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "before: " << g_float_value_config->toString();
+
+    YAML::Node root = YAML::LoadFile(GetLogConf());
+    sylar::Config::LoadFromYaml(root);
+
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after: " << g_int_value_config->getValue();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "after: " << g_float_value_config->toString();
+}
+
+// 通过 logs 配置生成日志器
+void test_log() {
+    static sylar::Logger::ptr system_log = SYLAR_LOG_NAME("system");
+    SYLAR_LOG_INFO(system_log) << "hello system" << std::endl;
+    std::cout << sylar::LoggerMgr::GetInstance()->toYamlString() << std::endl;
+
+    YAML::Node root = YAML::LoadFile(GetLogConf());
+    sylar::Config::LoadFromYaml(root);
+    std::cout << "=============" << std::endl;
+    std::cout << sylar::LoggerMgr::GetInstance()->toYamlString() << std::endl;
+    SYLAR_LOG_INFO(system_log) << "hello system" << std::endl;
+
+    // 再加载一次，配置没变，日志器不会被重建
+    sylar::Config::LoadFromYaml(root);
+    system_log->setFormatter("%d - %m%n");
+    SYLAR_LOG_INFO(system_log) << "hello system" << std::endl;
+}
+
+// 缓存句柄后再取值不需要再查表
+void test_handle() {
+    static sylar::ConfigHandle<int> s_port("system.port");
+    int sum = 0;
+    for (int i = 0; i < 1000; ++i) {
+        sum += s_port->getValue();
+    }
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "handle " << s_port.getName() << " sum=" << sum;
+
+    // 类型不一致拿不到
+    auto v = sylar::Config::Lookup<float>("system.port");
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "Lookup<float>(system.port)=" << v;
+}
+
+// 同名不同类型：返回 nullptr，Validate 时报告出来
+void test_validate() {
+    auto v = sylar::Config::Lookup("system.port", (float)8080.0f, "system port");
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "Lookup(system.port, float)=" << v;
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "validate=" << sylar::Config::Validate();
+}
+
+// 名字不区分大小写：大写的名字找到的是同一个配置项，不会新建一个覆盖掉原来的
+void test_case_insensitive() {
+    auto v = sylar::Config::Lookup("System.Port", (int)9090, "system port");
+    SYLAR_ASSERT(v == g_int_value_config);
+    SYLAR_ASSERT(sylar::Config::Lookup<int>("SYSTEM.PORT") == g_int_value_config);
+    SYLAR_ASSERT(sylar::Config::LookupBase("System.Port") == g_int_value_config);
+
+    // 类型不同时返回 nullptr，原来的配置项还在
+    SYLAR_ASSERT(!sylar::Config::Lookup("SYSTEM.PORT", std::string("x"), "system port"));
+    SYLAR_ASSERT(sylar::Config::Lookup<int>("system.port") == g_int_value_config);
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "case insensitive lookup ok";
+}
+
+// 多个线程同时 setValue：监听者按顺序收到通知，最后一次通知的新值就是最终值，新旧值首尾相接
+void test_concurrent_set() {
+    auto var = sylar::Config::Lookup("test.concurrent_set", (int)0, "concurrent set");
+    int last = 0;
+    bool chained = true;
+    var->addListener([&last, &chained](const int& old_value, const int& new_value) {
+        if (old_value != last) {
+            chained = false;
+        }
+        last = new_value;
+    });
+    std::vector<std::thread> thrs;
+    for (int t = 0; t < 4; ++t) {
+        thrs.push_back(std::thread([var, t]() {
+            for (int i = 1; i <= 10000; ++i) {
+                var->setValue(t * 100000 + i);
+            }
+        }));
+    }
+    for (auto& i : thrs) {
+        i.join();
+    }
+    SYLAR_ASSERT(chained && last == var->getValue());
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "concurrent set ok, value=" << last;
+}
+
+// 配置分层：YAML < 环境变量 < 命令行
+void test_layers(int argc, char** argv) {
+    setenv("SYLAR_SYSTEM_VALUE", "20.5", 1);
+    sylar::Config::LoadFromEnv();
+    sylar::Config::LoadFromArgs(argc, argv);    // 如 --system.port=7070
+
+    // 重新加载 YAML 不会覆盖高层的值
+    YAML::Node root = YAML::LoadFile(GetLogConf());
+    sylar::Config::LoadFromYaml(root);
+
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "system.port=" << g_int_value_config->getValue()
+        << " from " << sylar::ConfigSource::ToString(sylar::Config::GetSource("system.port"));
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "system.value=" << g_float_value_config->getValue()
+        << " from " << sylar::ConfigSource::ToString(sylar::Config::GetSource("system.value"));
+}
+
 int main(int argc, char** argv) {
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << g_int_value_config->getValue();
-    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << g_float_value_config->toString();
-    
+    sylar::EnvMgr::GetInstance()->init(argc, argv);
     test_yaml();
+    test_config();
+    test_log();
+    test_handle();
+    test_validate();
+    test_case_insensitive();
+    test_concurrent_set();
+    test_layers(argc, argv);
     return 0;
 } 
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "../sylar/config.h"
+#include "../sylar/log.h"
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fstream>
+
+// 对比 YAML 和二进制快照两种启动加载方式的耗时
+static const int s_sections = 200;
+static const int s_keys = 50;
+static const std::string s_conf_dir = "/tmp/sylar_snapshot_conf";
+static const std::string s_snapshot = "/tmp/sylar_snapshot.bin";
+// 只有 map/sequence 的配置目录，快照里按 YAML 文本保存
+static const std::string s_composite_dir = "/tmp/sylar_snapshot_composite";
+static const std::string s_composite_snapshot = "/tmp/sylar_snapshot_composite.bin";
+
+static uint64_t GetCurrentUS() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000 * 1000ul + tv.tv_usec;
+}
+
+// 生成大的配置目录，同时注册对应的配置项
+void gen_conf() {
+    mkdir(s_conf_dir.c_str(), 0755);
+    for (int f = 0; f < 4; ++f) {
+        std::ofstream ofs(s_conf_dir + "/conf" + std::to_string(f) + ".yml", std::ios::trunc);
+        for (int s = f; s < s_sections; s += 4) {
+            std::string section = "section" + std::to_string(s);
+            ofs << section << ":\n";
+            for (int k = 0; k < s_keys; ++k) {
+                std::string key = "key" + std::to_string(k);
+                ofs << "    " << key << ": " << (s * s_keys + k) << "\n";
+                sylar::Config::Lookup(section + "." + key, (int)0);
+            }
+            ofs << "    list: [1, 2, 3, 4, 5]\n";
+            sylar::Config::Lookup(section + ".list", std::vector<int>());
+        }
+    }
+}
+
+// 每节一个 map 和一个 sequence，各 s_keys 个元素
+void gen_composite_conf() {
+    mkdir(s_composite_dir.c_str(), 0755);
+    std::ofstream ofs(s_composite_dir + "/composite.yml", std::ios::trunc);
+    for (int s = 0; s < s_sections; ++s) {
+        std::string section = "composite" + std::to_string(s);
+        ofs << section << ":\n    map:\n";
+        for (int k = 0; k < s_keys; ++k) {
+            ofs << "        key" << k << ": " << (s * s_keys + k) << "\n";
+        }
+        ofs << "    seq:\n";
+        for (int k = 0; k < s_keys; ++k) {
+            ofs << "        - " << k << "\n";
+        }
+        sylar::Config::Lookup(section + ".map", std::map<std::string, int>());
+        sylar::Config::Lookup(section + ".seq", std::vector<int>());
+    }
+}
+
+// 平均每次加载的耗时，微秒
+template<class F>
+static uint64_t TimeUS(int loops, F f) {
+    uint64_t begin = GetCurrentUS();
+    for (int i = 0; i < loops; ++i) {
+        f();
+    }
+    return (GetCurrentUS() - begin) / loops;
+}
+
+// map/sequence 在快照里仍是 YAML 文本，加载耗时和直接读 YAML 相近
+void test_composite(int loops) {
+    gen_composite_conf();
+    uint64_t yaml_us = TimeUS(loops, []() { sylar::Config::LoadFromConfDir(s_composite_dir);});
+    sylar::Config::BuildSnapshot(s_composite_dir, s_composite_snapshot);
+    bool ok = true;
+    uint64_t snapshot_us = TimeUS(loops, [&ok]() {
+        ok = sylar::Config::LoadSnapshot(s_composite_snapshot, s_composite_dir) && ok;
+    });
+    auto m = sylar::Config::Lookup<std::map<std::string, int> >("composite7.map");
+    std::cout << "composite keys=" << s_sections * 2
+              << " yaml=" << yaml_us << "us"
+              << " snapshot=" << snapshot_us << "us"
+              << " snapshot_ok=" << ok
+              << " composite7.map.key3=" << m->getValue().at("key3") << std::endl;
+}
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::WARN);
+    gen_conf();
+
+    const int loops = 5;
+    uint64_t begin = GetCurrentUS();
+    for (int i = 0; i < loops; ++i) {
+        sylar::Config::LoadFromConfDir(s_conf_dir);
+    }
+    uint64_t yaml_us = (GetCurrentUS() - begin) / loops;
+
+    begin = GetCurrentUS();
+    sylar::Config::BuildSnapshot(s_conf_dir, s_snapshot);
+    uint64_t build_us = GetCurrentUS() - begin;
+
+    bool ok = true;
+    begin = GetCurrentUS();
+    for (int i = 0; i < loops; ++i) {
+        ok = sylar::Config::LoadSnapshot(s_snapshot, s_conf_dir) && ok;
+    }
+    uint64_t snapshot_us = (GetCurrentUS() - begin) / loops;
+
+    auto v = sylar::Config::Lookup<int>("section7.key3");
+    std::cout << "keys=" << s_sections * (s_keys + 1)
+              << " yaml=" << yaml_us << "us"
+              << " snapshot=" << snapshot_us << "us"
+              << " build=" << build_us << "us"
+              << " snapshot_ok=" << ok
+              << " section7.key3=" << v->getValue() << std::endl;
+
+    // 修改配置文件后快照过期，退回 YAML
+    {
+        std::ofstream ofs(s_conf_dir + "/conf3.yml", std::ios::app);
+        ofs << "section7:\n    key3: 12345\n";
+    }
+    ok = sylar::Config::LoadSnapshot(s_snapshot, s_conf_dir);
+    std::cout << "stale snapshot_ok=" << ok << " section7.key3=" << v->getValue() << std::endl;
+
+    test_composite(loops);
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "../sylar/coroutine.h"
+#include "../sylar/macro.h"
+#include "../sylar/util.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <atomic>
+#include <fstream>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+sylar::Task<int> add(int a, int b) {
+    co_return a + b;
+}
+
+sylar::Task<int> sum(int n) {
+    int total = 0;
+    for (int i = 0; i < n; ++i) {
+        total += co_await add(i, 1);
+    }
+    co_return total;
+}
+
+sylar::Task<void> thrower() {
+    co_await sylar::Yield();
+    throw std::runtime_error("task error");
+}
+
+void test_task(sylar::Scheduler* sc) {
+    // 连续 co_await 一万次，对称转移不会把栈压深
+    int v = sylar::SyncWait(sc, sum(10000));
+    SYLAR_LOG_INFO(g_logger) << "sum=" << v;
+    SYLAR_ASSERT(v == 10000 * 9999 / 2 + 10000);
+
+    bool caught = false;
+    try {
+        sylar::SyncWait(sc, thrower());
+    } catch (std::runtime_error& e) {
+        caught = true;
+        SYLAR_LOG_INFO(g_logger) << "caught: " << e.what();
+    }
+    SYLAR_ASSERT(caught);
+}
+
+sylar::Task<uint64_t> sleeper(uint64_t ms) {
+    uint64_t begin = sylar::GetCurrentMS();
+    co_await sylar::Sleep(ms);
+    co_return sylar::GetCurrentMS() - begin;
+}
+
+sylar::Task<bool> switcher(sylar::Scheduler* other) {
+    sylar::Scheduler* from = sylar::Scheduler::GetThis();
+    co_await sylar::SwitchTo(other);
+    bool switched = sylar::Scheduler::GetThis() == other;
+    co_await sylar::SwitchTo(from);
+    co_return switched && sylar::Scheduler::GetThis() == from;
+}
+
+void test_sleep_switch(sylar::Scheduler* sc) {
+    uint64_t used = sylar::SyncWait(sc, sleeper(50));
+    SYLAR_LOG_INFO(g_logger) << "sleep 50ms used=" << used << "ms";
+    SYLAR_ASSERT(used >= 50);
+
+    sylar::Scheduler other(1, false, "co_other");
+    other.start();
+    SYLAR_ASSERT(sylar::SyncWait(sc, switcher(&other)));
+    other.stop();
+}
+
+sylar::Task<int> reader(int fd) {
+    char buf[64];
+    // 先等一个会超时的
+    bool ready = co_await sylar::WaitReadable(fd, 20);
+    SYLAR_ASSERT(!ready);
+    ready = co_await sylar::WaitReadable(fd);
+    SYLAR_ASSERT(ready);
+    co_return read(fd, buf, sizeof(buf));
+}
+
+sylar::Task<void> writer(int fd) {
+    co_await sylar::Sleep(50);
+    bool ready = co_await sylar::WaitWritable(fd, 1000);
+    SYLAR_ASSERT(ready);
+    ssize_t rt = write(fd, "hello", 5);
+    SYLAR_ASSERT(rt == 5);
+}
+
+void test_fd(sylar::Scheduler* sc) {
+    int fds[2];
+    SYLAR_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    sylar::CoSpawn(sc, writer(fds[1]));
+    int n = sylar::SyncWait(sc, reader(fds[0]));
+    SYLAR_LOG_INFO(g_logger) << "read " << n << " bytes";
+    SYLAR_ASSERT(n == 5);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static uint64_t GetRss() {
+    std::ifstream ifs("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    ifs >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// 大量协程同时挂起在 Sleep 上，看每个空闲协程占多少内存
+void test_idle(sylar::Scheduler* sc, int count) {
+    std::atomic<int> done {0};
+    sylar::Semaphore sem;
+    uint64_t before = GetRss();
+    for (int i = 0; i < count; ++i) {
+        sylar::CoSpawn(sc, [](std::atomic<int>& d, sylar::Semaphore& s, int total) -> sylar::Task<void> {
+            co_await sylar::Sleep(1000);
+            if (++d == total) {
+                s.notify();
+            }
+        }(done, sem, count));
+    }
+    // 等全部挂起之后再量
+    sylar::SyncWait(sc, sleeper(200));
+    uint64_t after = GetRss();
+    SYLAR_LOG_INFO(g_logger) << "idle coroutines=" << count
+        << " rss_delta=" << (after - before)
+        << " bytes_per_coroutine=" << (after - before) / count;
+    sem.wait();
+    SYLAR_ASSERT(done == count);
+}
+
+int main(int argc, char** argv) {
+    sylar::Scheduler sc(2, false, "co");
+    sc.start();
+    test_task(&sc);
+    test_sleep_switch(&sc);
+    test_fd(&sc);
+    test_idle(&sc, argc > 1 ? atoi(argv[1]) : 100000);
+    sc.stop();
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include "../sylar/crash.h"
+#include "../sylar/log.h"
+#include <string.h>
+
+void crash_here(int* p) {
+    *p = 1;
+}
+
+// 在 log 里崩溃的 appender，此时崩溃线程持有日志器的锁
+class CrashLogAppender : public sylar::LogAppender
+{
+public:
+    void log(sylar::Logger::ptr logger, sylar::LogLevel::Level level, sylar::LogEvent::ptr event) override {
+        if (event->getContent().find("crash in appender") != std::string::npos) {
+            crash_here(nullptr);
+        }
+    }
+    std::string toYamlString() override { return "";}
+};
+
+int main(int argc, char** argv) {
+    sylar::InstallCrashHandler();
+
+    sylar::Logger::ptr logger = SYLAR_LOG_ROOT();
+    logger->addAppender(sylar::LogAppender::ptr(new sylar::MemoryRingLogAppender(16, 256, true)));
+    logger->addAppender(sylar::LogAppender::ptr(new sylar::FileLogAppender("./crash_log.txt")));
+
+    for (int i = 0; i < 5; ++i) {
+        SYLAR_LOG_DEBUG(logger) << "before crash " << i;
+    }
+    SYLAR_LOG_FATAL(logger) << "fatal with backtrace";
+
+    // 参数 appender 在 appender 里崩溃（不能卡死，几秒后照样退出），
+    // 其他参数 abort 走 SIGABRT，否则空指针走 SIGSEGV
+    if (argc > 1 && !strcmp(argv[1], "appender")) {
+        logger->addAppender(sylar::LogAppender::ptr(new CrashLogAppender));
+        SYLAR_LOG_INFO(logger) << "crash in appender";
+    }
+    if (argc > 1) {
+        abort();
+    }
+    crash_here(nullptr);
+    return 0;
+}
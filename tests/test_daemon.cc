@@ -0,0 +1,87 @@
+#include "../sylar/daemon.h"
+#include "../sylar/env.h"
+#include "../sylar/log.h"
+#include "../sylar/macro.h"
+#include <sys/socket.h>
+#include <signal.h>
+#include <atomic>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<bool> s_stop {false};
+
+void test_send_fds() {
+    int sv[2];
+    SYLAR_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    int p[2];
+    SYLAR_ASSERT(pipe(p) == 0);
+
+    std::vector<std::pair<std::string, int> > fds;
+    fds.push_back(std::make_pair("pipe_r", p[0]));
+    fds.push_back(std::make_pair("pipe_w", p[1]));
+    SYLAR_ASSERT(sylar::SendFds(sv[0], fds));
+
+    std::vector<std::pair<std::string, int> > recv;
+    SYLAR_ASSERT(sylar::RecvFds(sv[1], recv));
+    SYLAR_ASSERT(recv.size() == 2);
+    SYLAR_ASSERT(recv[0].first == "pipe_r" && recv[1].first == "pipe_w");
+    // 收到的是新的 fd，指向同一个管道
+    SYLAR_ASSERT(write(recv[1].second, "x", 1) == 1);
+    char c = 0;
+    SYLAR_ASSERT(read(p[0], &c, 1) == 1 && c == 'x');
+
+    // 没有 fd 也能交接
+    SYLAR_ASSERT(sylar::SendFds(sv[0], std::vector<std::pair<std::string, int> >()));
+    SYLAR_ASSERT(sylar::RecvFds(sv[1], recv) && recv.empty());
+    SYLAR_LOG_INFO(g_logger) << "send fds ok";
+}
+
+// 简单的服务：每个连接回一行自己的 pid
+// -f 前台运行，处理一个连接后退出；用 -d 启动后：kill -HUP <看门狗 pid> 平滑重启，kill -9 <子进程 pid> 看自动重启
+int server_main(int argc, char** argv) {
+    SYLAR_LOG_INFO(g_logger) << sylar::ProcessInfoMgr::GetInstance()->toString();
+    int fd = sylar::GetListenFd("test", "127.0.0.1", 8020);
+    if (fd < 0) {
+        return 1;
+    }
+    sylar::SetHandoffCallback([]() {
+        s_stop = true;
+    });
+    struct timeval tv = {0, 200 * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int served = 0;
+    bool once = sylar::EnvMgr::GetInstance()->has("f");
+    while (!s_stop) {
+        int conn = accept(fd, nullptr, nullptr);
+        if (conn < 0) {
+            continue;
+        }
+        std::string rsp = std::to_string(getpid()) + "\n";
+        ssize_t rt = write(conn, rsp.c_str(), rsp.size());
+        (void)rt;
+        close(conn);
+        ++served;
+        if (once) {
+            break;
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "server pid=" << getpid() << " served=" << served << " exit";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        test_send_fds();
+        return 0;
+    }
+    sylar::Env* env = sylar::EnvMgr::GetInstance();
+    env->addHelp("d", "run as daemon");
+    env->addHelp("f", "run in foreground, serve one connection");
+    env->addHelp("c", "conf dir, default <exe dir>/conf");
+    env->addHelp("h", "print help");
+    if (!env->init(argc, argv) || env->has("h") || !(env->has("d") || env->has("f"))) {
+        env->printHelp();
+        return 0;
+    }
+    return sylar::start_daemon(argc, argv, server_main, env->has("d"), env->getConfigPath());
+}
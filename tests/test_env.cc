@@ -0,0 +1,41 @@
+#include "../sylar/env.h"
+#include "../sylar/log.h"
+#include "../sylar/macro.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 例：./test_env -p 8080 -d -name=sylar -c /etc/sylar --system.port=9000
+int main(int argc, char** argv) {
+    sylar::Env* env = sylar::EnvMgr::GetInstance();
+    env->addHelp("p", "port, int");
+    env->addHelp("d", "run as daemon");
+    env->addHelp("name", "server name");
+    env->addHelp("c", "conf dir");
+    env->addHelp("h", "print help");
+    if (!env->init(argc, argv) || env->has("h")) {
+        env->printHelp();
+        return 0;
+    }
+
+    SYLAR_LOG_INFO(g_logger) << "exe=" << env->getExe() << " exe_dir=" << env->getExeDir()
+        << " cwd=" << env->getCwd() << " program=" << env->getProgram();
+    SYLAR_LOG_INFO(g_logger) << "conf=" << env->getConfigPath()
+        << " port=" << env->getAs<int>("p", 8020)
+        << " daemon=" << env->getAs<bool>("d", false)
+        << " name=" << env->get("name", "none");
+    SYLAR_LOG_INFO(g_logger) << "PATH=" << env->getEnv("PATH");
+
+    SYLAR_ASSERT(env->getExe()[0] == '/');
+    SYLAR_ASSERT(env->getExe().compare(0, env->getExeDir().size(), env->getExeDir()) == 0);
+    SYLAR_ASSERT(env->getAbsolutePath("/a/b") == "/a/b");
+    SYLAR_ASSERT(env->getAbsolutePath("conf") == env->getExeDir() + "conf");
+    SYLAR_ASSERT(env->getAbsoluteWorkPath("x") == env->getCwd() + "x");
+
+    // 转换失败返回默认值
+    env->add("bad", "abc");
+    SYLAR_ASSERT(env->getAs<int>("bad", 7) == 7);
+    env->add("off", "false");
+    SYLAR_ASSERT(!env->getAs<bool>("off", true));
+    SYLAR_ASSERT(env->setEnv("SYLAR_TEST_ENV", "1") && env->getEnv("SYLAR_TEST_ENV") == "1");
+    return 0;
+}
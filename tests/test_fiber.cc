@@ -0,0 +1,64 @@
+#include "../sylar/scheduler.h"
+#include "../sylar/macro.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+void run_in_fiber() {
+    SYLAR_LOG_INFO(g_logger) << "run_in_fiber begin";
+    sylar::Fiber::YieldToHold();
+    SYLAR_LOG_INFO(g_logger) << "run_in_fiber end";
+}
+
+// 不用调度器，主协程和子协程之间来回切
+void test_fiber() {
+    SYLAR_LOG_INFO(g_logger) << "main begin";
+    {
+        sylar::Fiber::GetThis();
+        sylar::Fiber::ptr fiber(new sylar::Fiber(run_in_fiber, 0, true));
+        fiber->call();
+        SYLAR_LOG_INFO(g_logger) << "main after swapIn";
+        fiber->call();
+        SYLAR_LOG_INFO(g_logger) << "main after end";
+        SYLAR_ASSERT(fiber->getState() == sylar::Fiber::TERM);
+    }
+    SYLAR_LOG_INFO(g_logger) << "main end";
+}
+
+static std::atomic<int> s_count {0};
+
+void test_sched(int n) {
+    ++s_count;
+    // 每个协程有自己的日志上下文，切出去再切回来还是自己的
+    sylar::LogContext::Scoped ctx("req", std::to_string(n));
+    sylar::Fiber::YieldToReady();
+    SYLAR_ASSERT(sylar::LogContext::Get("req") == std::to_string(n));
+    if (n % 100 == 0) {
+        SYLAR_LOG_INFO(g_logger) << "test in fiber n=" << n;
+    }
+}
+
+void test_scheduler() {
+    sylar::LogContext::Put("req", "main");
+    sylar::Scheduler sc(3, true, "test");
+    sc.start();
+    for (int i = 0; i < 1000; ++i) {
+        sc.schedule(std::bind(test_sched, i));
+    }
+    // 指定线程执行
+    sc.schedule([]() {
+        SYLAR_LOG_INFO(g_logger) << "run on root thread";
+    }, sylar::GetThreadId());
+    sc.stop();
+    SYLAR_ASSERT(s_count == 1000);
+    // 调度协程切回来之后主线程的上下文还在
+    SYLAR_ASSERT(sylar::LogContext::Get("req") == "main");
+    sylar::LogContext::Clear();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setFormatter("%d{%H:%M:%S}%T%t%T%N%T%F%T[%p]%T%X%T%m%n");
+    test_fiber();
+    test_scheduler();
+    SYLAR_LOG_INFO(g_logger) << "total fibers=" << sylar::Fiber::TotalFibers();
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "../sylar/fiber.h"
+#include "../sylar/config.h"
+#include "../sylar/crash.h"
+#include "../sylar/macro.h"
+#include <stdio.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static void LogStats(const std::string& prefix) {
+    auto s = sylar::StackAllocator::GetStats();
+    SYLAR_LOG_INFO(g_logger) << prefix << " in_use=" << s.in_use_bytes
+        << " pooled=" << s.pooled_bytes << " peak=" << s.peak_bytes
+        << " stacks=" << s.stacks;
+}
+
+void test_allocator(const std::string& name) {
+    sylar::Config::Lookup<std::string>("fiber.stack_allocator")->setValue(name);
+    SYLAR_ASSERT(sylar::StackAllocator::GetDefault()->getName() == name);
+
+    auto before = sylar::StackAllocator::GetStats();
+    {
+        std::vector<sylar::Fiber::ptr> fibers;
+        sylar::Fiber::GetThis();
+        for (int i = 0; i < 100; ++i) {
+            sylar::Fiber::ptr f(new sylar::Fiber([]() {
+                // 用掉一些栈
+                volatile char buf[8 * 1024];
+                buf[0] = 1;
+                buf[sizeof(buf) - 1] = buf[0];
+            }, 0, true));
+            f->call();
+            fibers.push_back(f);
+        }
+        auto s = sylar::StackAllocator::GetStats();
+        SYLAR_ASSERT(s.stacks == before.stacks + 100);
+        SYLAR_ASSERT(s.in_use_bytes >= before.in_use_bytes + 100 * sylar::StackAllocator::GetDefaultStackSize());
+        LogStats(name + " 100 fibers");
+    }
+    auto after = sylar::StackAllocator::GetStats();
+    SYLAR_ASSERT(after.stacks == before.stacks);
+    LogStats(name + " released");
+}
+
+void test_stack_size() {
+    auto var = sylar::Config::Lookup<uint32_t>("fiber.stack_size");
+    var->setValue(256 * 1024);
+    SYLAR_ASSERT(sylar::StackAllocator::GetDefaultStackSize() == 256 * 1024);
+    // 太小的不接受
+    var->setValue(1024);
+    SYLAR_ASSERT(sylar::StackAllocator::GetDefaultStackSize() == 256 * 1024);
+    var->setValue(128 * 1024);
+}
+
+// limit 传一个很大的数，编译器看不出来是无限递归
+static int Recurse(int n, int limit) {
+    volatile char buf[1024];
+    buf[0] = n;
+    if (n >= limit) {
+        return buf[0];
+    }
+    return Recurse(n + 1, limit) + buf[0];
+}
+
+// 子进程里跑：协程无限递归撞到保护页
+void overflow() {
+    sylar::InstallCrashHandler();
+    sylar::Config::Lookup<std::string>("fiber.stack_allocator")->setValue("mmap");
+    sylar::Fiber::GetThis();
+    sylar::Fiber::ptr f(new sylar::Fiber([]() {
+        Recurse(0, 1 << 30);
+    }, 64 * 1024, true));
+    f->call();
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "overflow") {
+        overflow();
+        return 0;
+    }
+    test_allocator("malloc");
+    test_allocator("mmap");
+    test_allocator("pool");
+    // 池里缓存着刚释放的栈
+    SYLAR_ASSERT(sylar::StackAllocator::GetStats().pooled_bytes > 0);
+    test_stack_size();
+
+    FILE* fp = popen((std::string(argv[0]) + " overflow 2>&1").c_str(), "r");
+    SYLAR_ASSERT(fp);
+    std::string out;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        out.append(buf, n);
+    }
+    int status = pclose(fp);
+    SYLAR_LOG_INFO(g_logger) << "overflow child status=" << status
+        << " detected=" << (out.find("fiber stack overflow") != std::string::npos);
+    SYLAR_ASSERT(out.find("fiber stack overflow") != std::string::npos);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "../sylar/fiber_sync.h"
+#include "../sylar/macro.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+void test_mutex() {
+    sylar::FiberMutex mutex;
+    int count = 0;
+    {
+        sylar::Scheduler sc(4, false, "mutex");
+        sc.start();
+        for (int i = 0; i < 100; ++i) {
+            sc.schedule([&mutex, &count]() {
+                for (int j = 0; j < 1000; ++j) {
+                    sylar::FiberMutex::Lock lock(mutex);
+                    int v = count;
+                    // 持锁时让出，别的协程拿不到锁只能挂起
+                    if (j % 100 == 0) {
+                        sylar::Fiber::YieldToReady();
+                    }
+                    count = v + 1;
+                }
+            });
+        }
+        sc.stop();
+    }
+    SYLAR_LOG_INFO(g_logger) << "mutex count=" << count;
+    SYLAR_ASSERT(count == 100000);
+}
+
+void test_semaphore() {
+    sylar::FiberSemaphore sem(0);
+    std::atomic<int> done {0};
+    sylar::Scheduler sc(2, false, "sem");
+    sc.start();
+    for (int i = 0; i < 50; ++i) {
+        sc.schedule([&sem, &done]() {
+            sem.wait();
+            ++done;
+        });
+    }
+    // 普通线程也可以 notify
+    for (int i = 0; i < 50; ++i) {
+        sem.notify();
+    }
+    sc.stop();
+    SYLAR_LOG_INFO(g_logger) << "semaphore done=" << done;
+    SYLAR_ASSERT(done == 50);
+    SYLAR_ASSERT(sem.getCount() == 0);
+}
+
+void test_condition() {
+    sylar::FiberMutex mutex;
+    sylar::FiberCondition cond;
+    bool ready = false;
+    std::atomic<int> woken {0};
+    sylar::Scheduler sc(2, false, "cond");
+    sc.start();
+    for (int i = 0; i < 20; ++i) {
+        sc.schedule([&]() {
+            sylar::FiberMutex::Lock lock(mutex);
+            while (!ready) {
+                cond.wait(lock);
+            }
+            ++woken;
+        });
+    }
+    sc.schedule([&]() {
+        sylar::FiberMutex::Lock lock(mutex);
+        ready = true;
+        cond.notifyAll();
+    });
+    sc.stop();
+    SYLAR_LOG_INFO(g_logger) << "condition woken=" << woken;
+    SYLAR_ASSERT(woken == 20);
+}
+
+void test_channel() {
+    sylar::Channel<int> chan(8);
+    std::atomic<int64_t> sum {0};
+    std::atomic<int> consumers {0};
+    sylar::Scheduler sc(3, true, "chan");
+    sc.start();
+    const int producers = 10;
+    const int per = 1000;
+    std::atomic<int> producing {producers};
+    for (int p = 0; p < producers; ++p) {
+        sc.schedule([&, p]() {
+            for (int i = 0; i < per; ++i) {
+                SYLAR_ASSERT(chan.push(p * per + i));
+            }
+            if (--producing == 0) {
+                chan.close();
+            }
+        });
+    }
+    for (int c = 0; c < 5; ++c) {
+        sc.schedule([&]() {
+            int v = 0;
+            while (chan.pop(v)) {
+                sum += v;
+            }
+            ++consumers;
+        });
+    }
+    sc.stop();
+    int64_t n = producers * per;
+    SYLAR_LOG_INFO(g_logger) << "channel sum=" << sum << " expect=" << n * (n - 1) / 2;
+    SYLAR_ASSERT(sum == n * (n - 1) / 2);
+    SYLAR_ASSERT(consumers == 5);
+    SYLAR_ASSERT(!chan.push(1));
+}
+
+int main(int argc, char** argv) {
+    test_mutex();
+    test_semaphore();
+    test_condition();
+    test_channel();
+    return 0;
+}
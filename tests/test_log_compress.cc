@@ -0,0 +1,121 @@
+#include "../sylar/log.h"
+#include "../sylar/macro.h"
+#include "../sylar/config.h"
+#include <unistd.h>
+#include <stdio.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 用命令行工具解压，检查内容是 0..count-1
+static int CheckDecode(const std::string& cmd) {
+    FILE* fp = popen(cmd.c_str(), "r");
+    SYLAR_ASSERT(fp);
+    char line[256];
+    int expect = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        int seq = -1;
+        if (sscanf(line, "seq=%d", &seq) != 1 || seq != expect) {
+            SYLAR_LOG_ERROR(g_logger) << "bad line: " << line << " expect=" << expect;
+            break;
+        }
+        ++expect;
+    }
+    pclose(fp);
+    return expect;
+}
+
+void test_compress(const std::string& name, const std::string& tool) {
+    std::string file = "/tmp/sylar_test_compress.log." + name;
+    unlink(file.c_str());
+    sylar::FileLogAppender::ptr fa(new sylar::FileLogAppender(file, name, 0, 64 * 1024));
+    if (fa->getCompress() != name) {
+        SYLAR_LOG_INFO(g_logger) << name << " not compiled in, skip";
+        unlink(file.c_str());
+        return;
+    }
+    sylar::Logger::ptr logger(new sylar::Logger("compress"));
+    logger->setFormatter("seq=%m%n");
+    logger->addAppender(fa);
+
+    for (int i = 0; i < 50000; ++i) {
+        SYLAR_LOG_INFO(logger) << i << " uid=" << i % 97 << " some payload";
+    }
+    // flush 之后文件里是若干个完整的帧，这时候就能解压出全部内容
+    logger->flush();
+    int n = CheckDecode(tool + " " + file);
+    SYLAR_LOG_INFO(g_logger) << name << " after flush decoded=" << n
+        << " raw=" << fa->getRawBytes() << " file=" << fa->getFileBytes()
+        << " ratio=" << (double)fa->getRawBytes() / fa->getFileBytes();
+    SYLAR_ASSERT(n == 50000);
+
+    for (int i = 50000; i < 60000; ++i) {
+        SYLAR_LOG_INFO(logger) << i << " uid=" << i % 97 << " some payload";
+    }
+    logger->flush();
+    SYLAR_ASSERT(CheckDecode(tool + " " + file) == 60000);
+    unlink(file.c_str());
+}
+
+// 缓冲上限很小，写线程跟不上时丢弃并计数：落盘的加上丢弃的正好是写入的条数
+void test_backpressure() {
+    std::string file = "/tmp/sylar_test_compress.log.backpressure";
+    unlink(file.c_str());
+    sylar::FileLogAppender::ptr fa(new sylar::FileLogAppender(file, "gzip", 0, 16 * 1024, 1000, 16 * 1024));
+    if (fa->getCompress() != "gzip") {
+        SYLAR_LOG_INFO(g_logger) << "gzip not compiled in, skip";
+        unlink(file.c_str());
+        return;
+    }
+    sylar::Logger::ptr logger(new sylar::Logger("backpressure"));
+    logger->setFormatter("seq=%m%n");
+    logger->addAppender(fa);
+    const int n = 100000;
+    for (int i = 0; i < n; ++i) {
+        SYLAR_LOG_INFO(logger) << i << " uid=" << i % 97 << " some payload";
+    }
+    logger->flush();
+
+    FILE* fp = popen(("gzip -dc " + file + " | wc -l").c_str(), "r");
+    SYLAR_ASSERT(fp);
+    int lines = 0;
+    SYLAR_ASSERT(fscanf(fp, "%d", &lines) == 1);
+    pclose(fp);
+    SYLAR_LOG_INFO(g_logger) << "backpressure written=" << lines << " dropped=" << fa->getDropped()
+        << " metrics drops=" << fa->getMetrics().drops;
+    SYLAR_ASSERT(lines + fa->getDropped() == (uint64_t)n);
+    unlink(file.c_str());
+}
+
+// 配置里的 flush_bytes、flush_ms 要传到 FileLogAppender
+void test_config() {
+    std::string file = "/tmp/sylar_test_compress.log.config";
+    YAML::Node root = YAML::Load(
+        "logs:\n"
+        "    - name: compress_conf\n"
+        "      appenders:\n"
+        "          - type: FileLogAppender\n"
+        "            file: " + file + "\n"
+        "            compress: gzip\n"
+        "            flush_bytes: 4096\n"
+        "            flush_ms: 50\n");
+    sylar::Config::LoadFromYaml(root);
+    std::string yaml = SYLAR_LOG_NAME("compress_conf")->toYamlString();
+    SYLAR_LOG_INFO(g_logger) << "config appender:\n" << yaml;
+    if (yaml.find("compress: gzip") == std::string::npos) {
+        SYLAR_LOG_INFO(g_logger) << "gzip not compiled in, skip";
+    } else {
+        SYLAR_ASSERT(yaml.find("flush_bytes: 4096") != std::string::npos);
+        SYLAR_ASSERT(yaml.find("flush_ms: 50") != std::string::npos);
+    }
+    SYLAR_LOG_NAME("compress_conf")->clearAppenders();
+    unlink(file.c_str());
+}
+
+int main(int argc, char** argv) {
+    test_compress("gzip", "gzip -dc");
+    test_compress("zstd", "zstd -dc");
+    test_compress("lz4", "lz4 -dc");
+    test_backpressure();
+    test_config();
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "../sylar/log.h"
+#include "../sylar/config.h"
+#include "../sylar/macro.h"
+#include <unistd.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+void test_histogram() {
+    // 每个值都落在 [下界, 上界] 里，相对误差不超过 25%
+    uint64_t values[] = {0, 1, 3, 4, 5, 7, 8, 100, 1000, 12345, 1000000, 987654321};
+    for (auto v : values) {
+        int idx = sylar::LogMetrics::BucketIndex(v);
+        uint64_t upper = sylar::LogMetrics::BucketUpper(idx);
+        uint64_t lower = idx ? sylar::LogMetrics::BucketUpper(idx - 1) + 1 : 0;
+        SYLAR_ASSERT(lower <= v && v <= upper);
+        SYLAR_ASSERT(upper - lower <= v / 4 + 1);
+    }
+    // 超出范围的进最后一个桶
+    SYLAR_ASSERT(sylar::LogMetrics::BucketIndex(~0ul) == sylar::LogMetrics::kBuckets - 1);
+
+    sylar::LogMetrics m;
+    for (int i = 1; i <= 1000; ++i) {
+        m.addEvent(sylar::LogLevel::INFO, 10, 0, i * 1000);
+    }
+    sylar::LogMetrics::Snapshot s = m.getSnapshot();
+    SYLAR_ASSERT(s.getEvents() == 1000 && s.events[sylar::LogLevel::INFO] == 1000);
+    SYLAR_ASSERT(s.bytes == 10000);
+    uint64_t p50 = s.getWritePercentile(0.5);
+    uint64_t p99 = s.getWritePercentile(0.99);
+    SYLAR_LOG_INFO(g_logger) << "p50=" << p50 << " p99=" << p99;
+    SYLAR_ASSERT(p50 >= 500000 && p50 <= 500000 * 5 / 4);
+    SYLAR_ASSERT(p99 >= 990000 && p99 <= 990000 * 5 / 4);
+    m.reset();
+    SYLAR_ASSERT(m.getSnapshot().getEvents() == 0);
+}
+
+// 多个线程往同一个日志器写，汇总后的条数不多不少
+void test_logger() {
+    // 默认关闭
+    SYLAR_ASSERT(!sylar::LogMetrics::IsEnabled());
+    sylar::Config::Lookup<bool>("log.metrics.enable")->setValue(true);
+    sylar::Logger::ptr logger = SYLAR_LOG_NAME("metrics_test");
+    sylar::LogAppender::ptr all(new sylar::NullLogAppender);
+    sylar::LogAppender::ptr warn(new sylar::NullLogAppender);
+    warn->setLevel(sylar::LogLevel::WARN);
+    logger->addAppender(all);
+    logger->addAppender(warn);
+
+    const int threads = 4;
+    const int n = 10000;
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < threads; ++i) {
+        thrs.push_back(sylar::Thread::ptr(new sylar::Thread([logger]() {
+            for (int j = 0; j < n; ++j) {
+                if (j % 10 == 0) {
+                    SYLAR_LOG_WARN(logger) << "warn " << j;
+                } else {
+                    SYLAR_LOG_INFO(logger) << "info " << j;
+                }
+            }
+        }, "metrics_" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+
+    sylar::LogMetrics::Snapshot ls = logger->getMetrics();
+    sylar::LogMetrics::Snapshot as = all->getMetrics();
+    sylar::LogMetrics::Snapshot ws = warn->getMetrics();
+    SYLAR_LOG_INFO(g_logger) << "logger: " << ls.toString();
+    SYLAR_LOG_INFO(g_logger) << "all:    " << as.toString();
+    SYLAR_LOG_INFO(g_logger) << "warn:   " << ws.toString();
+    SYLAR_ASSERT(ls.getEvents() == threads * n);
+    SYLAR_ASSERT(ls.events[sylar::LogLevel::WARN] == threads * n / 10);
+    SYLAR_ASSERT(as.getEvents() == threads * n);
+    SYLAR_ASSERT(ws.getEvents() == threads * n / 10);
+    SYLAR_ASSERT(as.bytes > 0 && ls.bytes == as.bytes + ws.bytes);
+    SYLAR_ASSERT(as.format_ns > 0);
+
+    // 限流丢弃的算在日志器上
+    logger->setRateLimit(sylar::TokenBucket::ptr(new sylar::TokenBucket(1, 10)));
+    for (int i = 0; i < 100; ++i) {
+        SYLAR_LOG_INFO(logger) << "limited " << i;
+    }
+    ls = logger->getMetrics();
+    SYLAR_LOG_INFO(g_logger) << "rate limited: " << ls.toString();
+    SYLAR_ASSERT(ls.drops >= 89);
+    logger->setRateLimit(nullptr);
+
+    // 关掉后不再统计
+    sylar::Config::Lookup<bool>("log.metrics.enable")->setValue(false);
+    SYLAR_LOG_INFO(logger) << "not counted";
+    SYLAR_ASSERT(logger->getMetrics().getEvents() == ls.getEvents());
+    sylar::Config::Lookup<bool>("log.metrics.enable")->setValue(true);
+}
+
+// 开关打开和关闭时每条日志的耗时
+void bench_overhead() {
+    sylar::Logger::ptr logger = SYLAR_LOG_NAME("metrics_bench");
+    logger->addAppender(sylar::LogAppender::ptr(new sylar::NullLogAppender));
+    auto enable = sylar::Config::Lookup<bool>("log.metrics.enable");
+    for (bool on : {false, true, false, true}) {
+        enable->setValue(on);
+        const int n = 100000;
+        uint64_t begin = sylar::GetCurrentUS();
+        for (int i = 0; i < n; ++i) {
+            SYLAR_LOG_INFO(logger) << "hello " << i;
+        }
+        uint64_t used = sylar::GetCurrentUS() - begin;
+        SYLAR_LOG_INFO(g_logger) << "metrics=" << on << " ns/log=" << used * 1000 / n;
+    }
+    enable->setValue(true);
+}
+
+// 先设一个很长的间隔再改成 1 秒，改了马上按新间隔生效，不用等完旧的间隔
+void test_dump() {
+    sylar::Logger::ptr dump_logger = SYLAR_LOG_NAME("log_metrics");
+    uint64_t before = dump_logger->getMetrics().getEvents();
+    auto interval = sylar::Config::Lookup<uint32_t>("log.metrics.dump_interval");
+    interval->setValue(3600);
+    usleep(100 * 1000);
+    interval->setValue(1);
+    sleep(2);
+    interval->setValue(0);
+    uint64_t dumps = dump_logger->getMetrics().getEvents() - before;
+    SYLAR_LOG_INFO(g_logger) << "dumps=" << dumps;
+#ifdef SYLAR_SINGLE_THREAD
+    // 单线程构建不起输出线程
+    SYLAR_ASSERT(dumps == 0);
+#else
+    SYLAR_ASSERT(dumps >= 1);
+#endif
+}
+
+int main(int argc, char** argv) {
+    test_histogram();
+    test_logger();
+    bench_overhead();
+    test_dump();
+    return 0;
+}
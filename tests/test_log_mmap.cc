@@ -0,0 +1,175 @@
+#include "../sylar/log.h"
+#include "../sylar/macro.h"
+#include "../sylar/util.h"
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <fstream>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const std::string s_file = "/tmp/sylar_test_mmap.log";
+
+static std::string SegmentName(int idx) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), ".%06d", idx);
+    return s_file + buf;
+}
+
+static void Cleanup() {
+    for (int i = 0; i < 100; ++i) {
+        unlink(SegmentName(i).c_str());
+    }
+}
+
+static off_t FileSize(const std::string& name) {
+    struct stat st;
+    return stat(name.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+// 按段顺序读出所有行，检查是 0..count-1
+static int CheckLines(int segments) {
+    int expect = 0;
+    for (int i = 0; i < segments; ++i) {
+        std::ifstream ifs(SegmentName(i));
+        std::string line;
+        while (std::getline(ifs, line)) {
+            int seq = -1;
+            if (sscanf(line.c_str(), "seq=%d", &seq) != 1 || seq != expect) {
+                SYLAR_LOG_ERROR(g_logger) << "segment=" << i << " bad line: " << line
+                    << " expect=" << expect;
+                return -1;
+            }
+            ++expect;
+        }
+    }
+    return expect;
+}
+
+static sylar::Logger::ptr NewLogger(sylar::MmapFileLogAppender::ptr appender) {
+    sylar::Logger::ptr logger(new sylar::Logger("mmap"));
+    logger->setFormatter("seq=%m%n");
+    logger->addAppender(appender);
+    return logger;
+}
+
+// 写满换段，正常关闭截断到实际长度
+void test_roll() {
+    Cleanup();
+    {
+        sylar::MmapFileLogAppender::ptr ap(new sylar::MmapFileLogAppender(s_file, 4096));
+        sylar::Logger::ptr logger = NewLogger(ap);
+        for (int i = 0; i < 1000; ++i) {
+            SYLAR_LOG_INFO(logger) << i << " some audit payload";
+        }
+        SYLAR_LOG_INFO(g_logger) << "roll segment=" << ap->getSegmentIndex() << " cursor=" << ap->getCursor();
+    }
+    int segs = 0;
+    while (FileSize(SegmentName(segs)) >= 0) {
+        SYLAR_ASSERT(FileSize(SegmentName(segs)) <= 4096);
+        ++segs;
+    }
+    SYLAR_ASSERT(segs > 1);
+    SYLAR_ASSERT(CheckLines(segs) == 1000);
+
+    // 重新打开接着写
+    {
+        sylar::MmapFileLogAppender::ptr ap(new sylar::MmapFileLogAppender(s_file, 4096));
+        sylar::Logger::ptr logger = NewLogger(ap);
+        SYLAR_ASSERT((int)ap->getSegmentIndex() == segs - 1);
+        for (int i = 1000; i < 1100; ++i) {
+            SYLAR_LOG_INFO(logger) << i << " some audit payload";
+        }
+    }
+    segs = 0;
+    while (FileSize(SegmentName(segs)) >= 0) {
+        ++segs;
+    }
+    SYLAR_ASSERT(CheckLines(segs) == 1100);
+    SYLAR_LOG_INFO(g_logger) << "test_roll ok segments=" << segs;
+}
+
+// 子进程写到一半被 kill，段没被截断，重启后要找到有效结尾
+void test_recover() {
+    Cleanup();
+    pid_t pid = fork();
+    if (pid == 0) {
+        sylar::MmapFileLogAppender::ptr ap(new sylar::MmapFileLogAppender(s_file, 1024 * 1024));
+        sylar::Logger::ptr logger = NewLogger(ap);
+        for (int i = 0; i < 500; ++i) {
+            SYLAR_LOG_INFO(logger) << i;
+        }
+        kill(getpid(), SIGKILL);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    SYLAR_ASSERT(FileSize(SegmentName(0)) == 1024 * 1024);
+
+    // 模拟最后一条只写了一半
+    {
+        FILE* fp = fopen(SegmentName(0).c_str(), "r+");
+        std::string content(1024 * 1024, '\0');
+        SYLAR_ASSERT(fread(&content[0], 1, content.size(), fp) == content.size());
+        size_t end = sylar::MmapFileLogAppender::FindValidEnd(content.c_str(), content.size());
+        fseek(fp, end, SEEK_SET);
+        fputs("seq=half", fp);
+        fclose(fp);
+    }
+
+    {
+        sylar::MmapFileLogAppender::ptr ap(new sylar::MmapFileLogAppender(s_file, 1024 * 1024,
+                    sylar::MmapFileLogAppender::ERROR));
+        sylar::Logger::ptr logger = NewLogger(ap);
+        SYLAR_LOG_INFO(g_logger) << "recover segment=" << ap->getSegmentIndex() << " cursor=" << ap->getCursor();
+        for (int i = 500; i < 600; ++i) {
+            SYLAR_LOG_ERROR(logger) << i;
+        }
+    }
+    SYLAR_ASSERT(CheckLines(1) == 600);
+    SYLAR_ASSERT(FileSize(SegmentName(0)) < 1024 * 1024);
+    SYLAR_LOG_INFO(g_logger) << "test_recover ok";
+}
+
+// 文件大小限制比段小，fallocate 失败：不映射稀疏文件，退回 pwrite，超过限制的丢弃并计数
+void test_fallocate_fail() {
+    Cleanup();
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit old_limit;
+    getrlimit(RLIMIT_FSIZE, &old_limit);
+    struct rlimit limit = old_limit;
+    limit.rlim_cur = 64 * 1024;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    {
+        sylar::MmapFileLogAppender::ptr appender(new sylar::MmapFileLogAppender(s_file, 1024 * 1024));
+        SYLAR_ASSERT(appender->isValid() && !appender->isMapped());
+        sylar::Logger::ptr logger = NewLogger(appender);
+        for (int i = 0; i < 100; ++i) {
+            SYLAR_LOG_INFO(logger) << i;
+        }
+        SYLAR_ASSERT(appender->getDropped() == 0);
+        // 超过 64K 的写不进去
+        for (int i = 100; i < 20000; ++i) {
+            SYLAR_LOG_INFO(logger) << i;
+        }
+        SYLAR_LOG_INFO(g_logger) << "fallocate fail: cursor=" << appender->getCursor()
+            << " dropped=" << appender->getDropped();
+        SYLAR_ASSERT(appender->getDropped() > 0);
+        SYLAR_ASSERT(appender->getCursor() <= 64 * 1024);
+    }
+    setrlimit(RLIMIT_FSIZE, &old_limit);
+    signal(SIGXFSZ, SIG_DFL);
+    // 写进去的是从 0 开始连续的完整行
+    int lines = CheckLines(1);
+    SYLAR_ASSERT(lines >= 100);
+    SYLAR_LOG_INFO(g_logger) << "test_fallocate_fail ok lines=" << lines;
+}
+
+int main(int argc, char** argv) {
+    test_roll();
+    test_recover();
+    test_fallocate_fail();
+    Cleanup();
+    return 0;
+}
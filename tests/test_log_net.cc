@@ -0,0 +1,183 @@
+#include "../sylar/log.h"
+#include "../sylar/macro.h"
+#include "../sylar/util.h"
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+// 绑定本地回环上的随机端口，返回套接字，端口写进 addr
+static int BindUdp(sockaddr_in& addr) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    SYLAR_ASSERT(sock >= 0);
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    SYLAR_ASSERT(bind(sock, (sockaddr*)&addr, sizeof(addr)) == 0);
+    socklen_t addr_len = sizeof(addr);
+    getsockname(sock, (sockaddr*)&addr, &addr_len);
+    return sock;
+}
+
+// 本地起一个 UDP 监听，收 count 条日志，检查分包和每个数据报的完整性
+// UDP 非阻塞发送会丢（发送缓冲满、接收端来不及收），只要求丢失在一定比例内，不要求一条不丢
+void test_udp(int count, size_t mtu) {
+    sockaddr_in addr;
+    int sock = BindUdp(addr);
+
+    int received = 0;
+    int datagrams = 0;
+    int bad = 0;
+    std::vector<bool> seen(count, false);
+    std::thread th([&]() {
+        std::string buf(65536, '\0');
+        pollfd pfd = {sock, POLLIN, 0};
+        while (received < count && poll(&pfd, 1, 1000) > 0) {
+            ssize_t n = recv(sock, &buf[0], buf.size(), 0);
+            if (n <= 0) {
+                break;
+            }
+            ++datagrams;
+            // 一个数据报不超过 mtu，由若干条完整的日志组成，同一个数据报里的序号是连续的
+            if ((size_t)n > mtu || buf[n - 1] != '\n') {
+                ++bad;
+            }
+            const char* p = buf.c_str();
+            const char* end = p + n;
+            int last = -1;
+            while (p < end) {
+                const char* nl = (const char*)memchr(p, '\n', end - p);
+                if (!nl) {
+                    break;
+                }
+                int seq = -1;
+                char tail[64] = {0};
+                if (sscanf(p, "seq=%d %63[^\n]", &seq, tail) != 2 || strcmp(tail, "INFO udp")
+                        || seq < 0 || seq >= count || seen[seq]
+                        || (last >= 0 && seq != last + 1)) {
+                    ++bad;
+                } else {
+                    seen[seq] = true;
+                }
+                last = seq;
+                ++received;
+                p = nl + 1;
+            }
+        }
+    });
+
+    sylar::Logger::ptr logger(new sylar::Logger("udp"));
+    sylar::UdpLogAppender::ptr udp(new sylar::UdpLogAppender("127.0.0.1", ntohs(addr.sin_port), mtu, 100));
+    udp->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter("seq=%m %p %c%n")));
+    logger->addAppender(udp);
+    SYLAR_ASSERT(udp->isValid());
+
+    uint64_t start = sylar::GetCurrentUS();
+    for (int i = 0; i < count; ++i) {
+        SYLAR_LOG_INFO(logger) << i;
+    }
+    udp->flush();
+    uint64_t used = sylar::GetCurrentUS() - start;
+    th.join();
+    close(sock);
+
+    SYLAR_LOG_INFO(g_logger) << "udp mtu=" << mtu << " count=" << count
+        << " sent=" << udp->getSent() << " dropped=" << udp->getDropped()
+        << " datagrams=" << udp->getDatagrams() << " received=" << received
+        << " recv_datagrams=" << datagrams << " bad=" << bad
+        << " used=" << used << "us"
+        << " rate=" << (used ? count * 1000000.0 / used : 0) << "/s";
+    SYLAR_ASSERT(bad == 0);
+    SYLAR_ASSERT(udp->getSent() + udp->getDropped() == (uint64_t)count);
+    SYLAR_ASSERT((uint64_t)received <= udp->getSent());
+    // 本地回环上丢失（发送端丢弃加上内核丢弃）不超过 10%
+    SYLAR_ASSERT(received >= count - count / 10);
+}
+
+// 一批日志之后单独的一条，没有后续日志也没有 flush，也要在 flush_ms 之后发出去
+// SYLAR_SINGLE_THREAD 下没有定时线程，超时的包跟着下一条日志发出
+void test_udp_timer() {
+    sockaddr_in addr;
+    int sock = BindUdp(addr);
+
+    sylar::Logger::ptr logger(new sylar::Logger("udp"));
+    sylar::UdpLogAppender::ptr udp(new sylar::UdpLogAppender("127.0.0.1", ntohs(addr.sin_port), 1472, 50));
+    udp->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter("%m%n")));
+    logger->addAppender(udp);
+    SYLAR_LOG_INFO(logger) << "lonely";
+
+    char buf[2048];
+    pollfd pfd = {sock, POLLIN, 0};
+    uint64_t start = sylar::GetCurrentMS();
+#ifdef SYLAR_SINGLE_THREAD
+    usleep(60 * 1000);
+    SYLAR_LOG_INFO(logger) << "late";
+#endif
+    SYLAR_ASSERT(poll(&pfd, 1, 1000) == 1);
+    ssize_t n = recv(sock, buf, sizeof(buf), 0);
+    SYLAR_LOG_INFO(g_logger) << "udp timer flush after " << sylar::GetCurrentMS() - start << "ms";
+    SYLAR_ASSERT(n >= 7 && !memcmp(buf, "lonely\n", 7));
+    close(sock);
+}
+
+// 本地起一个 Unix 数据报套接字代替 /dev/log，检查 RFC 5424 格式
+void test_syslog() {
+    std::string path = "/tmp/sylar_test_syslog.sock";
+    unlink(path.c_str());
+    int sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    SYLAR_ASSERT(sock >= 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    SYLAR_ASSERT(bind(sock, (sockaddr*)&addr, sizeof(addr)) == 0);
+
+    sylar::Logger::ptr logger(new sylar::Logger("net.syslog"));
+    sylar::SyslogLogAppender::ptr syslog(new sylar::SyslogLogAppender("test_log_net",
+                sylar::SyslogLogAppender::FacilityFromString("local3"), path));
+    logger->addAppender(syslog);
+
+    SYLAR_LOG_WARN(logger) << "hello syslog";
+    {
+        sylar::LogContext::Scoped req("request_id", "r\"1]");
+        SYLAR_LOG_INFO(logger) << "with context";
+    }
+
+    char buf[2048];
+    ssize_t n = recv(sock, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+    SYLAR_ASSERT(n > 0);
+    buf[n] = 0;
+    SYLAR_LOG_INFO(g_logger) << "syslog frame: " << buf;
+    // local3 = 19，WARN = 4，PRI = 19 * 8 + 4
+    SYLAR_ASSERT(strncmp(buf, "<156>1 ", 7) == 0);
+    SYLAR_ASSERT(strstr(buf, " test_log_net ") != nullptr);
+    SYLAR_ASSERT(strstr(buf, " net.syslog - hello syslog") != nullptr);
+
+    n = recv(sock, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+    SYLAR_ASSERT(n > 0);
+    buf[n] = 0;
+    SYLAR_LOG_INFO(g_logger) << "syslog frame: " << buf;
+    SYLAR_ASSERT(strncmp(buf, "<158>1 ", 7) == 0);
+    SYLAR_ASSERT(strstr(buf, "[ctx@32473 request_id=\"r\\\"1\\]\"] with context") != nullptr);
+    SYLAR_ASSERT(syslog->getDropped() == 0);
+
+    close(sock);
+    unlink(path.c_str());
+}
+
+int main(int argc, char** argv) {
+    test_syslog();
+    test_udp(100000, 1472);
+    test_udp(10000, 200);
+    test_udp_timer();
+    return 0;
+}
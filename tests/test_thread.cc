@@ -0,0 +1,66 @@
+#include "../sylar/thread.h"
+#include "../sylar/log.h"
+#include "../sylar/macro.h"
+#include <sys/syscall.h>
+#include <sched.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_count = 0;
+static sylar::Mutex s_mutex;
+
+void fun1() {
+    SYLAR_ASSERT(sylar::Thread::GetThis());
+    SYLAR_ASSERT(sylar::Thread::GetName() == sylar::Thread::GetThis()->getName());
+    // 缓存的 tid 和系统调用取到的一致
+    SYLAR_ASSERT(sylar::GetThreadId() == syscall(SYS_gettid));
+    SYLAR_ASSERT(sylar::GetThreadId() == sylar::Thread::GetThis()->getId());
+    SYLAR_LOG_INFO(g_logger) << "name: " << sylar::Thread::GetName()
+                             << " this.name: " << sylar::Thread::GetThis()->getName()
+                             << " id: " << sylar::GetThreadId()
+                             << " this.id: " << sylar::Thread::GetThis()->getId();
+    for (int i = 0; i < 100000; ++i) {
+        sylar::Mutex::Lock lock(s_mutex);
+        ++s_count;
+    }
+}
+
+void fun2() {
+    // 绑定之后只在 CPU 0 上跑
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    SYLAR_ASSERT(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0);
+    SYLAR_ASSERT(CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set));
+    SYLAR_LOG_INFO(g_logger) << "pinned to cpu 0, running on cpu " << sched_getcpu();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setFormatter("%d{%H:%M:%S}%T%t%T%N%T[%p]%T%m%n");
+    SYLAR_LOG_INFO(g_logger) << "thread test begin, main thread name=" << sylar::Thread::GetName();
+    SYLAR_ASSERT(!sylar::Thread::GetThis());
+
+    std::vector<sylar::Thread::ptr> thrs;
+    for (int i = 0; i < 5; ++i) {
+        sylar::Thread::ptr thr(new sylar::Thread(&fun1, "name_" + std::to_string(i)));
+        // 构造函数返回时线程已经跑起来了，tid 有效
+        SYLAR_ASSERT(thr->getId() > 0);
+        thrs.push_back(thr);
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    SYLAR_ASSERT(s_count == 500000);
+
+    sylar::Thread::ptr pinned(new sylar::Thread(&fun2, "pinned", {0}));
+    pinned->join();
+
+    SYLAR_LOG_INFO(g_logger) << "numa nodes=" << sylar::Thread::GetNumaNodeCount();
+    std::vector<int> cpus;
+    if (sylar::Thread::GetNumaNodeCpus(0, cpus)) {
+        SYLAR_LOG_INFO(g_logger) << "numa node 0 cpus=" << cpus.size();
+    }
+
+    sylar::Thread::SetName("main_renamed");
+    SYLAR_LOG_INFO(g_logger) << "thread test end";
+    return 0;
+}
@@ -0,0 +1,15 @@
+#include "../sylar/macro.h"
+#include "../sylar/log.h"
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+void test_assert() {
+    SYLAR_LOG_INFO(g_logger) << sylar::BacktraceToString(10);
+    SYLAR_ASSERT(1 + 1 == 2);
+    SYLAR_ASSERT2(0 == 1, "abcdef xx");
+}
+
+int main(int argc, char** argv) {
+    test_assert();
+    return 0;
+}
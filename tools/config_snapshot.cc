@@ -0,0 +1,17 @@
+#include "../sylar/config.h"
+#include <iostream>
+
+// 把配置目录编译成二进制快照，启动时用 Config::LoadSnapshot 加载
+// 用法：config_snapshot <conf_dir> <snapshot_file>
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cout << "usage: " << argv[0] << " <conf_dir> <snapshot_file>" << std::endl;
+        return 1;
+    }
+    if (!sylar::Config::BuildSnapshot(argv[1], argv[2])) {
+        std::cout << "build snapshot failed, conf_dir=" << argv[1] << std::endl;
+        return 1;
+    }
+    std::cout << "build snapshot " << argv[2] << " ok" << std::endl;
+    return 0;
+}